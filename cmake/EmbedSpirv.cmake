@@ -0,0 +1,33 @@
+# Writes SPIR-V files into a header as constexpr arrays of words.
+#  cmake -DOUTPUT=<header> -DSHADERS=<name>=<path>;... -P EmbedSpirv.cmake
+
+set(ARRAYS "")
+set(ENTRIES "")
+
+foreach(SHADER ${SHADERS})
+  string(REPLACE "=" ";" SHADER_PAIR ${SHADER})
+  list(GET SHADER_PAIR 0 SHADER_NAME)
+  list(GET SHADER_PAIR 1 SHADER_PATH)
+
+  string(REPLACE "." "_" SHADER_SYMBOL ${SHADER_NAME})
+
+  file(READ ${SHADER_PATH} HEX_CONTENTS HEX)
+
+  # SPIR-V is a stream of little endian words
+  string(REGEX REPLACE "([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])" "0x\\4\\3\\2\\1, " WORDS "${HEX_CONTENTS}")
+  string(REGEX REPLACE "((0x[0-9a-f]+, ){8})" "\\1\n\t\t" WORDS "${WORDS}")
+
+  string(APPEND ARRAYS "\tconstexpr uint32_t ${SHADER_SYMBOL}[] = {\n\t\t${WORDS}\n\t};\n\n")
+  string(APPEND ENTRIES "\t\t{ \"${SHADER_NAME}\", ${SHADER_SYMBOL}, sizeof(${SHADER_SYMBOL}) },\n")
+endforeach()
+
+set(CONTENTS "// Generated by cmake/EmbedSpirv.cmake, do not edit\n\n#pragma once\n\n#include <cstdint>\n\n#include \"vulkan/Shader.hpp\"\n\nnamespace renderer::vulkan::shaders\n{\n${ARRAYS}\tconstexpr EmbeddedShaderCode embedded[] = {\n${ENTRIES}\t};\n}\n")
+
+# Unchanged header keeps dependent sources from rebuilding
+if (EXISTS ${OUTPUT})
+  file(READ ${OUTPUT} OLD_CONTENTS)
+endif()
+
+if (NOT "${OLD_CONTENTS}" STREQUAL "${CONTENTS}")
+  file(WRITE ${OUTPUT} "${CONTENTS}")
+endif()
@@ -14,7 +14,7 @@ using std::string;
 
 namespace data
 {
-	const uint16_t MAX_MAP_SIZE = 256;
+	const uint16_t MAX_MAP_SIZE = 2048;
 
 	using enum EntryName;
 
@@ -41,7 +41,7 @@ namespace data
 		{ "THG2", Sprites_Gameplay}
 	};
 
-	bool ReadChunk(filesystem::MpqFile& file, ChunkEntry& chunk, MapInfo& mapInfo)
+	bool ReadChunk(filesystem::MpqFile& file, ChunkEntry& chunk, MapInfo& mapInfo, utility::Arena* arena)
 	{
 		int dataSize = chunk.dataSize;
 
@@ -78,7 +78,7 @@ namespace data
 				assert(dataSize <= MAX_MAP_SIZE * MAX_MAP_SIZE * sizeof(uint16_t));
 
 				mapInfo.tileCount = dataSize / sizeof(uint16_t);
-				mapInfo.terrain = std::make_shared<uint16_t[]>(mapInfo.tileCount);
+				mapInfo.terrain = utility::MakeShared<uint16_t[]>(arena, mapInfo.tileCount);
 
 				file.ReadBinary(mapInfo.terrain.get(), dataSize);
 				break;
@@ -114,7 +114,7 @@ namespace data
 		mapInfo.sprites.clear();
 	}
 
-	void ReadMap(filesystem::MpqArchive& mapArchive, MapInfo& mapInfo)
+	void ReadMap(filesystem::MpqArchive& mapArchive, MapInfo& mapInfo, utility::Arena* arena)
 	{
 		Clear(mapInfo);
 
@@ -130,7 +130,7 @@ namespace data
 			ChunkEntry nextEntry;
 			scenarioFile.Read(nextEntry);
 
-			if (!ReadChunk(scenarioFile, nextEntry, mapInfo))
+			if (!ReadChunk(scenarioFile, nextEntry, mapInfo, arena))
 			{
 				ignoredEntries.emplace_back(nextEntry.name, 4);
 			}
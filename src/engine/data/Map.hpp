@@ -9,6 +9,7 @@
 #include <data/Common.hpp>
 #include <data/Tileset.hpp>
 #include <filesystem/MpqArchive.hpp>
+#include <utility/Arena.hpp>
 
 namespace data
 {
@@ -53,7 +54,7 @@ namespace data
 		uint16_t              flags;
 	};
 
-	extern void ReadMap(filesystem::MpqArchive& mapArchive, MapInfo& mapInfo);
+	extern void ReadMap(filesystem::MpqArchive& mapArchive, MapInfo& mapInfo, utility::Arena* arena = nullptr);
 
 	extern const uint16_t MAX_MAP_SIZE;
 }
\ No newline at end of file
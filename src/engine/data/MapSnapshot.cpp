@@ -0,0 +1,361 @@
+#include "MapSnapshot.hpp"
+#include "Terrain.hpp"
+
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#include <boost/format.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace data
+{
+	namespace ipc = boost::interprocess;
+
+	using std::runtime_error;
+	using std::shared_ptr;
+	using std::string;
+
+	const uint64_t SNAPSHOT_SECTION_ALIGNMENT = 16;
+
+	enum class SnapshotSection : uint32_t
+	{
+		Map, Terrain, Sprites, ResolvedTiles,
+		Palette, Chips, Tiles, TileGroups, UniqueTiles, UniqueTileMap,
+		Doodads, Grps,
+		Count
+	};
+
+	struct SectionEntry
+	{
+		uint64_t offset, size;
+	};
+
+	struct SnapshotHeader
+	{
+		char        magic[4];
+		uint32_t    version;
+		SnapshotKey key;
+		uint32_t    sectionCount;
+		uint32_t    unused;
+
+		std::array<SectionEntry, static_cast<int>(SnapshotSection::Count)> sections;
+	};
+
+	struct SnapshotMapInfo
+	{
+		char       mapType[4];
+		uint16_t   version;
+		Tileset    tileset;
+		dimensions dimensions;
+		int32_t    tileCount;
+
+		int32_t chipCount;
+		int32_t tileGroupCount;
+		int32_t tilesetTileCount;
+		int32_t uniqueTilesCount;
+	};
+
+	struct SnapshotGrpEntry
+	{
+		uint32_t id;
+		uint32_t size;
+	};
+
+	static_assert(sizeof(SnapshotGrpEntry) % 2 == 0, "Grp data after an entry must stay 2 byte aligned");
+
+	// Keeps file mapped while any array is pointing into it
+	struct MappedSnapshot
+	{
+		ipc::file_mapping  file;
+		ipc::mapped_region region;
+	};
+
+	SnapshotKey SnapshotKey::FromFile(const char* mapPath)
+	{
+		auto writeTime = std::filesystem::last_write_time(mapPath);
+
+		return { std::filesystem::file_size(mapPath), writeTime.time_since_epoch().count() };
+	}
+
+	string GetSnapshotPath(const char* mapPath)
+	{
+		auto fullPath = std::filesystem::weakly_canonical(mapPath).generic_u8string();
+
+		// Maps of the same name in other directories get their own snapshot.
+		//  FNV-1a, unlike std::hash it's the same on every run and build
+		uint64_t pathHash = 14695981039346656037ull;
+
+		for(auto c : fullPath)
+		{
+			pathHash = (pathHash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+		}
+
+		auto fileName = boost::format("%1%-%2$016x.snapshot") % std::filesystem::path(mapPath).filename().string() % pathHash;
+
+		return (std::filesystem::path("cache") / fileName.str()).string();
+	}
+
+	bool ReadMapSnapshot(const char* path, const SnapshotKey& key, MapSnapshot& out)
+	{
+		if (!std::filesystem::exists(path))
+			return false;
+
+		auto mapped = std::make_shared<MappedSnapshot>();
+
+		try
+		{
+			mapped->file   = ipc::file_mapping(path, ipc::read_only);
+			mapped->region = ipc::mapped_region(mapped->file, ipc::read_only);
+		}
+		catch (ipc::interprocess_exception&)
+		{
+			return false;
+		}
+
+		auto base     = static_cast<uint8_t*>(mapped->region.get_address());
+		auto fileSize = mapped->region.get_size();
+
+		if (fileSize < sizeof(SnapshotHeader))
+			return false;
+
+		SnapshotHeader header;
+		memcpy(&header, base, sizeof(header));
+
+		if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ||
+				header.version != SNAPSHOT_VERSION ||
+				header.sectionCount != header.sections.size() ||
+				header.key.fileSize != key.fileSize ||
+				header.key.writeTime != key.writeTime)
+		{
+			return false;
+		}
+
+		for(auto& section : header.sections)
+		{
+			// Sum of corrupt offset and size could wrap around
+			if (section.offset > fileSize || section.size > fileSize - section.offset)
+				return false;
+		}
+
+		if (header.sections[static_cast<int>(SnapshotSection::Map)].size != sizeof(SnapshotMapInfo) ||
+				header.sections[static_cast<int>(SnapshotSection::Palette)].size != sizeof(WpeData))
+		{
+			return false;
+		}
+
+		auto sectionData = [&] <typename T> (SnapshotSection section) {
+
+			auto& entry = header.sections[static_cast<int>(section)];
+
+			return shared_ptr<T[]>(mapped, reinterpret_cast<T*>(base + entry.offset));
+		};
+
+		auto sectionSize = [&] (SnapshotSection section) {
+			return header.sections[static_cast<int>(section)].size;
+		};
+
+		SnapshotMapInfo mapHeader;
+		memcpy(&mapHeader, base + header.sections[static_cast<int>(SnapshotSection::Map)].offset, sizeof(mapHeader));
+
+		// Arrays are read in place, a damaged file must not point them past their section
+		auto holds = [&] (SnapshotSection section, int64_t count, uint64_t elementSize) {
+			return count >= 0 && static_cast<uint64_t>(count) * elementSize <= sectionSize(section);
+		};
+
+		const int64_t mapTileCount = int64_t(mapHeader.dimensions.x) * mapHeader.dimensions.y;
+
+		if (mapHeader.tileCount != mapTileCount ||
+				!holds(SnapshotSection::Terrain, mapTileCount, sizeof(uint16_t)) ||
+				!holds(SnapshotSection::ResolvedTiles, mapTileCount, sizeof(tileID)) ||
+				!holds(SnapshotSection::Chips, mapHeader.chipCount, sizeof(Chip)) ||
+				!holds(SnapshotSection::Tiles, mapHeader.tilesetTileCount, sizeof(Tile)) ||
+				!holds(SnapshotSection::TileGroups, mapHeader.tileGroupCount, sizeof(TileGroup)) ||
+				!holds(SnapshotSection::UniqueTiles, mapHeader.uniqueTilesCount, sizeof(uint32_t)) ||
+				!holds(SnapshotSection::UniqueTileMap, mapHeader.tilesetTileCount, sizeof(uint32_t)))
+		{
+			return false;
+		}
+
+		// Map
+		auto& mapInfo = out.mapInfo;
+
+		memcpy(mapInfo.mapType, mapHeader.mapType, sizeof(mapInfo.mapType));
+		mapInfo.version    = mapHeader.version;
+		mapInfo.tileset    = mapHeader.tileset;
+		mapInfo.dimensions = mapHeader.dimensions;
+		mapInfo.tileCount  = mapHeader.tileCount;
+		mapInfo.terrain    = sectionData.operator()<uint16_t>(SnapshotSection::Terrain);
+
+		auto sprites = sectionData.operator()<MapSprite>(SnapshotSection::Sprites);
+		mapInfo.sprites.assign(sprites.get(), sprites.get() + sectionSize(SnapshotSection::Sprites) / sizeof(MapSprite));
+
+		out.resolvedTiles = sectionData.operator()<tileID>(SnapshotSection::ResolvedTiles);
+
+		// Tileset
+		auto& tilesetData = out.tilesetData;
+
+		WpeData wpeData;
+		memcpy(&wpeData, base + header.sections[static_cast<int>(SnapshotSection::Palette)].offset, sizeof(wpeData));
+
+		tilesetData.palette = Palette(wpeData);
+
+		tilesetData.tileset          = mapHeader.tileset;
+		tilesetData.chipCount        = mapHeader.chipCount;
+		tilesetData.chips            = sectionData.operator()<Chip>(SnapshotSection::Chips);
+		tilesetData.tileCount        = mapHeader.tilesetTileCount;
+		tilesetData.tiles            = sectionData.operator()<Tile>(SnapshotSection::Tiles);
+		tilesetData.tileGroupCount   = mapHeader.tileGroupCount;
+		tilesetData.tileGroups       = sectionData.operator()<TileGroup>(SnapshotSection::TileGroups);
+		tilesetData.uniqueTilesCount = mapHeader.uniqueTilesCount;
+		tilesetData.uniqueTiles      = sectionData.operator()<uint32_t>(SnapshotSection::UniqueTiles);
+		tilesetData.uniqueTileMap    = sectionData.operator()<uint32_t>(SnapshotSection::UniqueTileMap);
+
+		// Doodads
+		auto doodads = sectionData.operator()<SnapshotDoodad>(SnapshotSection::Doodads);
+		out.doodads.assign(doodads.get(), doodads.get() + sectionSize(SnapshotSection::Doodads) / sizeof(SnapshotDoodad));
+
+		// State offsets are copied by their count when doodads are restored
+		for(auto& doodad : out.doodads)
+		{
+			if (doodad.scriptState.stateCount < 0 || doodad.scriptState.stateCount > SNAPSHOT_MAX_SCRIPT_STATES)
+				return false;
+		}
+
+		// Grp files
+		auto& grpSection = header.sections[static_cast<int>(SnapshotSection::Grps)];
+		auto  grpOffset  = grpSection.offset;
+		auto  grpEnd     = grpSection.offset + grpSection.size;
+
+		out.grps.clear();
+
+		while(grpOffset < grpEnd)
+		{
+			if (sizeof(SnapshotGrpEntry) > grpEnd - grpOffset)
+				return false;
+
+			SnapshotGrpEntry entry;
+			memcpy(&entry, base + grpOffset, sizeof(entry));
+
+			grpOffset += sizeof(entry);
+
+			if (entry.size > grpEnd - grpOffset)
+				return false;
+
+			out.grps.emplace_back(entry.id, shared_ptr<uint8_t[]>(mapped, base + grpOffset), entry.size);
+
+			grpOffset = Aligned<uint64_t>(grpOffset + entry.size, SNAPSHOT_SECTION_ALIGNMENT);
+		}
+
+		return true;
+	}
+
+	void WriteMapSnapshot(const char* path, const SnapshotKey& key, const MapSnapshot& snapshot)
+	{
+		std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+
+		std::ofstream output(path, std::ios::binary | std::ios::trunc);
+
+		if (!output.is_open())
+		{
+			throw runtime_error("Failed to create map snapshot");
+		}
+
+		auto& mapInfo     = snapshot.mapInfo;
+		auto& tilesetData = snapshot.tilesetData;
+
+		SnapshotHeader header {};
+
+		memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+		header.version      = SNAPSHOT_VERSION;
+		header.key          = key;
+		header.sectionCount = header.sections.size();
+
+		// Header is rewritten when the section table is known
+		output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		uint64_t offset = sizeof(header);
+
+		auto pad = [&] () {
+
+			const char zeros[SNAPSHOT_SECTION_ALIGNMENT] = {};
+			auto alignedOffset = Aligned<uint64_t>(offset, SNAPSHOT_SECTION_ALIGNMENT);
+
+			output.write(zeros, alignedOffset - offset);
+			offset = alignedOffset;
+		};
+
+		auto beginSection = [&] (SnapshotSection section) {
+
+			pad();
+			header.sections[static_cast<int>(section)].offset = offset;
+		};
+
+		auto write = [&] (SnapshotSection section, const void* data, uint64_t size) {
+
+			output.write(reinterpret_cast<const char*>(data), size);
+			offset += size;
+
+			header.sections[static_cast<int>(section)].size += size;
+		};
+
+		auto writeSection = [&] (SnapshotSection section, const void* data, uint64_t size) {
+
+			beginSection(section);
+			write(section, data, size);
+		};
+
+		SnapshotMapInfo mapHeader {};
+
+		memcpy(mapHeader.mapType, mapInfo.mapType, sizeof(mapHeader.mapType));
+		mapHeader.version          = mapInfo.version;
+		mapHeader.tileset          = mapInfo.tileset;
+		mapHeader.dimensions       = mapInfo.dimensions;
+		mapHeader.tileCount        = mapInfo.tileCount;
+		mapHeader.chipCount        = tilesetData.chipCount;
+		mapHeader.tileGroupCount   = tilesetData.tileGroupCount;
+		mapHeader.tilesetTileCount = tilesetData.tileCount;
+		mapHeader.uniqueTilesCount = tilesetData.uniqueTilesCount;
+
+		writeSection(SnapshotSection::Map, &mapHeader, sizeof(mapHeader));
+		writeSection(SnapshotSection::Terrain, mapInfo.terrain.get(), mapInfo.tileCount * sizeof(uint16_t));
+		writeSection(SnapshotSection::Sprites, mapInfo.sprites.data(), mapInfo.sprites.size() * sizeof(MapSprite));
+		writeSection(SnapshotSection::ResolvedTiles, snapshot.resolvedTiles.get(), mapInfo.tileCount * sizeof(tileID));
+
+		writeSection(SnapshotSection::Palette, tilesetData.palette.GetColors(), sizeof(WpeData));
+		writeSection(SnapshotSection::Chips, tilesetData.chips.get(), tilesetData.chipCount * sizeof(Chip));
+		writeSection(SnapshotSection::Tiles, tilesetData.tiles.get(), tilesetData.tileCount * sizeof(Tile));
+		writeSection(SnapshotSection::TileGroups, tilesetData.tileGroups.get(), tilesetData.tileGroupCount * sizeof(TileGroup));
+		writeSection(SnapshotSection::UniqueTiles, tilesetData.uniqueTiles.get(), tilesetData.uniqueTilesCount * sizeof(uint32_t));
+		writeSection(SnapshotSection::UniqueTileMap, tilesetData.uniqueTileMap.get(), tilesetData.tileCount * sizeof(uint32_t));
+
+		writeSection(SnapshotSection::Doodads, snapshot.doodads.data(), snapshot.doodads.size() * sizeof(SnapshotDoodad));
+
+		beginSection(SnapshotSection::Grps);
+
+		for(auto& grp : snapshot.grps)
+		{
+			SnapshotGrpEntry entry = { grp.id, static_cast<uint32_t>(grp.size) };
+
+			write(SnapshotSection::Grps, &entry, sizeof(entry));
+			write(SnapshotSection::Grps, grp.data.get(), grp.size);
+
+			// Entries start aligned, so Grp data read in place right after
+			//  the 8 byte entry keeps the 2 byte alignment Grp needs
+			auto paddingStart = offset;
+			pad();
+			header.sections[static_cast<int>(SnapshotSection::Grps)].size += offset - paddingStart;
+		}
+
+		output.seekp(0);
+		output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		if (!output.good())
+		{
+			throw runtime_error("Failed to write map snapshot");
+		}
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <data/Common.hpp>
+#include <data/Grp.hpp>
+
+#include "Map.hpp"
+#include "Tile.hpp"
+#include "../script/IScriptEngine.hpp"
+
+namespace data
+{
+	const char     SNAPSHOT_MAGIC[] = "SCMS";
+	const uint32_t SNAPSHOT_VERSION = 1;
+
+	const int SNAPSHOT_MAX_SCRIPT_STATES = 32;
+
+	// Identifies the map file the snapshot was made from
+	struct SnapshotKey
+	{
+		uint64_t fileSize;
+		int64_t  writeTime;
+
+		static SnapshotKey FromFile(const char* mapPath);
+	};
+
+	// Doodad as it is right after placement, before the first script tick
+	struct SnapshotDoodad
+	{
+		uint32_t           scriptID;
+		uint32_t           grpID;
+		int32_t            x, y;
+		script::ScriptState scriptState;
+		uint16_t           stateOffsets[SNAPSHOT_MAX_SCRIPT_STATES];
+	};
+
+	struct SnapshotGrp
+	{
+		grpID                      id;
+		std::shared_ptr<uint8_t[]> data;
+		int                        size;
+	};
+
+	// Fully prepared map state. When it's read back every array
+	//  points straight into the mapped file, nothing is copied.
+	struct MapSnapshot
+	{
+		MapInfo     mapInfo;
+		TilesetData tilesetData;
+
+		std::shared_ptr<tileID[]>   resolvedTiles; // x + y * width
+		std::vector<SnapshotDoodad> doodads;
+		std::vector<SnapshotGrp>    grps;
+	};
+
+	// Cache file named after the map and a hash of its full path
+	extern std::string GetSnapshotPath(const char* mapPath);
+
+	// Returns false if there's no snapshot or it's outdated
+	extern bool ReadMapSnapshot(const char* path, const SnapshotKey& key, MapSnapshot& out);
+
+	extern void WriteMapSnapshot(const char* path, const SnapshotKey& key, const MapSnapshot& snapshot);
+}
@@ -0,0 +1,246 @@
+#include "Terrain.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace data
+{
+	tileID ResolveTile(const MapInfo& mapInfo, TilesetData& tilesetData, int x, int y)
+	{
+		auto [tileGroupID, variation] = mapInfo.GetTile(x, y);
+		auto& tileGroup = tilesetData.tileGroups[tileGroupID];
+
+		if (tilesetData.IsDoodad(tileGroupID))
+		{
+			return tileGroup.terrain.variations[variation];
+		}
+		else
+		{
+			return tileGroup.doodad.tiles[variation];
+		}
+	}
+
+	ChunkedTerrain::ChunkedTerrain()
+	{
+		_worker = std::thread(&ChunkedTerrain::WorkerLoop, this);
+	}
+
+	ChunkedTerrain::~ChunkedTerrain()
+	{
+		{
+			std::lock_guard lock(_queueMutex);
+			_running = false;
+		}
+
+		_queueCondition.notify_all();
+
+		if (_worker.joinable())
+			_worker.join();
+	}
+
+	void ChunkedTerrain::Open(const MapInfo* mapInfo, TilesetData* tilesetData, const tileID* resolvedTiles)
+	{
+		Close();
+
+		_mapInfo       = mapInfo;
+		_tilesetData   = tilesetData;
+		_resolvedTiles = resolvedTiles;
+
+		_chunkCount = {
+			(mapInfo->dimensions.x + TERRAIN_CHUNK_SIZE - 1) / TERRAIN_CHUNK_SIZE,
+			(mapInfo->dimensions.y + TERRAIN_CHUNK_SIZE - 1) / TERRAIN_CHUNK_SIZE,
+		};
+	}
+
+	void ChunkedTerrain::Close()
+	{
+		// Worker must not touch the slots while they are being reset
+		WaitForRequests();
+
+		for(auto& chunk : _chunks)
+		{
+			chunk.state.store(ChunkState::Free);
+			chunk.lastUsedFrame = 0;
+		}
+
+		_residentChunks.clear();
+
+		_mapInfo       = nullptr;
+		_tilesetData   = nullptr;
+		_resolvedTiles = nullptr;
+		_chunkCount    = { 0, 0 };
+		_frame         = 0;
+	}
+
+	void ChunkedTerrain::Update(int left, int top, int right, int bottom)
+	{
+		if (_mapInfo == nullptr)
+			return;
+
+		_frame++;
+
+		int chunkLeft   = std::max(0, left / TERRAIN_CHUNK_SIZE - TERRAIN_PREFETCH_MARGIN);
+		int chunkTop    = std::max(0, top / TERRAIN_CHUNK_SIZE - TERRAIN_PREFETCH_MARGIN);
+		int chunkRight  = std::min(_chunkCount.x, right / TERRAIN_CHUNK_SIZE + 1 + TERRAIN_PREFETCH_MARGIN);
+		int chunkBottom = std::min(_chunkCount.y, bottom / TERRAIN_CHUNK_SIZE + 1 + TERRAIN_PREFETCH_MARGIN);
+
+		for(int x = chunkLeft; x < chunkRight; x++)
+		for(int y = chunkTop; y < chunkBottom; y++)
+		{
+			RequestChunk(x, y);
+		}
+	}
+
+	void ChunkedTerrain::Preload(int left, int top, int right, int bottom)
+	{
+		Update(left, top, right, bottom);
+
+		WaitForRequests();
+	}
+
+	const TerrainChunk* ChunkedTerrain::FindChunk(int chunkX, int chunkY) const
+	{
+		auto it = _residentChunks.find(GetKey(chunkX, chunkY));
+
+		if (it == _residentChunks.end())
+			return nullptr;
+
+		auto chunk = it->second;
+
+		if (chunk->state.load(std::memory_order_acquire) != ChunkState::Ready)
+			return nullptr;
+
+		return chunk;
+	}
+
+	int ChunkedTerrain::GetResidentCount() const
+	{
+		return _residentChunks.size();
+	}
+
+	TerrainChunk* ChunkedTerrain::RequestChunk(int chunkX, int chunkY)
+	{
+		auto key = GetKey(chunkX, chunkY);
+		auto it  = _residentChunks.find(key);
+
+		if (it != _residentChunks.end())
+		{
+			it->second->lastUsedFrame = _frame;
+			return it->second;
+		}
+
+		auto chunk = TakeFreeSlot();
+
+		// Every slot is in use by the current view, try again next frame
+		if (chunk == nullptr)
+			return nullptr;
+
+		chunk->position      = { chunkX, chunkY };
+		chunk->lastUsedFrame = _frame;
+		chunk->state.store(ChunkState::Loading);
+
+		_residentChunks[key] = chunk;
+
+		{
+			std::lock_guard lock(_queueMutex);
+
+			_queue.push_back(chunk);
+			_pendingCount++;
+		}
+
+		_queueCondition.notify_one();
+
+		return chunk;
+	}
+
+	TerrainChunk* ChunkedTerrain::TakeFreeSlot()
+	{
+		TerrainChunk* leastUsed = nullptr;
+
+		for(auto& chunk : _chunks)
+		{
+			auto state = chunk.state.load(std::memory_order_acquire);
+
+			if (state == ChunkState::Free)
+				return &chunk;
+
+			// Chunks being resolved or needed by the current frame are kept
+			if (state != ChunkState::Ready || chunk.lastUsedFrame == _frame)
+				continue;
+
+			if (leastUsed == nullptr || chunk.lastUsedFrame < leastUsed->lastUsedFrame)
+				leastUsed = &chunk;
+		}
+
+		if (leastUsed != nullptr)
+		{
+			_residentChunks.erase(GetKey(leastUsed->position.x, leastUsed->position.y));
+			leastUsed->state.store(ChunkState::Free);
+		}
+
+		return leastUsed;
+	}
+
+	void ChunkedTerrain::ResolveChunk(TerrainChunk& chunk)
+	{
+		int startX = chunk.position.x * TERRAIN_CHUNK_SIZE;
+		int startY = chunk.position.y * TERRAIN_CHUNK_SIZE;
+
+		int width  = std::min(TERRAIN_CHUNK_SIZE, _mapInfo->dimensions.x - startX);
+		int height = std::min(TERRAIN_CHUNK_SIZE, _mapInfo->dimensions.y - startY);
+
+		memset(chunk.tiles, 0, sizeof(chunk.tiles));
+
+		for(int i = 0; i < width; i++)
+		for(int j = 0; j < height; j++)
+		{
+			if (_resolvedTiles != nullptr)
+				chunk.tiles[i][j] = _resolvedTiles[(startX + i) + (startY + j) * _mapInfo->dimensions.x];
+			else
+				chunk.tiles[i][j] = ResolveTile(*_mapInfo, *_tilesetData, startX + i, startY + j);
+		}
+	}
+
+	void ChunkedTerrain::WaitForRequests()
+	{
+		std::unique_lock lock(_queueMutex);
+
+		_idleCondition.wait(lock, [this] { return _pendingCount == 0; });
+	}
+
+	void ChunkedTerrain::WorkerLoop()
+	{
+		while(true)
+		{
+			TerrainChunk* chunk;
+
+			{
+				std::unique_lock lock(_queueMutex);
+
+				_queueCondition.wait(lock, [this] { return !_running || !_queue.empty(); });
+
+				if (!_running)
+					return;
+
+				chunk = _queue.front();
+				_queue.pop_front();
+			}
+
+			ResolveChunk(*chunk);
+
+			chunk->state.store(ChunkState::Ready, std::memory_order_release);
+
+			{
+				std::lock_guard lock(_queueMutex);
+				_pendingCount--;
+			}
+
+			_idleCondition.notify_all();
+		}
+	}
+
+	int64_t ChunkedTerrain::GetKey(int chunkX, int chunkY)
+	{
+		return (static_cast<int64_t>(chunkX) << 32) | static_cast<uint32_t>(chunkY);
+	}
+}
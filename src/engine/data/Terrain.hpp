@@ -0,0 +1,109 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <data/Common.hpp>
+
+#include "Map.hpp"
+#include "Tile.hpp"
+
+namespace data
+{
+	// Side of a terrain chunk in tiles
+	const int TERRAIN_CHUNK_SIZE = 32;
+
+	// Amount of chunk slots kept in memory, doesn't depend on map size
+	const int TERRAIN_RESIDENT_CHUNKS = 96;
+
+	// Chunks around the view that are requested ahead of scrolling
+	const int TERRAIN_PREFETCH_MARGIN = 1;
+
+	extern tileID ResolveTile(const MapInfo& mapInfo, TilesetData& tilesetData, int x, int y);
+
+	enum class ChunkState : uint8_t
+	{
+		Free, Loading, Ready
+	};
+
+	struct TerrainChunk
+	{
+		glm::vec<2, int> position; // in chunks
+		uint64_t         lastUsedFrame = 0;
+
+		std::atomic<ChunkState> state { ChunkState::Free };
+
+		// Column-major as the rest of the map code: tiles[x][y]
+		tileID tiles[TERRAIN_CHUNK_SIZE][TERRAIN_CHUNK_SIZE];
+	};
+
+	// Keeps resolved tile IDs only for the chunks around the camera.
+	//  Chunks are resolved on a worker thread and evicted in LRU order
+	//  once all slots are taken, so memory stays the same for any map size.
+	class ChunkedTerrain
+	{
+	public:
+
+		ChunkedTerrain();
+		~ChunkedTerrain();
+
+		ChunkedTerrain(const ChunkedTerrain&) = delete;
+		ChunkedTerrain& operator=(const ChunkedTerrain&) = delete;
+
+		// Drops resident chunks and starts streaming of a new map.
+		//  Chunks are copied from resolvedTiles (x + y * width) when it's given.
+		void Open(const MapInfo* mapInfo, TilesetData* tilesetData, const tileID* resolvedTiles = nullptr);
+
+		void Close();
+
+		// Requests chunks that overlap the area (in tiles) plus prefetch margin
+		void Update(int left, int top, int right, int bottom);
+
+		// Same as Update() but blocks until the area is resolved
+		void Preload(int left, int top, int right, int bottom);
+
+		// Returns nullptr if chunk is not resident yet
+		const TerrainChunk* FindChunk(int chunkX, int chunkY) const;
+
+		int GetResidentCount() const;
+
+		glm::vec<2, int> GetChunkCount() const { return _chunkCount; }
+
+	private:
+
+		TerrainChunk* RequestChunk(int chunkX, int chunkY);
+		TerrainChunk* TakeFreeSlot();
+
+		void ResolveChunk(TerrainChunk& chunk);
+		void WaitForRequests();
+		void WorkerLoop();
+
+		static int64_t GetKey(int chunkX, int chunkY);
+
+	private:
+
+		const MapInfo* _mapInfo     = nullptr;
+		TilesetData*   _tilesetData = nullptr;
+		const tileID*  _resolvedTiles = nullptr;
+
+		glm::vec<2, int> _chunkCount = { 0, 0 };
+		uint64_t         _frame = 0;
+
+		std::array<TerrainChunk, TERRAIN_RESIDENT_CHUNKS> _chunks;
+		std::unordered_map<int64_t, TerrainChunk*>         _residentChunks;
+
+		std::thread             _worker;
+		std::mutex              _queueMutex;
+		std::condition_variable _queueCondition, _idleCondition;
+		std::deque<TerrainChunk*> _queue;
+		int                     _pendingCount = 0;
+		bool                    _running = true;
+	};
+}
@@ -10,7 +10,7 @@
 using boost::format;
 
 using std::string;
-using std::make_shared;
+using utility::MakeShared;
 
 namespace data
 {
@@ -85,7 +85,7 @@ namespace data
 		}
 	}
 
-	void LoadTilesetData(filesystem::Storage& storage, data::Tileset tileset, TilesetData& out)
+	void LoadTilesetData(filesystem::Storage& storage, data::Tileset tileset, TilesetData& out, utility::Arena* arena)
 	{
 		out.tileset = tileset;
 
@@ -103,7 +103,7 @@ namespace data
 		
 		int chipDataSize = chipSetFile.GetFileSize();
 		int chipCount = chipDataSize / sizeof(Tile);
-		auto chips = make_shared<Chip[]>(chipCount);
+		auto chips = MakeShared<Chip[]>(arena, chipCount);
 
 		chipSetFile.ReadBinary(chips.get(), chipDataSize);
 
@@ -113,7 +113,7 @@ namespace data
 
 		int tileDataSize = tileSetFile.GetFileSize();
 		int tilesCount = tileDataSize / sizeof(Tile);
-		auto tiles = make_shared<Tile[]>(tilesCount);
+		auto tiles = MakeShared<Tile[]>(arena, tilesCount);
 
 		tileSetFile.ReadBinary(tiles.get(), tileDataSize);
 
@@ -123,13 +123,13 @@ namespace data
 
 		int tileGroupDataSize = tileGroupFile.GetFileSize();
 		int tileGroupCount = tileGroupDataSize / sizeof(TileGroup);
-		auto tileGroups = make_shared<TileGroup[]>(tileGroupCount);
+		auto tileGroups = MakeShared<TileGroup[]>(arena, tileGroupCount);
 
 		tileGroupFile.ReadBinary(tileGroups.get(), tileGroupDataSize);
 
 		// Найти похожие тайлы
-		auto tileMap     = make_shared<uint32_t[]>(tilesCount);
-		auto uniqueTiles = make_shared<uint32_t[]>(tilesCount);
+		auto tileMap     = MakeShared<uint32_t[]>(arena, tilesCount);
+		auto uniqueTiles = MakeShared<uint32_t[]>(arena, tilesCount);
 		int  uniqueTilesCount = 0;
 
 		for(int i = 0; i < tilesCount; i++)
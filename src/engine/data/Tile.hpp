@@ -7,6 +7,7 @@
 #include <data/Common.hpp>
 #include <data/Tileset.hpp>
 #include <filesystem/Storage.hpp>
+#include <utility/Arena.hpp>
 
 #include <data/Palette.hpp>
 
@@ -131,5 +132,5 @@ namespace data
 		void GetPixelData(const tileID tileID, uint8_t* dstArray, uint32_t dstOffset, uint32_t dstStride) const override;
 	};
 
-	extern void LoadTilesetData(filesystem::Storage& storage, data::Tileset tileset, TilesetData& out);
+	extern void LoadTilesetData(filesystem::Storage& storage, data::Tileset tileset, TilesetData& out, utility::Arena* arena = nullptr);
 }
\ No newline at end of file
@@ -165,7 +165,7 @@ int main(int argc, char *argv[])
 			};
 
 			app.graphics->SetView({0, 0});
-			app.graphics->BeginRendering(); // to be in sync with LoadImage()
+			app.graphics->BeginRendering(); // portrait frame uploaded in Process() goes with this frame
 
 			unitTransmission.Process(loop.GetDeltaTime());
 			unitTransmission.Draw({ 24, 37 });
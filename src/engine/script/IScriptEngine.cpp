@@ -95,6 +95,11 @@ namespace script
 		_elaspedTicks = 0;
 	}
 
+	void IScriptEngine::SetArena(utility::Arena* arena)
+	{
+		_arena = arena;
+	}
+
 	void IScriptEngine::SetScriptData(shared_ptr<uint8_t[]> data, int dataSize)
 	{
 		_scriptData = data;
@@ -124,7 +129,7 @@ namespace script
 		reader.SetPointer(entry.offset);
 		reader.Read(scope);
 
-		auto states = std::make_shared<uint16_t[]>(scope.GetStateCount());
+		auto states = utility::MakeShared<uint16_t[]>(_arena, scope.GetStateCount());
 		reader.Read(states.get(), scope.GetStateCount());
 
 		object->Setup(scope.type, states, scope.GetStateCount());
@@ -133,6 +138,11 @@ namespace script
 		_scriptInstances.push_back(object);
 	}
 
+	void IScriptEngine::AttachScriptableObject(std::shared_ptr<A_IScriptable> object)
+	{
+		_scriptInstances.push_back(object);
+	}
+
 	A_IScriptable::A_IScriptable(uint32_t scriptID) : _scriptID(scriptID) 
 		{};
 	
@@ -152,6 +162,25 @@ namespace script
 		_pointer = _stateOffsets[iState];
 	}
 
+	ScriptState A_IScriptable::GetScriptState() const
+	{
+		return { _type, _pointer, _waitTimer, _stateCount };
+	}
+
+	const uint16_t* A_IScriptable::GetStateOffsets() const
+	{
+		return _stateOffsets.get();
+	}
+
+	void A_IScriptable::RestoreScriptState(const ScriptState& scriptState, shared_ptr<uint16_t[]> stateOffsets)
+	{
+		_type         = scriptState.type;
+		_pointer      = scriptState.pointer;
+		_waitTimer    = scriptState.waitTimer;
+		_stateCount   = scriptState.stateCount;
+		_stateOffsets = stateOffsets;
+	}
+
 	void A_IScriptable::Run(ticks currentTick, data::StreamReader reader)
 	{
 		if (currentTick < _waitTimer)
@@ -6,6 +6,7 @@
 
 #include <data/Common.hpp>
 #include <filesystem/Storage.hpp>
+#include <utility/Arena.hpp>
 
 namespace script
 {
@@ -29,6 +30,15 @@ namespace script
 		int GetStateCount();
 	};
 
+	// Progress of a scriptable object, enough to restore it without running its script
+	struct ScriptState
+	{
+		uint32_t type;
+		uint16_t pointer;
+		ticks    waitTimer;
+		int      stateCount;
+	};
+
 	class A_IScriptable
 	{
 	public:
@@ -47,6 +57,10 @@ namespace script
 
 		void Setup(uint32_t type, std::shared_ptr<uint16_t[]> stateOffsets, int stateCount);
 		void SetState(state state);
+
+		ScriptState     GetScriptState() const;
+		const uint16_t* GetStateOffsets() const;
+		void            RestoreScriptState(const ScriptState&, std::shared_ptr<uint16_t[]> stateOffsets);
 		void Run(ticks currentTick, data::StreamReader codeReader);
 
 	private:
@@ -67,15 +81,21 @@ namespace script
 
 		void Clear();
 		void Init();
+		void SetArena(utility::Arena* arena);
 		void SetScriptData(std::shared_ptr<uint8_t[]> data, int dataSize);
 		void Process();
 		void PlayNextFrame();
 		void RunScriptableObject(std::shared_ptr<A_IScriptable> object);
 
+		// Adds object which script state is already restored
+		void AttachScriptableObject(std::shared_ptr<A_IScriptable> object);
+
 	private:
 
 		ticks _elaspedTicks;
 
+		utility::Arena* _arena = nullptr;
+
 		std::vector<IScriptEntry>  _entries;
 		std::shared_ptr<uint8_t[]> _scriptData;
 		int                        _scriptDataSize;
@@ -7,6 +7,7 @@
 #include <array>
 #include <CascLib.h>
 #include <cassert>
+#include <cmath>
 #include <commdlg.h> // windows only
 #include <cstring>
 #include <fileapi.h>
@@ -14,6 +15,7 @@
 #include <iostream>
 #include <memory>
 #include <minwindef.h>
+#include <random>
 #include <stdexcept>
 #include <unistd.h>
 #include <unordered_map>
@@ -49,11 +51,15 @@
 #include <data/Images.hpp>
 #include <filesystem/MpqArchive.hpp>
 #include <filesystem/Storage.hpp>
+#include <utility/Arena.hpp>
+#include <utility/JobGraph.hpp>
 
 #include <vulkan/Api.hpp>
 
 #include "data/Tile.hpp"
 #include "data/Map.hpp"
+#include "data/MapSnapshot.hpp"
+#include "data/Terrain.hpp"
 #include "data/Sprite.hpp"
 #include "data/TextStrings.hpp"
 #include "data/Tileset.hpp"
@@ -61,6 +67,8 @@
 #include "entity/ScriptedDoodad.hpp"
 
 #include "vulkan/VulkanGraphics.hpp"
+#include "vulkan/memory/TlsfAllocator.hpp"
+#include "SpriteSheetCache.hpp"
 #include <diagnostic/Clock.hpp>
 
 using boost::format;
@@ -78,6 +86,9 @@ using data::tileGroupID;
 using data::tileVariation;
 
 using data::MapInfo;
+using data::ChunkedTerrain;
+using data::TerrainChunk;
+using data::TERRAIN_CHUNK_SIZE;
 using data::TilesetData;
 using data::position;
 using data::ImagesTable;
@@ -112,26 +123,103 @@ void initSDL()
 	}
 }
 
-struct App {
-	SDL_Renderer* renderer = nullptr;
-	SDL_Window*	  window = nullptr;
-	SDL_Surface*  screenSurface = nullptr;
+// Everything that belongs to one opened map. A new map is loaded
+//  into its own state while the current one keeps rendering.
+struct MapState {
+	// Owns every block loaded for the map, so it's destroyed last
+	std::unique_ptr<utility::Arena> arena;
 
 	MapInfo mapInfo;
 
 	TilesetData    tilesetData;
 
-	DrawableHandle tilesetView;
+	// Tiles resolved ahead of time, only set when map comes from a snapshot
+	shared_ptr<tileID[]> resolvedTiles;
+
+	DrawableHandle tilesetView = nullptr;
+
+	// Terrain resolved on GPU. Tilemap holds a window of chunks around the view,
+	//  chunk (x, y) goes to slot (x mod columns, y mod rows). Slots keep the index
+	//  of the chunk uploaded there, or -1 when they are empty.
+	DrawableHandle      tilemapView = nullptr;
+	glm::vec<2, int>    windowChunks = { 0, 0 };
+	vector<int>         windowSlots;
 
 	IScriptEngine                        scriptEngine;
 	vector<shared_ptr<ScriptedDoodad>>   scriptedDoodads;
 
+	unordered_map<data::grpID, DrawableHandle> loadedSprites;
+
+	ChunkedTerrain terrain;
+};
+
+// Map being prepared by worker threads. Only GPU uploads are left
+//  for the main thread, they run at a frame boundary once jobs are done.
+struct MapLoad {
+	string mapPath;
+
+	std::unique_ptr<MapState> map;
+
+	data::SnapshotKey snapshotKey;
+	string            snapshotPath;
+	data::MapSnapshot snapshot;
+
+	bool        fromSnapshot = false;
+	bool        canSnapshot  = false;
+	const char* loadKind;
+
+	vector<bool>           usedTiles;
+	renderer::TilesetAtlas tilesetAtlas;
+
+	// Pixels of frames of newly loaded sprite sheets, before and after margins are trimmed
+	uint64_t frameArea = 0, trimmedFrameArea = 0;
+
+	uint64_t startCounter;
+
+	// Declared last so workers are joined before the data they use is gone
+	utility::JobGraph jobs;
+};
+
+// Draws issued and time spent on them, render path is switched with 'i'
+struct DrawRate {
+	uint64_t draws   = 0;
+	double   seconds = 0.0;
+};
+
+struct App {
+	// Arena of the retired map, the next load reuses its slabs
+	std::unique_ptr<utility::Arena> spareArena;
+
+	SDL_Renderer* renderer = nullptr;
+	SDL_Window*	  window = nullptr;
+	SDL_Surface*  screenSurface = nullptr;
+
+	vector<EntryName> ignoredMapEntries;
+
+	std::unique_ptr<MapState> map;
+	std::unique_ptr<MapLoad>  pendingLoad;
+
 	shared_ptr<renderer::A_Graphics> graphics;
 	data::Assets assets;
 
-	unordered_map<data::grpID, DrawableHandle> loadedSprites;
+	// Sprite sheets outlive maps, most doodads are shared between them
+	std::unique_ptr<renderer::SpriteSheetCache> spriteCache;
+
+	bool anyMapLoaded = false;
+
+	bool     instancedDraws = true;
+	DrawRate instancedRate, vertexRate;
 
-	tileID tiles[256][256];
+	// Reused by every frame to collect batched draws
+	vector<renderer::DrawItem> drawItems;
+
+	bool benchmarkDraws = false;
+
+	// Terrain is one tilemap draw instead of a quad per tile, switched with 't'
+	bool tilemapTerrain = true;
+
+	// Palettized draws go through the 8 bit target, enabled with --indexed
+	bool indexedRendering = false;
 
 	audio::AudioManager audioManager;
 	audio::MusicPlayer musicPlayer;
@@ -186,7 +274,11 @@ void freeWindow(App& app)
 
 void initializeGraphicsAPI(App& app)
 {
-	app.graphics = renderer::vulkan::CreateGraphics(app.window, &app.assets);
+	renderer::GraphicsSettings settings;
+	settings.indexedRendering = app.indexedRendering;
+
+	app.graphics    = renderer::vulkan::CreateGraphics(app.window, &app.assets, settings);
+	app.spriteCache = std::make_unique<renderer::SpriteSheetCache>(app.graphics.get());
 }
 
 void initializeAudio(App& app)
@@ -234,81 +326,355 @@ bool showOpenDialog(char* out, int size, HWND hwnd)
 
 enum Move : int { Up = 0x01, Down = 0x02, Left = 0x04, Right = 0x08 };
 
-void loadMap(App& app, const string& mapPath, Storage& storage)
+void loadMap(MapState& map, const string& mapPath, Storage& storage)
 {
 	filesystem::MpqArchive mapFile(mapPath.c_str());
 
-	data::ReadMap(mapFile, app.mapInfo);
-	data::LoadTilesetData(storage, app.mapInfo.tileset, app.tilesetData);
+	data::ReadMap(mapFile, map.mapInfo, map.arena.get());
+	data::LoadTilesetData(storage, map.mapInfo.tileset, map.tilesetData, map.arena.get());
+}
+
+// Draws items one by one and then as a batch, both land in the frame
+void benchmarkDraws(App& app, DrawableHandle drawable, const vector<renderer::DrawItem>& items)
+{
+	if (items.empty())
+		return;
+
+	uint64_t start = SDL_GetPerformanceCounter();
+
+	for (auto& item : items)
+		app.graphics->Draw(drawable, item.frame, item.pos);
+
+	uint64_t single = SDL_GetPerformanceCounter() - start;
+
+	start = SDL_GetPerformanceCounter();
+
+	app.graphics->DrawBatch(drawable, items);
+
+	uint64_t batch = SDL_GetPerformanceCounter() - start;
+
+	double toNanoseconds = 1e9 / SDL_GetPerformanceFrequency() / items.size();
+
+	auto report = format("Draw cost (%1%, %2% items): %3$.1f ns per Draw(), %4$.1f ns per DrawBatch() item")
+		% (app.instancedDraws ? "instanced" : "vertices") % items.size()
+		% (single * toNanoseconds) % (batch * toNanoseconds);
+
+	std::cout << report << std::endl;
+}
+
+// Free list of offsets kept in one vector, first region that fits is taken
+//  and neighbours are merged by sorting on free. What memory blocks used
+//  before TlsfAllocator, kept to compare against it
+struct FirstFitAllocator
+{
+	struct Region
+	{
+		uint64_t offset, size;
+	};
 
-	memset(app.tiles, 0, sizeof(app.tiles));
+	vector<Region>                         freeRegions;
+	std::unordered_map<uint64_t, uint64_t> sizes;
 
-	for(int i = 0; i < app.mapInfo.dimensions.x; i++)
-	for(int j = 0; j < app.mapInfo.dimensions.y; j++)
+	FirstFitAllocator(uint64_t size) : freeRegions { { 0, size } } {}
+
+	uint64_t Allocate(uint64_t size, uint64_t alignment)
 	{
-		if (app.tiles[i][j] != 0)
-			continue;
+		auto it = std::find_if(freeRegions.begin(), freeRegions.end(), [size, alignment] (const Region& region) {
+			return data::Aligned(region.offset, alignment) - region.offset + size <= region.size;
+		});
+
+		if (it == freeRegions.end())
+			return renderer::vulkan::TlsfAllocator::NoSpace;
 
-		auto [tileGroupID, variation] = app.mapInfo.GetTile(i, j);
-		auto tileGroup = app.tilesetData.tileGroups[tileGroupID];
-		tileID tileID;
+		auto region  = *it;
+		auto aligned = data::Aligned(region.offset, alignment);
+
+		freeRegions.erase(it);
+
+		if (aligned > region.offset)
+			freeRegions.push_back({ region.offset, aligned - region.offset });
+
+		if (region.offset + region.size > aligned + size)
+			freeRegions.push_back({ aligned + size, region.offset + region.size - aligned - size });
+
+		sizes[aligned] = size;
+
+		return aligned;
+	}
 
-		if (app.tilesetData.IsDoodad(tileGroupID))
+	void Free(uint64_t offset)
+	{
+		freeRegions.push_back({ offset, sizes[offset] });
+		sizes.erase(offset);
+
+		std::sort(freeRegions.begin(), freeRegions.end(), [] (const Region& a, const Region& b) { return a.offset < b.offset; });
+
+		vector<Region> merged = { freeRegions[0] };
+
+		for (std::size_t i = 1; i < freeRegions.size(); i++)
 		{
-			tileID = tileGroup.terrain.variations[variation];
+			auto& last = merged.back();
+
+			if (freeRegions[i].offset <= last.offset + last.size)
+				last.size = std::max(last.offset + last.size, freeRegions[i].offset + freeRegions[i].size) - last.offset;
+			else
+				merged.push_back(freeRegions[i]);
 		}
-		else
+
+		freeRegions = std::move(merged);
+	}
+
+	double GetFragmentation() const
+	{
+		uint64_t freeSize = 0, largest = 0;
+
+		for (auto& region : freeRegions)
 		{
-			tileID = tileGroup.doodad.tiles[variation];
+			freeSize += region.size;
+			largest   = std::max(largest, region.size);
 		}
 
-		app.tiles[i][j] = tileID;
+		return freeSize == 0 ? 0.0 : 1.0 - double(largest) / freeSize;
 	}
+};
+
+double getFragmentation(const renderer::vulkan::TlsfAllocator& allocator)
+{
+	auto info = allocator.GetFreeSpaceInfo();
+
+	return info.freeSize == 0 ? 0.0 : 1.0 - double(info.largestFreeRegion) / info.freeSize;
+}
+
+// Map switches in one memory block: every switch frees most resources and
+//  loads new ones. Same seed for both allocators, so they get the same requests
+template<typename Allocator>
+void simulateMapSwitches(const char* name, Allocator allocator)
+{
+	const int      switchCount   = 50;
+	const int      loadedPerMap  = 120;
+	const double   freedPerMap   = 0.7;
+
+	std::mt19937                           random(1);
+	std::uniform_real_distribution<double> sizeExponent(12.0, 22.0);  // 4 KB to 4 MB
+	std::uniform_int_distribution<int>     alignmentExponent(8, 12);  // 256 B to 4 KB
+
+	vector<uint64_t> live;
+	uint64_t         operations = 0, failed = 0;
+
+	uint64_t start = SDL_GetPerformanceCounter();
+
+	for (int i = 0; i < switchCount; i++)
+	{
+		std::shuffle(live.begin(), live.end(), random);
+
+		auto freed = static_cast<std::size_t>(live.size() * freedPerMap);
+
+		for (std::size_t j = 0; j < freed; j++)
+		{
+			allocator.Free(live.back());
+			live.pop_back();
+			operations++;
+		}
+
+		for (int j = 0; j < loadedPerMap; j++)
+		{
+			auto size      = static_cast<uint64_t>(std::exp2(sizeExponent(random)));
+			auto alignment = uint64_t(1) << alignmentExponent(random);
+			auto offset    = allocator.Allocate(size, alignment);
+
+			operations++;
+
+			if (offset == renderer::vulkan::TlsfAllocator::NoSpace)
+				failed++;
+			else
+				live.push_back(offset);
+		}
+	}
+
+	double nanoseconds = 1e9 * (SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency() / operations;
+
+	double fragmentation;
+
+	if constexpr (std::is_same_v<Allocator, FirstFitAllocator>)
+		fragmentation = allocator.GetFragmentation();
+	else
+		fragmentation = getFragmentation(allocator);
+
+	auto report = format("Allocator (%1%): %2$.0f ns per operation, fragmentation %3$.2f, %4% of %5% allocations failed")
+		% name % nanoseconds % fragmentation % failed % (switchCount * loadedPerMap);
+
+	std::cout << report << std::endl;
+}
+
+// Device memory sub-allocation over 50 simulated map switches in an 80 MB block
+void benchmarkAllocator()
+{
+	const uint64_t blockSize = 80ull * 1024 * 1024;
+
+	simulateMapSwitches("TLSF", renderer::vulkan::TlsfAllocator(blockSize));
+	simulateMapSwitches("first fit", FirstFitAllocator(blockSize));
+}
+
+// Keeps chunks of the view (in tiles) in the tilemap window. Chunks are uploaded
+//  once they are resident and stay until the view moves away from their slot,
+//  so GPU memory depends on the screen, not on the map.
+void uploadTerrain(App& app, MapState& map, int left, int top, int right, int bottom)
+{
+	map.terrain.Update(left, top, right, bottom);
+
+	auto chunkCount = map.terrain.GetChunkCount();
+
+	for (int chunkX = left / TERRAIN_CHUNK_SIZE; chunkX * TERRAIN_CHUNK_SIZE < right; chunkX++)
+	for (int chunkY = top / TERRAIN_CHUNK_SIZE; chunkY * TERRAIN_CHUNK_SIZE < bottom; chunkY++)
+	{
+		int  index = chunkX + chunkY * chunkCount.x;
+		int& slot  = map.windowSlots[chunkX % map.windowChunks.x + chunkY % map.windowChunks.y * map.windowChunks.x];
+
+		if (slot == index)
+			continue;
+
+		int chunkLeft = chunkX * TERRAIN_CHUNK_SIZE;
+		int chunkTop  = chunkY * TERRAIN_CHUNK_SIZE;
+		int width     = std::min<int>(TERRAIN_CHUNK_SIZE, map.mapInfo.dimensions.x - chunkLeft);
+		int height    = std::min<int>(TERRAIN_CHUNK_SIZE, map.mapInfo.dimensions.y - chunkTop);
+
+		const TerrainChunk* chunk = map.terrain.FindChunk(chunkX, chunkY);
+
+		// Chunk is still being resolved, the one that left the slot must not show meanwhile
+		if (chunk == nullptr)
+		{
+			if (slot != -1)
+				app.graphics->UpdateTilemap(map.tilemapView, chunkLeft, chunkTop, width, height, nullptr, TERRAIN_CHUNK_SIZE);
+
+			slot = -1;
+			continue;
+		}
+
+		app.graphics->UpdateTilemap(map.tilemapView, chunkLeft, chunkTop, width, height, &chunk->tiles[0][0], TERRAIN_CHUNK_SIZE);
+
+		slot = index;
+	}
+
+	app.graphics->SetTilemapView(map.tilemapView, left, top, right - left, bottom - top);
 }
 
 void drawMap(App &app, const position pos) {
 
-	if (app.mapInfo.dimensions.x == 0 || app.mapInfo.dimensions.y == 0)
+	if (app.map == nullptr)
+		return;
+
+	auto& map = *app.map;
+
+	if (map.mapInfo.dimensions.x == 0 || map.mapInfo.dimensions.y == 0)
 		return;
 
 	{
 		Clock clock("BeginRendering()");
 
 		app.graphics->BeginRendering();
-		app.graphics->SetTilesetPalette(app.tilesetData.palette);
+		app.graphics->SetTilesetPalette(map.tilesetData.palette);
+		app.graphics->SetPaletteTick(app.currentTick);
 		app.graphics->SetView(pos);
 	}
 
+	uint64_t drawStart = SDL_GetPerformanceCounter();
+	uint64_t draws     = 0;
+
 	int leftBorderIndex  = std::max<int>(0, pos.x / TILE_SIZE);
-	int rightBorderIndex = std::min<int>(app.mapInfo.dimensions.x, (pos.x + SCREEN_WIDTH) / TILE_SIZE + 1);
+	int rightBorderIndex = std::min<int>(map.mapInfo.dimensions.x, (pos.x + SCREEN_WIDTH) / TILE_SIZE + 1);
 	int upBorderIndex    = std::max<int>(0, pos.y / TILE_SIZE);
-	int downBorderIndex  = std::min<int>(app.mapInfo.dimensions.y, (pos.y + SCREEN_HEIGHT) / TILE_SIZE + 1);
+	int downBorderIndex  = std::min<int>(map.mapInfo.dimensions.y, (pos.y + SCREEN_HEIGHT) / TILE_SIZE + 1);
 
+	if (app.tilemapTerrain)
 	{
-		Clock clock("RenderTiles()");
+		Clock clock("RenderTiles(tilemap)");
 
-		for (int x = leftBorderIndex; x < rightBorderIndex; x++)
-		for (int y = upBorderIndex; y < downBorderIndex; y++)
+		uploadTerrain(app, map, leftBorderIndex, upBorderIndex, rightBorderIndex, downBorderIndex);
+
+		app.graphics->Draw(map.tilemapView, 0, { 0, 0 });
+		draws++;
+	}
+	else
+	{
+		Clock clock(app.instancedDraws ? "RenderTiles(instanced)" : "RenderTiles(vertices)");
+
+		map.terrain.Update(leftBorderIndex, upBorderIndex, rightBorderIndex, downBorderIndex);
+
+		app.drawItems.clear();
+
+		for (int chunkX = leftBorderIndex / TERRAIN_CHUNK_SIZE; chunkX * TERRAIN_CHUNK_SIZE < rightBorderIndex; chunkX++)
+		for (int chunkY = upBorderIndex / TERRAIN_CHUNK_SIZE; chunkY * TERRAIN_CHUNK_SIZE < downBorderIndex; chunkY++)
 		{
-			tileID tileId = app.tiles[x][y];
+			// Chunk is still being resolved, it will show up in the next frames
+			const TerrainChunk* chunk = map.terrain.FindChunk(chunkX, chunkY);
+
+			if (chunk == nullptr)
+				continue;
+
+			int chunkLeft = chunkX * TERRAIN_CHUNK_SIZE;
+			int chunkTop  = chunkY * TERRAIN_CHUNK_SIZE;
 
-			app.graphics->Draw(app.tilesetView, tileId, { x * TILE_SIZE, y * TILE_SIZE });
+			for (int x = std::max(leftBorderIndex, chunkLeft); x < std::min(rightBorderIndex, chunkLeft + TERRAIN_CHUNK_SIZE); x++)
+			for (int y = std::max(upBorderIndex, chunkTop); y < std::min(downBorderIndex, chunkTop + TERRAIN_CHUNK_SIZE); y++)
+			{
+				tileID tileId = chunk->tiles[x - chunkLeft][y - chunkTop];
+
+				app.drawItems.push_back({ { x * TILE_SIZE, y * TILE_SIZE }, tileId });
+			}
 		};
+
+		if (app.benchmarkDraws)
+		{
+			benchmarkDraws(app, map.tilesetView, app.drawItems);
+			app.benchmarkDraws = false;
+		}
+
+		app.graphics->DrawBatch(map.tilesetView, app.drawItems);
+		draws += app.drawItems.size();
 	}
 
 	{
-		Clock clock("RenderSprites()");
-		for(auto& doodad : app.scriptedDoodads)
+		Clock clock(app.instancedDraws ? "RenderSprites(instanced)" : "RenderSprites(vertices)");
+
+		// Doodads cover terrain in map order, sheets share the sprite atlas so
+		//  neighbouring doodads of different sheets still go in one batch
+		app.graphics->SetLayer(1);
+
+		// Consecutive doodads of one sheet go in one batch
+		DrawableHandle batchSheet = nullptr;
+		app.drawItems.clear();
+
+		for(auto& doodad : map.scriptedDoodads)
 		{
 			auto grpID = doodad->grpID;
 			auto frame = doodad->GetCurrentFrame();
-			auto spriteSheet = app.loadedSprites[grpID];
+			auto spriteSheet = map.loadedSprites[grpID];
+
+			if (spriteSheet != batchSheet)
+			{
+				app.graphics->DrawBatch(batchSheet, app.drawItems);
+				app.drawItems.clear();
+
+				batchSheet = spriteSheet;
+			}
 
-			app.graphics->Draw(spriteSheet, frame, doodad->pos);
+			app.drawItems.push_back({ doodad->pos, frame });
 		}
+
+		app.graphics->DrawBatch(batchSheet, app.drawItems);
+		draws += map.scriptedDoodads.size();
 	}
 
-	app.graphics->PresentToScreen();
+	{
+		Clock clock(app.instancedDraws ? "PresentToScreen(instanced)" : "PresentToScreen(vertices)");
+
+		app.graphics->PresentToScreen();
+	}
+
+	auto& rate = app.instancedDraws ? app.instancedRate : app.vertexRate;
+
+	rate.draws   += draws;
+	rate.seconds += static_cast<double>(SDL_GetPerformanceCounter() - drawStart) / SDL_GetPerformanceFrequency();
 }
 
 void processMoveInput(glm::vec<2, double>& pos, int &move, double deltaTime)
@@ -329,7 +695,18 @@ void processMoveInput(glm::vec<2, double>& pos, int &move, double deltaTime)
 	pos.y += y * speed * deltaTime;
 }
 
-void placeScriptedDoodads(App& app, Storage& storage)
+void initScriptEngine(MapState& map, Storage& storage)
+{
+	script::ReadIScriptFile(storage, "scripts/iscript.bin", map.scriptEngine);
+
+	map.scriptEngine.Clear();
+	map.scriptEngine.Init();
+	map.scriptEngine.SetArena(map.arena.get());
+	
+	map.scriptedDoodads.clear();
+}
+
+void placeScriptedDoodads(MapState& map, Storage& storage)
 {
 	SpriteTable spriteTable;
 	data::ReadSpriteTable(storage, spriteTable);
@@ -337,108 +714,503 @@ void placeScriptedDoodads(App& app, Storage& storage)
 	ImagesTable imagesTable;
 	data::ReadImagesTable(storage, imagesTable);
 
-	script::ReadIScriptFile(storage, "scripts/iscript.bin", app.scriptEngine);
-
-	app.scriptEngine.Clear();
-	app.scriptEngine.Init();
-	
-	app.scriptedDoodads.clear();
-
-	for(auto& doodad : app.mapInfo.sprites)
+	for(auto& doodad : map.mapInfo.sprites)
 	{
 		auto& imageID  = spriteTable.imageID[doodad.spriteID];
 		auto  grpID    = imagesTable.grpID[imageID] - 1;
 		auto  scriptID = imagesTable.iScriptID[imageID];
 		auto  pos      = doodad.position;
 
-		auto instance = std::make_shared<ScriptedDoodad>(scriptID, grpID, pos);
+		auto instance = utility::MakeShared<ScriptedDoodad>(map.arena.get(), scriptID, grpID, pos);
 
-		app.scriptEngine.RunScriptableObject(instance);
-		app.scriptedDoodads.push_back(instance);
+		map.scriptEngine.RunScriptableObject(instance);
+		map.scriptedDoodads.push_back(instance);
 	}
 }
 
-void loadTileset(App& app, Storage& storage)
+void findUsedTiles(MapState& map, vector<bool>& usedTiles)
 {
-	if (app.tilesetView != nullptr)
-	{
-		app.graphics->FreeDrawable(app.tilesetView);
-		app.tilesetView = nullptr;
-	}
+	usedTiles.assign(map.tilesetData.GetTileCount(), false);
 
-	vector<bool> usedTiles(app.tilesetData.GetTileCount(), false);
-
-	for(int i = 0; i < app.mapInfo.dimensions.x; i++)
-	for(int j = 0; j < app.mapInfo.dimensions.y; j++)
+	// Single pass over the raw terrain, resolved tiles aren't kept
+	//  unless they come from a snapshot
+	for(int i = 0; i < map.mapInfo.dimensions.x; i++)
+	for(int j = 0; j < map.mapInfo.dimensions.y; j++)
 	{
-		tileID tileID = app.tilesetData.GetMappedIndex(app.tiles[i][j]);
+		tileID resolved = map.resolvedTiles != nullptr
+			? map.resolvedTiles[i + j * map.mapInfo.dimensions.x]
+			: data::ResolveTile(map.mapInfo, map.tilesetData, i, j);
+
+		tileID tileID = map.tilesetData.GetMappedIndex(resolved);
 
 		usedTiles[tileID] = true;
 	};
-
-	app.tilesetView = app.graphics->LoadTileset(app.tilesetData, usedTiles);
 }
 
-void loadDoodadGrps(App& app, Storage& storage)
+void loadDoodadGrps(MapState& map, Storage& storage, vector<data::SnapshotGrp>& loadedGrps)
 {
 	data::StringsTable imageStrings;
 	data::ReadTextStringsTable(storage, "arr/images.tbl", imageStrings);
 
-	for(auto& doodad : app.scriptedDoodads)
-	{
-		uint8_t pixels[data::GRP_SPRITE_SQUARE_LIMIT];
+	std::unordered_set<data::grpID> readGrps;
 
-		if (app.loadedSprites.contains(doodad->grpID))
+	for(auto& doodad : map.scriptedDoodads)
+	{
+		if (!readGrps.insert(doodad->grpID).second)
 			continue;
 
 		auto grpPath = imageStrings.entries[doodad->grpID];
-		auto grp = Grp::ReadGrpFile(storage, grpPath);
+		auto grp = Grp::ReadGrpFile(storage, grpPath, map.arena.get());
 
-		app.loadedSprites[doodad->grpID] = app.graphics->LoadSpriteSheet(grp);
+		loadedGrps.push_back({ doodad->grpID, grp.GetData(), grp.GetDataSize() });
 	}
 }
 
-bool tryOpenMap(App& app, const char* mapPath, Storage& storage)
+// Doodads must be captured before the first script tick.
+//  Returns false if some doodad doesn't fit into the snapshot.
+bool captureDoodads(MapState& map, data::MapSnapshot& snapshot)
 {
-	app.graphics->WaitIdle();
-	
-	try
+	for(auto& doodad : map.scriptedDoodads)
+	{
+		data::SnapshotDoodad captured = {};
+
+		captured.scriptID    = doodad->GetScriptID();
+		captured.grpID       = doodad->grpID;
+		captured.x           = doodad->pos.x;
+		captured.y           = doodad->pos.y;
+		captured.scriptState = doodad->GetScriptState();
+
+		if (captured.scriptState.stateCount > data::SNAPSHOT_MAX_SCRIPT_STATES)
+			return false;
+
+		memcpy(captured.stateOffsets, doodad->GetStateOffsets(), captured.scriptState.stateCount * sizeof(uint16_t));
+
+		snapshot.doodads.push_back(captured);
+	}
+
+	return true;
+}
+
+void writeMapSnapshot(MapState& map, const string& snapshotPath, const data::SnapshotKey& key, data::MapSnapshot& snapshot)
+{
+	auto& dimensions = map.mapInfo.dimensions;
+
+	snapshot.mapInfo       = map.mapInfo;
+	snapshot.tilesetData   = map.tilesetData;
+	snapshot.resolvedTiles = std::make_shared<tileID[]>(dimensions.x * dimensions.y);
+
+	for(int i = 0; i < dimensions.x; i++)
+	for(int j = 0; j < dimensions.y; j++)
+	{
+		snapshot.resolvedTiles[i + j * dimensions.x] = data::ResolveTile(map.mapInfo, map.tilesetData, i, j);
+	}
+
+	data::WriteMapSnapshot(snapshotPath.c_str(), key, snapshot);
+}
+
+void restoreMapData(MapState& map, data::MapSnapshot& snapshot)
+{
+	auto ignoredEntries = map.mapInfo.ignoredEntries;
+
+	map.mapInfo                = snapshot.mapInfo;
+	map.mapInfo.ignoredEntries = ignoredEntries;
+	map.tilesetData            = snapshot.tilesetData;
+	map.resolvedTiles          = snapshot.resolvedTiles;
+}
+
+void restoreDoodads(MapState& map, data::MapSnapshot& snapshot)
+{
+	for(auto& doodad : snapshot.doodads)
+	{
+		auto& scriptState = doodad.scriptState;
+
+		auto instance = utility::MakeShared<ScriptedDoodad>(map.arena.get(), doodad.scriptID, doodad.grpID, position { doodad.x, doodad.y });
+		auto states   = utility::MakeShared<uint16_t[]>(map.arena.get(), scriptState.stateCount);
+
+		memcpy(states.get(), doodad.stateOffsets, scriptState.stateCount * sizeof(uint16_t));
+
+		instance->RestoreScriptState(scriptState, states);
+
+		map.scriptEngine.AttachScriptableObject(instance);
+		map.scriptedDoodads.push_back(instance);
+	}
+}
+
+// GPU resources are created on the main thread only
+void uploadMap(App& app, MapLoad& load)
+{
+	auto& map = *load.map;
+
+	map.tilesetView = app.graphics->LoadTileset(map.tilesetData, std::move(load.tilesetAtlas));
+
+	auto chunkCount = map.terrain.GetChunkCount();
+
+	// View can straddle one chunk more than it covers
+	map.windowChunks.x = std::min(chunkCount.x, (SCREEN_WIDTH / TILE_SIZE + 2) / TERRAIN_CHUNK_SIZE + 2);
+	map.windowChunks.y = std::min(chunkCount.y, (SCREEN_HEIGHT / TILE_SIZE + 2) / TERRAIN_CHUNK_SIZE + 2);
+	map.windowSlots.assign(map.windowChunks.x * map.windowChunks.y, -1);
+
+	map.tilemapView = app.graphics->CreateTilemap(map.tilesetView, 
+		map.windowChunks.x * TERRAIN_CHUNK_SIZE, map.windowChunks.y * TERRAIN_CHUNK_SIZE);
+
+	for(auto& grp : load.snapshot.grps)
+	{
+		auto spriteSheet = app.spriteCache->TryAcquire(grp.id);
+
+		if (spriteSheet == nullptr)
+		{
+			// Frames are decoded when first drawn, long after the map arena or
+			//  the mapped snapshot holding the file may be gone
+			std::shared_ptr<uint8_t[]> fileData(new uint8_t[grp.size]);
+			memcpy(fileData.get(), grp.data.get(), grp.size);
+
+			auto grpData = std::make_shared<Grp>(Grp::ReadGrp(fileData, grp.size));
+
+			for(int i = 0; i < grpData->GetSpriteCount(); i++)
+			{
+				auto full    = grpData->GetFrame(i).dimensions;
+				auto trimmed = grpData->GetBounds(i).dimensions;
+
+				load.frameArea        += full.x * full.y;
+				load.trimmedFrameArea += trimmed.x * trimmed.y;
+			}
+
+			spriteSheet = app.spriteCache->Acquire(grp.id, grpData);
+		}
+
+		map.loadedSprites[grp.id] = spriteSheet;
+	}
+}
+
+// Drops every reference to the blocks of the map so the whole
+//  arena can be rewound at once and handed to the next load.
+//  GPU must not use the map's resources anymore.
+void retireMap(App& app, std::unique_ptr<MapState> map)
+{
+	if (map == nullptr)
+		return;
+
+	// Streaming worker must not read the map while it's being freed
+	map->terrain.Close();
+
+	// Sheets stay in cache, they are freed only when it's trimmed
+	for(auto& [grpID, _] : map->loadedSprites)
+	{
+		app.spriteCache->Release(grpID);
+	}
+
+	// Tilemap samples the tileset, it goes first
+	if (map->tilemapView != nullptr)
+	{
+		app.graphics->FreeDrawable(map->tilemapView);
+	}
+
+	if (map->tilesetView != nullptr)
+	{
+		app.graphics->FreeDrawable(map->tilesetView);
+	}
+
+	auto arena = std::move(map->arena);
+
+	map.reset();
+
+	arena->Release();
+
+	app.spareArena = std::move(arena);
+}
+
+void reportMapArena(MapState& map)
+{
+	auto stats = map.arena->GetStats();
+
+	// Every arena allocation used to be a separate heap allocation
+	auto report = format("Map arena: %1% bytes in %2% allocations served by %3% system allocations (%4% slabs, %5% bytes reserved)")
+		% stats.bytesUsed % stats.allocationCount % stats.slabAllocations % stats.slabCount % stats.bytesReserved;
+
+	std::cout << report << std::endl;
+}
+
+void reportSpriteCache(App& app)
+{
+	auto stats = app.spriteCache->TakeStats();
+
+	auto report = format("Sprite cache: %1% sheets (%2% bytes) reused, %3% (%4% bytes) loaded, %5% (%6% bytes) evicted, %7% sheets (%8% bytes) resident")
+		% stats.reusedSheets % stats.reusedBytes
+		% stats.loadedSheets % stats.loadedBytes
+		% stats.evictedSheets % stats.evictedBytes
+		% app.spriteCache->GetResidentCount() % app.spriteCache->GetResidentBytes();
+
+	std::cout << report << std::endl;
+}
+
+void reportDrawRates(App& app)
+{
+	for (auto [name, rate] : { std::pair("instanced", app.instancedRate), std::pair("vertices", app.vertexRate) })
+	{
+		if (rate.seconds == 0.0)
+			continue;
+
+		auto report = format("Draw rate (%1%): %2% draws in %3$.3f s, %4$.1f draws/ms")
+			% name % rate.draws % rate.seconds % (rate.draws / (rate.seconds * 1000.0));
+
+		std::cout << report << std::endl;
+	}
+
+	app.instancedRate = DrawRate();
+	app.vertexRate    = DrawRate();
+
+	auto statistics = app.graphics->GetRenderStatistics();
+
+	auto report = format("Last frame: %1% draw calls recorded as %2% draws, %3% pipeline binds, %4% descriptor set binds")
+		% statistics.drawCalls % statistics.recordedDraws % statistics.pipelineBinds % statistics.descriptorSetBinds;
+
+	std::cout << report << std::endl;
+
+	auto& sprites = statistics.sprites;
+
+	auto residency = format("Sprite frames: %1% resident (%2$.1f MB), last frame uploaded %3% (%4$.1f KB), %5% placeholders, %6% pages evicted")
+		% sprites.residentFrames % (sprites.residentBytes / (1024.0 * 1024.0)) % sprites.uploadedFrames % (sprites.uploadedBytes / 1024.0)
+		% sprites.placeholderFrames % sprites.evictedPages;
+
+	std::cout << residency << std::endl;
+
+	if (sprites.usedPages > 0)
+	{
+		auto packing = format("Sprite atlas: %1% of %2% pages used, %3$.1f%% of their area holds resident frames")
+			% sprites.usedPages % sprites.pageCount % (100.0 * sprites.residentBytes / (sprites.usedPages * sprites.pageBytes));
+
+		std::cout << packing << std::endl;
+	}
+}
+
+void reportMapLoad(MapLoad& load, double uploadTime, double totalTime)
+{
+	std::cout << format("Map loaded in %1$.2f ms (%2%)") % (totalTime * 1000.0) % load.loadKind << std::endl;
+
+	for(auto& timing : load.jobs.GetTimings())
+	{
+		std::cout << format("  %1%: %2$.2f ms") % timing.name % (timing.seconds * 1000.0) << std::endl;
+	}
+
+	std::cout << format("  UploadToGpu: %1$.2f ms") % (uploadTime * 1000.0) << std::endl;
+
+	// Trimmed pixels take no atlas space and aren't covered by quads
+	if (load.frameArea > 0)
 	{
+		std::cout << format("  Sprite frames: %1% of %2% pixels left after trimming (%3$.1f%% less area and overdraw)")
+			% load.trimmedFrameArea % load.frameArea % (100.0 - 100.0 * load.trimmedFrameArea / load.frameArea) << std::endl;
+	}
+}
+
+// Starts loading on worker threads, current map keeps running meanwhile.
+//  The stages form a dependency graph, independent ones run in parallel.
+void startMapLoad(App& app, const char* mapPath, Storage& storage)
+{
+	auto load = std::make_unique<MapLoad>();
 
-		loadMap(app, mapPath, storage);
+	load->mapPath      = mapPath;
+	load->startCounter = SDL_GetPerformanceCounter();
 
-		for(auto& [_, spriteSheet] : app.loadedSprites)
+	// Cold is the first load from the storage in this session,
+	//  warm one finds storage files already in the system cache
+	load->loadKind = app.anyMapLoaded ? "warm" : "cold";
+
+	load->map = std::make_unique<MapState>();
+	load->map->arena = app.spareArena != nullptr ? std::move(app.spareArena) : std::make_unique<utility::Arena>();
+	load->map->mapInfo.ignoredEntries = app.ignoredMapEntries;
+
+	auto& l    = *load;
+	auto& map  = *load->map;
+	auto& jobs = load->jobs;
+
+	auto readSnapshot = jobs.Add("ReadSnapshot", [&l, &map] {
+
+		l.snapshotKey  = data::SnapshotKey::FromFile(l.mapPath.c_str());
+		l.snapshotPath = data::GetSnapshotPath(l.mapPath.c_str());
+		l.fromSnapshot = data::ReadMapSnapshot(l.snapshotPath.c_str(), l.snapshotKey, l.snapshot);
+
+		if (l.fromSnapshot)
 		{
-			app.graphics->FreeDrawable(spriteSheet);
+			l.loadKind = "snapshot";
+
+			restoreMapData(map, l.snapshot);
 		}
+		else
+		{
+			// Rejected snapshot may be read partially
+			l.snapshot = data::MapSnapshot();
+		}
+	});
 
-		app.loadedSprites.clear();
+	auto readMap = jobs.Add("ReadMap", [&l, &map, &storage] {
 
-		loadTileset(app, storage);
-		placeScriptedDoodads(app, storage);
-		loadDoodadGrps(app, storage);
+		if (!l.fromSnapshot)
+			loadMap(map, l.mapPath, storage);
 
-		app.scriptEngine.Process();
+	}, { readSnapshot });
 
-		return true;
+	// Storage serializes its reads, jobs reading it may run at the same time
+	auto initScripts = jobs.Add("InitScripts", [&map, &storage] {
+
+		initScriptEngine(map, storage);
+	});
+
+	auto usedTiles = jobs.Add("FindUsedTiles", [&l, &map] {
+
+		findUsedTiles(map, l.usedTiles);
+
+	}, { readMap });
+
+	// Only the upload of the atlas is left for the main thread
+	jobs.Add("BakeTileset", [&l, &map, &app] {
+
+		l.tilesetAtlas = app.graphics->BakeTileset(map.tilesetData, l.usedTiles);
+
+	}, { usedTiles });
+
+	auto terrain = jobs.Add("PreloadTerrain", [&map] {
+
+		// Tiles are resolved lazily by chunks around the camera,
+		//  view is reset to the top left corner after opening
+		map.terrain.Open(&map.mapInfo, &map.tilesetData, map.resolvedTiles.get());
+		map.terrain.Preload(0, 0, SCREEN_WIDTH / TILE_SIZE + 1, SCREEN_HEIGHT / TILE_SIZE + 1);
+
+	}, { readMap });
+
+	auto doodads = jobs.Add("PlaceDoodads", [&l, &map, &storage] {
+
+		if (l.fromSnapshot)
+		{
+			restoreDoodads(map, l.snapshot);
+		}
+		else
+		{
+			placeScriptedDoodads(map, storage);
+			l.canSnapshot = captureDoodads(map, l.snapshot);
+		}
+
+	}, { readMap, initScripts });
+
+	auto grps = jobs.Add("ReadGrps", [&l, &map, &storage] {
+
+		if (!l.fromSnapshot)
+			loadDoodadGrps(map, storage, l.snapshot.grps);
+
+	}, { doodads });
+
+	jobs.Add("FirstScriptTick", [&map] {
+
+		map.scriptEngine.Process();
+
+	}, { doodads });
+
+	jobs.Add("WriteSnapshot", [&l, &map] {
+
+		if (!l.canSnapshot)
+			return;
+
+		// Map is usable without a snapshot, failure here isn't fatal
+		try
+		{
+			writeMapSnapshot(map, l.snapshotPath, l.snapshotKey, l.snapshot);
+		}
+		catch (std::exception& e)
+		{
+			std::cout << "Couldn't write map snapshot: " << e.what() << std::endl;
+		}
+
+	}, { grps, usedTiles, terrain });
+
+	jobs.Start();
+
+	app.pendingLoad = std::move(load);
+}
+
+// Water colors are rotated by the renderer from the game tick
+const uint32_t WATER_CYCLE_PERIOD = 3;
+
+void setPaletteCycles(App& app, MapState& map)
+{
+	if (!data::HasTileSetWater(map.mapInfo.tileset))
+	{
+		app.graphics->SetPaletteCycles({});
+		return;
+	}
+
+	std::array<renderer::PaletteCycle, 2> water = {{
+		{ 1, 6, WATER_CYCLE_PERIOD },
+		{ 7, 7, WATER_CYCLE_PERIOD },
+	}};
+
+	app.graphics->SetPaletteCycles(water);
+}
+
+// Swaps the loaded map in, must be called between frames.
+//  Blocks if the jobs are not finished yet.
+bool finishMapLoad(App& app)
+{
+	auto load = std::move(app.pendingLoad);
+
+	try
+	{
+		load->jobs.Wait();
+
+		uint64_t uploadStart = SDL_GetPerformanceCounter();
+
+		uploadMap(app, *load);
+
+		uint64_t end = SDL_GetPerformanceCounter();
+		double   frequency = SDL_GetPerformanceFrequency();
+
+		reportMapLoad(*load, (end - uploadStart) / frequency, (end - load->startCounter) / frequency);
 	}
 	catch (...)
 	{
-		std::cout << "Couldn't load file " << mapPath << std::endl;
+		std::cout << "Couldn't load file " << load->mapPath << std::endl;
+
+		auto map = std::move(load->map);
+		load.reset();
+
+		// Some of the uploads may have been recorded already
+		app.graphics->WaitIdle();
+
+		retireMap(app, std::move(map));
+
 		return false;
 	}
+
+	// Previous map may still be in flight
+	app.graphics->WaitIdle();
+
+	retireMap(app, std::move(app.map));
+
+	app.map = std::move(load->map);
+	app.anyMapLoaded = true;
+
+	setPaletteCycles(app, *app.map);
+
+	app.spriteCache->Trim();
+
+	reportMapArena(*app.map);
+	reportSpriteCache(app);
+
+	return true;
 }
 
+bool tryOpenMap(App& app, const char* mapPath, Storage& storage)
+{
+	startMapLoad(app, mapPath, storage);
+
+	return finishMapLoad(app);
+}
 
 
 void processInput(
 	App& app, Storage& storage, SDL_Keycode key, HWND& hwnd, 
 	int& moveInput, bool pressed, 
-	uint64_t& counter,             
-	glm::vec<2, double>& viewPos)
+	uint64_t& counter)
 {
 	char mapPath[260];
-	bool openedMapSuccessfully = false;
 
 	if (!pressed)
 	{
@@ -476,6 +1248,20 @@ void processInput(
 			break;
 		case SDLK_p:
 			ShowClockReports();
+			reportDrawRates(app);
+			break;
+		case SDLK_b:
+			app.benchmarkDraws = true;
+			break;
+		case SDLK_m:
+			benchmarkAllocator();
+			break;
+		case SDLK_t:
+			app.tilemapTerrain = !app.tilemapTerrain;
+			break;
+		case SDLK_i:
+			app.instancedDraws = !app.instancedDraws;
+			app.graphics->EnableInstancing(app.instancedDraws);
 			break;
 		case SDLK_o: {
 
@@ -485,22 +1271,11 @@ void processInput(
 
 			usleep(50000);
 
-			if (showOpenDialog(mapPath, sizeof(mapPath), hwnd)) {
-
-				openedMapSuccessfully = tryOpenMap(app, mapPath, storage);
-
-				if (!openedMapSuccessfully)
-
-					showLoadErrorMessage(hwnd, mapPath);
+			// Only one map is loaded at a time
+			if (app.pendingLoad == nullptr && showOpenDialog(mapPath, sizeof(mapPath), hwnd)) {
 
-				else
-				{
-					app.realTime     = 0.0;
-					app.currentTick  = 0;
-					app.nextGameTick = 0;
-				}
-
-				viewPos = { 0, 0 };
+				// Map is swapped in by the main loop when it's ready
+				startMapLoad(app, mapPath, storage);
 			}
 
 			diff = SDL_GetPerformanceCounter() - diff;
@@ -516,17 +1291,14 @@ void gameTick(App& app)
 {
 	Clock clock("GameTick()");
 
-	for(; app.nextGameTick < app.realTime; app.nextGameTick += 1.0 / app.tickRate)
-	{
-		app.scriptEngine.PlayNextFrame();
-
-		const int waterCycleFrequence = 3;
+	if (app.map == nullptr)
+		return;
 
-		if (data::HasTileSetWater(app.mapInfo.tileset) && (app.currentTick % waterCycleFrequence) == 0) {
+	auto& map = *app.map;
 
-			app.tilesetData.palette.cyclePaletteColor<1, 6>();
-			app.tilesetData.palette.cyclePaletteColor<7, 7>();
-		}
+	for(; app.nextGameTick < app.realTime; app.nextGameTick += 1.0 / app.tickRate)
+	{
+		map.scriptEngine.PlayNextFrame();
 
 		app.currentTick++;
 	}
@@ -536,10 +1308,22 @@ int main(int argc, char *argv[]) {
 
 	std::srand(std::time(nullptr));
 
-	auto storagePath = argv[1];
+	App app;
+
+	// Options may go anywhere, the rest are the storage and map paths
+	vector<char*> arguments;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--indexed") == 0)
+			app.indexedRendering = true;
+		else
+			arguments.push_back(argv[i]);
+	}
+
+	auto storagePath = arguments.at(0);
 
 	Storage storage(storagePath);
-	App app;
 
 	app.assets = data::Assets(&storage);
 	
@@ -556,11 +1340,11 @@ int main(int argc, char *argv[]) {
 	char mapPath[260];
 	bool openedMapSuccessfully = false;
 
-	app.mapInfo.ignoredEntries = { EntryName::Terrain_Editor };
+	app.ignoredMapEntries = { EntryName::Terrain_Editor };
 
-	if (argc > 2) {
+	if (arguments.size() > 1) {
 		// Read map
-		auto mapPath = argv[2];
+		auto mapPath = arguments[1];
 
 		openedMapSuccessfully = tryOpenMap(app, mapPath, storage);
 		if (!openedMapSuccessfully)
@@ -599,7 +1383,7 @@ int main(int argc, char *argv[]) {
 			switch (event.type) {
 			case SDL_KEYDOWN:
 			case SDL_KEYUP:
-				processInput(app, storage, event.key.keysym.sym, hwnd, moveInput, event.type == SDL_KEYDOWN, counterLast, viewPos);
+				processInput(app, storage, event.key.keysym.sym, hwnd, moveInput, event.type == SDL_KEYDOWN, counterLast);
 				break;
 
 			case SDL_QUIT:
@@ -611,6 +1395,25 @@ int main(int argc, char *argv[]) {
 			}
 		};
 
+		// New map is swapped in between frames
+		if (app.pendingLoad != nullptr && app.pendingLoad->jobs.IsFinished())
+		{
+			string loadedPath = app.pendingLoad->mapPath;
+
+			if (finishMapLoad(app))
+			{
+				app.realTime     = 0.0;
+				app.currentTick  = 0;
+				app.nextGameTick = 0;
+
+				viewPos = { 0, 0 };
+			}
+			else
+			{
+				showLoadErrorMessage(hwnd, loadedPath.c_str());
+			}
+		}
+
 		drawMap(app, viewPos);
 		processMoveInput(viewPos, moveInput, app.deltaTime);
 		gameTick(app);
@@ -635,7 +1438,16 @@ int main(int argc, char *argv[]) {
 		boost::format time("Gauss Engine: %.2f (+%.5f) FPS: %.2f");
 		time % app.realTime % app.averageDeltaTime % app.fps;
 
-		SDL_SetWindowTitle(app.window, time.str().c_str());
+		string title = time.str();
+
+		if (app.pendingLoad != nullptr)
+		{
+			auto& jobs = app.pendingLoad->jobs;
+
+			title += (format(" Loading map: %1%/%2%") % jobs.GetFinishedCount() % jobs.GetJobCount()).str();
+		}
+
+		SDL_SetWindowTitle(app.window, title.c_str());
 
 		app.musicPlayer.Process();
 	};
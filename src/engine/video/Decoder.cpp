@@ -18,6 +18,11 @@ namespace video
 		_codec->DecodeFrame(size, input, output);
 	}
 
+	bool Decoder::DecodeFrame(int size, uint8_t* input, FramePlanes& planes)
+	{
+		return _codec->DecodeFrame(size, input, planes);
+	}
+
 	Decoder::~Decoder()
 	{
 		_codec->Release();
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <utility/Factory.hpp>
 
@@ -11,6 +12,26 @@ namespace video
 		VP9
 	};
 
+	enum class ColorSpace
+	{
+		Srgb,  // planes hold G, B, R
+		Bt601,
+		Bt709
+	};
+
+	// Planes of a decoded frame, they stay valid until the next decode
+	struct FramePlanes
+	{
+		std::array<const uint8_t*, 3> data {};
+		std::array<int, 3>            stride {};
+		int                           planeCount = 0;
+		int                           width = 0, height = 0;
+		int                           chromaShiftX = 0, chromaShiftY = 0;
+		bool                          semiPlanar = false;  // U and V interleaved in the second plane
+		bool                          fullRange = false;
+		ColorSpace                    colorSpace = ColorSpace::Bt601;
+	};
+
 	class A_HwDecoder;
 
 	class Decoder
@@ -23,6 +44,9 @@ namespace video
 		void Initialize();
 		void DecodeFrame(int size, uint8_t* input, uint8_t* output);
 
+		// Leaves planes as decoded, false if the input gave no frame
+		bool DecodeFrame(int size, uint8_t* input, FramePlanes&);
+
 	private:
 
 		A_HwDecoder* _codec = nullptr;
@@ -40,6 +64,7 @@ namespace video
 		virtual ~A_HwDecoder() {};
 
 		virtual void DecodeFrame(int size, uint8_t* input, uint8_t* output) = 0;
+		virtual bool DecodeFrame(int size, uint8_t* input, FramePlanes&) = 0;
 		virtual void Release() = 0;
 	};
 }
\ No newline at end of file
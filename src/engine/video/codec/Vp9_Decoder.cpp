@@ -18,6 +18,7 @@ namespace video
 		~Vp9_Decoder();
 		
 		void DecodeFrame(int size, uint8_t* input, uint8_t* output) override;
+		bool DecodeFrame(int size, uint8_t* input, FramePlanes&) override;
 		void Release() override;
 
 	private:
@@ -111,6 +112,63 @@ namespace video
 		}
 	}
 
+	static ColorSpace TakeColorSpace(vpx_color_space_t colorSpace)
+	{
+		switch(colorSpace)
+		{
+			case VPX_CS_SRGB:      return ColorSpace::Srgb;
+			case VPX_CS_BT_709:    return ColorSpace::Bt709;
+			case VPX_CS_UNKNOWN:
+			case VPX_CS_BT_601:
+			case VPX_CS_SMPTE_170: return ColorSpace::Bt601;
+			default:               break;
+		}
+
+		throw runtime_error("Unsupported color space");
+	}
+
+	bool Vp9_Decoder::DecodeFrame(int size, uint8_t* input, FramePlanes& planes)
+	{
+		if (vpx_codec_decode(&_codecContext, input, size, nullptr, 0))
+		{
+			throw runtime_error("Failed to decode frame");
+		}
+
+		vpx_codec_iter_t iter = nullptr;
+		vpx_image_t      *img = nullptr, *last = nullptr;
+
+		while ((img = vpx_codec_get_frame(&_codecContext, &iter)) != nullptr)
+		{
+			last = img;
+		}
+
+		if (last == nullptr)
+			return false;
+
+		if (last->fmt & VPX_IMG_FMT_HIGHBITDEPTH)
+		{
+			throw runtime_error("Unsupported depth format");
+		}
+
+		planes.semiPlanar = last->fmt == VPX_IMG_FMT_NV12;
+		planes.planeCount = planes.semiPlanar ? 2 : 3;
+
+		for(int i = 0; i < planes.planeCount; i++)
+		{
+			planes.data[i]   = last->planes[i];
+			planes.stride[i] = last->stride[i];
+		}
+
+		planes.width        = last->d_w;
+		planes.height       = last->d_h;
+		planes.chromaShiftX = last->x_chroma_shift;
+		planes.chromaShiftY = last->y_chroma_shift;
+		planes.fullRange    = last->range == VPX_CR_FULL_RANGE;
+		planes.colorSpace   = TakeColorSpace(last->cs);
+
+		return true;
+	}
+
 	void Vp9_Decoder::Release()
 	{
 		if (vpx_codec_destroy(&_codecContext))
@@ -10,8 +10,6 @@
 
 namespace view
 {
-	const int pixelSize = 4;
-
 	using namespace data;
 	using namespace meta;
 
@@ -148,16 +146,21 @@ namespace view
 			auto& frame = *_frameIterator;
 
 			_videoManager->ReadFrameData(_currentClip, frame, _encodedPixels.get());
-			_videoDecoder->DecodeFrame(frame.size, _encodedPixels.get(), _framePixels.get());
 
-			// Free previous frame
-			if (_frameGraphicsHandle)
+			// Planes are uploaded as decoded, shader converts them to RGB
+			if (_videoDecoder->DecodeFrame(frame.size, _encodedPixels.get(), _framePlanes))
 			{
-				_graphics->FreeDrawable(_frameGraphicsHandle);
-				_frameGraphicsHandle = nullptr;
-			}
+				UseFrameImage(_framePlanes);
 
-			_frameGraphicsHandle = _graphics->LoadImage(reinterpret_cast<uint32_t*>(_framePixels.get()), _frameWidth, _frameHeight);
+				std::array<renderer::ImagePlane, 3> planes;
+
+				for(int i = 0; i < _framePlanes.planeCount; i++)
+				{
+					planes[i] = { _framePlanes.data[i], static_cast<uint32_t>(_framePlanes.stride[i]) };
+				}
+
+				_graphics->UpdateVideoImage(_frameGraphicsHandle, { planes.data(), static_cast<size_t>(_framePlanes.planeCount) });
+			}
 
 			_nextFrameTimer = 1.0 / _currentClip->GetFPS();
 
@@ -202,16 +205,6 @@ namespace view
 		_frameIterator = clips[index].frames.begin();
 		_currentClip = &clips[index];
 
-		// Create new frame pixels if needed
-		if (_currentClip->width != _frameWidth || _currentClip->height != _frameHeight)
-		{
-			_frameWidth = _currentClip->width;
-			_frameHeight = _currentClip->height;
-
-			_framePixels = std::make_shared<uint8_t[]>(_frameWidth * _frameHeight * pixelSize);
-			memset(_framePixels.get(), 255, _frameWidth * _frameHeight * pixelSize);
-		}
-
 		// Prepare frame buffer for decoding
 		uint64_t maxFrameSize = std::max_element(_currentClip->frames.begin(), _currentClip->frames.end(), 
 																				[] (auto& a, auto& b) { return a.size < b.size; })->size;
@@ -219,6 +212,41 @@ namespace view
 		_encodedPixels = std::make_shared<uint8_t[]>(maxFrameSize);
 	}
 
+	void UnitTransmission::UseFrameImage(const video::FramePlanes& planes)
+	{
+		renderer::VideoFormat format;
+
+		format.chromaShiftX = planes.chromaShiftX;
+		format.chromaShiftY = planes.chromaShiftY;
+		format.semiPlanar   = planes.semiPlanar;
+		format.fullRange    = planes.fullRange;
+
+		switch(planes.colorSpace)
+		{
+			case video::ColorSpace::Srgb:  format.matrix = renderer::ColorMatrix::Identity; break;
+			case video::ColorSpace::Bt601: format.matrix = renderer::ColorMatrix::Bt601; break;
+			case video::ColorSpace::Bt709: format.matrix = renderer::ColorMatrix::Bt709; break;
+		}
+
+		// Image is reused by following frames
+		if (_frameGraphicsHandle != nullptr && format == _frameFormat &&
+				_frameWidth == static_cast<uint32_t>(planes.width) && _frameHeight == static_cast<uint32_t>(planes.height))
+		{
+			return;
+		}
+
+		if (_frameGraphicsHandle != nullptr)
+		{
+			_graphics->FreeDrawable(_frameGraphicsHandle);
+		}
+
+		_frameWidth  = planes.width;
+		_frameHeight = planes.height;
+		_frameFormat = format;
+
+		_frameGraphicsHandle = _graphics->CreateVideoImage(_frameWidth, _frameHeight, _frameFormat);
+	}
+
 	int UnitTransmission::ReadClips(PortraitClipArray& clips, int pathIndex)
 	{
 		int i;
@@ -41,6 +41,9 @@ namespace view
 		void PickRandomClip(PortraitClipArray& clips, int clipCount);
 		int  ReadClips(PortraitClipArray& clips, int pathIndex);
 
+		// Recreates frame image when decoded frames change size or format
+		void UseFrameImage(const video::FramePlanes&);
+
 		renderer::DrawableHandle _currentFrameHandle = nullptr;
 
 		audio::AudioManager*  _audioManager;
@@ -65,8 +68,10 @@ namespace view
 
 		int                              _fidgetClipCount, _talkingClipCount;
 		PortraitClipArray                _fidgetClips, _talkingClips;
-		std::shared_ptr<uint8_t[]>       _framePixels, _encodedPixels;
+		std::shared_ptr<uint8_t[]>       _encodedPixels;
+		video::FramePlanes               _framePlanes;
 		uint32_t                         _frameWidth = 0, _frameHeight = 0;
+		renderer::VideoFormat            _frameFormat;
 		renderer::DrawableHandle         _frameGraphicsHandle = nullptr;
 		UnitSoundProfile                 _soundProfile;
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "data/Common.hpp"
+#include "data/Images.hpp"
 #include "data/Palette.hpp"
 #include <data/Tileset.hpp>
 #include <data/Sprite.hpp>
@@ -8,6 +9,8 @@
 #include <cstdint>
 #include <glm/vec2.hpp>
 #include <memory>
+#include <span>
+#include <string>
 #include <vector>
 
 namespace renderer
@@ -16,26 +19,221 @@ namespace renderer
 	typedef uint32_t tileID;
 	typedef void*    DrawableHandle;
 
+	enum class ImageFormat
+	{
+		Rgba8,
+		R8     // single channel, e.g. a plane of video frame
+	};
+
+	enum class ColorMatrix
+	{
+		Identity,  // planes hold G, B, R
+		Bt601,
+		Bt709
+	};
+
+	// Layout of video frame planes, converted to RGB on GPU
+	struct VideoFormat
+	{
+		uint32_t    chromaShiftX = 1, chromaShiftY = 1;  // 4:2:0
+		bool        semiPlanar = false;                  // NV12, U and V interleaved in second plane
+		bool        fullRange = false;
+		ColorMatrix matrix = ColorMatrix::Bt601;
+
+		bool operator==(const VideoFormat&) const = default;
+	};
+
+	struct ImagePlane
+	{
+		const uint8_t* pixels;
+		uint32_t       stride; // bytes between rows
+	};
+
+	// Used tiles of a tileset packed into cells of a texture by BakeTileset
+	struct TilesetAtlas
+	{
+		std::shared_ptr<uint8_t[]> pixels;  // palette indices
+		uint32_t width = 0, height = 0;
+		int      cellSize = 0, cellCount = 0;
+
+		// Texture cell of each tile of the tileset, unused tiles get cell 0
+		std::vector<uint32_t> tileMap;
+	};
+
+	struct DrawItem
+	{
+		data::position pos;
+		frameIndex     frame;
+
+		// Mirrors the frame around pos, facings without a stored frame are
+		//  drawn this way, see data::TakeFacingFrame
+		data::FlipFlags flip = data::FlipNone;
+	};
+
+	// Fields of images.dat picking how sprite sheet frames are drawn. Draw
+	//  functions without an effect of their own are drawn normally
+	struct DrawStyle
+	{
+		data::DrawFunction function = data::DrawFunction::Normal;
+		data::PaletteRemap remap = data::PaletteRemap::None;  // used by Remapping
+
+		bool operator==(const DrawStyle&) const = default;
+	};
+
+	// Range of palette colors rotated up by one place every period ticks, at
+	//  tick t index first + i shows the color of first + (i - t / period) mod
+	//  count. Same as calling Palette::cyclePaletteColor once a period
+	struct PaletteCycle
+	{
+		uint8_t  first = 0, count = 0;
+		uint32_t period = 1;
+
+		bool operator==(const PaletteCycle&) const = default;
+	};
+
+	const uint32_t PALETTE_CYCLE_MAX = 4;
+
+	// Sprite frames kept in video memory
+	struct SpriteResidency
+	{
+		uint32_t residentFrames = 0;
+		uint64_t residentBytes = 0;
+
+		// Packing efficiency is resident bytes over the bytes of used pages
+		uint32_t usedPages = 0, pageCount = 0;
+		uint64_t pageBytes = 0;
+
+		// Counted for the last presented frame
+		uint32_t uploadedFrames = 0;
+		uint64_t uploadedBytes = 0;
+		uint32_t placeholderFrames = 0;  // drawn empty, no page could take them
+		uint32_t evictedPages = 0;
+	};
+
+	// Work recorded for the last presented frame
+	struct RenderStatistics
+	{
+		uint32_t drawCalls = 0;       // made through Draw and DrawBatch
+		uint32_t recordedDraws = 0;   // left after sorting and merging
+		uint32_t pipelineBinds = 0, descriptorSetBinds = 0;
+
+		SpriteResidency sprites;
+	};
+
+	const uint64_t SPRITE_MEMORY_DEFAULT_BUDGET = 32 * 1024 * 1024;
+
+	// Fixed for the lifetime of the graphics
+	struct GraphicsSettings
+	{
+		// Video memory for sprite frames, least recently drawn ones are evicted
+		//  to keep under it
+		uint64_t spriteMemoryBudget = SPRITE_MEMORY_DEFAULT_BUDGET;
+
+		// Pipelines compiled by the driver are kept there between runs, empty
+		//  path compiles them on every start
+		std::string pipelineCachePath = "pipeline_cache.bin";
+
+		// Directory of .spv files used instead of shaders compiled into the
+		//  renderer, missing ones fall back to the built in code
+		std::string shaderOverridePath;
+
+		// Palettized draws write indices into an 8 bit target, turned into colors
+		//  by a full screen pass. Palette cycles cost no upload then. Pictures,
+		//  video and sprite styles blending colors can't go to the target, every
+		//  indexed draw after one of them costs another pass and resolve. So it's
+		//  off until it is measured against the direct path
+		bool indexedRendering = false;
+	};
+
 	class A_Graphics
 	{
 	public:
 
-		virtual DrawableHandle LoadSpriteSheet(data::A_SpriteSheetData&) = 0;
-		virtual DrawableHandle LoadTileset(data::A_TilesetData&, std::vector<bool>& usedTiles) = 0;
+		// Frames are decoded from data when they are first drawn, it's kept with the sheet
+		virtual DrawableHandle LoadSpriteSheet(std::shared_ptr<const data::A_SpriteSheetData>) = 0;
+
+		// Only reads its arguments, so it can run on a worker while frames are drawn
+		virtual TilesetAtlas BakeTileset(const data::A_TilesetData&, const std::vector<bool>& usedTiles) const = 0;
+
+		// Uploads the atlas, the tileset keeps its own tile map
+		virtual DrawableHandle LoadTileset(data::A_TilesetData&, TilesetAtlas) = 0;
+
 		virtual DrawableHandle LoadImage(uint32_t* pixels, uint32_t width, uint32_t height) = 0;
 
+		// Image rewritten often, like video frames. Memory is allocated once,
+		//  updates never wait for GPU. It's drawn like a loaded image
+		virtual DrawableHandle CreateStreamingImage(uint32_t width, uint32_t height, ImageFormat) = 0;
+
+		// Pixels cover the whole image and are copied before return,
+		//  new contents are drawn from the next presented frame
+		virtual void UpdateStreamingImage(DrawableHandle, const void* pixels) = 0;
+
+		// Streaming image filled with planes of a video frame as they're decoded
+		virtual DrawableHandle CreateVideoImage(uint32_t width, uint32_t height, const VideoFormat&) = 0;
+
+		// Three planes, or two for semi planar formats
+		virtual void UpdateVideoImage(DrawableHandle, std::span<const ImagePlane> planes) = 0;
+
+		// Terrain drawn in one call, tiles are resolved on GPU. It holds a window
+		//  of width x height tiles that wraps around the map, so it's sized to
+		//  the view, not the map. It's empty until areas are uploaded.
+		virtual DrawableHandle CreateTilemap(DrawableHandle tileset, uint32_t width, uint32_t height) = 0;
+
+		// Area is in map tiles and overwrites whatever shares its window texels.
+		//  Tile (x, y) of the area is read from tiles[x * columnStride + y], null tiles clear it
+		virtual void UpdateTilemap(DrawableHandle tilemap, int left, int top, int width, int height, const data::tileID* tiles, int columnStride) = 0;
+
+		// Area in map tiles drawn by the tilemap, it must be uploaded and fit the window
+		virtual void SetTilemapView(DrawableHandle tilemap, int left, int top, int width, int height) = 0;
+
 		virtual void Draw(DrawableHandle, frameIndex, data::position) = 0;
 		virtual void Draw(DrawableHandle, data::position, uint32_t width, uint32_t height) = 0;
+
+		// Same as drawing items one by one, but the handle is validated once.
+		//  Empty batches are ignored without touching the handle
+		virtual void DrawBatch(DrawableHandle, std::span<const DrawItem>) = 0;
 		virtual void FreeDrawable(DrawableHandle) = 0;
 
+		// Video memory used by the drawable, sprite sheets count all their frames
+		//  as if they were resident
+		virtual uint64_t GetMemorySize(DrawableHandle) = 0;
+
 		virtual void SetTilesetPalette(data::Palette&) = 0;
 
+		// Replaces cycles of the tileset palette, up to PALETTE_CYCLE_MAX. With
+		//  indexed rendering they are applied while resolving, otherwise the
+		//  palette is uploaded again when a cycle moves
+		virtual void SetPaletteCycles(std::span<const PaletteCycle>) = 0;
+
+		// Tick the cycles are evaluated at, kept until set again
+		virtual void SetPaletteTick(uint32_t tick) = 0;
+
+		// Palette index each index is drawn with by the remap, remaps keep
+		//  indices until they are set
+		virtual void SetPaletteRemap(data::PaletteRemap, std::span<const uint8_t, data::PALETTE_SIZE> indices) = 0;
+
+		// Style of sprite sheet draws made after it, other drawables ignore it.
+		//  Styles don't change depth, a shadow drawn before its unit stays
+		//  below it. Reset to normal by BeginRendering
+		virtual void SetDrawStyle(const DrawStyle&) = 0;
+
+		// Drawables with frame tables are drawn as instances, enabled by default
+		virtual void EnableInstancing(bool) = 0;
+
 		virtual void SetView(data::position pos) = 0;
+
+		// Draws of a higher layer cover the lower ones, inside a layer they keep
+		//  the order they were made in. Neighbouring draws sharing pipeline and
+		//  image are merged. Reset to 0 by BeginRendering
+		virtual void SetLayer(uint8_t layer) = 0;
+
 		virtual void BeginRendering() = 0;
 		virtual void PresentToScreen() = 0;
 
 		virtual const char* GetName() const = 0;
 
+		virtual RenderStatistics GetRenderStatistics() const = 0;
+
 		virtual void WaitIdle() = 0;
 
 		virtual void Release() = 0;
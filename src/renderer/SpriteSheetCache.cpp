@@ -0,0 +1,110 @@
+#include "SpriteSheetCache.hpp"
+
+#include <stdexcept>
+
+namespace renderer
+{
+	SpriteSheetCache::SpriteSheetCache(A_Graphics* graphics, uint64_t budget) : _graphics(graphics), _budget(budget)
+		{}
+
+	SpriteSheetCache::~SpriteSheetCache()
+	{
+		for(auto& [_, entry] : _entries)
+		{
+			_graphics->FreeDrawable(entry.handle);
+		}
+	}
+
+	DrawableHandle SpriteSheetCache::Acquire(data::grpID id, std::shared_ptr<const data::A_SpriteSheetData> data)
+	{
+		auto handle = TryAcquire(id);
+
+		if (handle != nullptr)
+			return handle;
+
+		Entry entry;
+
+		entry.handle     = _graphics->LoadSpriteSheet(std::move(data));
+		entry.size       = _graphics->GetMemorySize(entry.handle);
+		entry.references = 1;
+
+		_entries[id] = entry;
+
+		_residentBytes += entry.size;
+
+		_stats.loadedSheets++;
+		_stats.loadedBytes += entry.size;
+
+		return entry.handle;
+	}
+
+	DrawableHandle SpriteSheetCache::TryAcquire(data::grpID id)
+	{
+		auto it = _entries.find(id);
+
+		if (it == _entries.end())
+			return nullptr;
+
+		auto& entry = it->second;
+
+		entry.references++;
+
+		_stats.reusedSheets++;
+		_stats.reusedBytes += entry.size;
+
+		return entry.handle;
+	}
+
+	void SpriteSheetCache::Release(data::grpID id)
+	{
+		auto it = _entries.find(id);
+
+		if (it == _entries.end() || it->second.references == 0)
+		{
+			throw std::runtime_error("Sprite sheet is released more times than acquired");
+		}
+
+		it->second.references--;
+		it->second.lastReleased = ++_releaseCounter;
+	}
+
+	void SpriteSheetCache::Trim()
+	{
+		while(_residentBytes > _budget)
+		{
+			auto leastUsed = _entries.end();
+
+			for(auto it = _entries.begin(); it != _entries.end(); it++)
+			{
+				if (it->second.references > 0)
+					continue;
+
+				if (leastUsed == _entries.end() || it->second.lastReleased < leastUsed->second.lastReleased)
+					leastUsed = it;
+			}
+
+			// Everything left is used by the current map
+			if (leastUsed == _entries.end())
+				return;
+
+			auto& entry = leastUsed->second;
+
+			_graphics->FreeDrawable(entry.handle);
+
+			_residentBytes -= entry.size;
+
+			_stats.evictedSheets++;
+			_stats.evictedBytes += entry.size;
+
+			_entries.erase(leastUsed);
+		}
+	}
+
+	SpriteCacheStats SpriteSheetCache::TakeStats()
+	{
+		auto stats = _stats;
+		_stats = SpriteCacheStats();
+
+		return stats;
+	}
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+
+#include <data/Grp.hpp>
+
+#include "A_Graphics.hpp"
+
+namespace renderer
+{
+	const uint64_t SPRITE_CACHE_DEFAULT_BUDGET = 256 * 1024 * 1024;
+
+	// Counters since the last TakeStats()
+	struct SpriteCacheStats
+	{
+		int      reusedSheets  = 0;
+		uint64_t reusedBytes   = 0;
+		int      loadedSheets  = 0;
+		uint64_t loadedBytes   = 0;
+		int      evictedSheets = 0;
+		uint64_t evictedBytes  = 0;
+	};
+
+	// Keeps sprite sheets on GPU between maps. Sheets without references
+	//  stay resident until the cache grows over its budget, then they
+	//  are freed in least recently used order.
+	class SpriteSheetCache
+	{
+	public:
+
+		SpriteSheetCache(A_Graphics* graphics, uint64_t budget = SPRITE_CACHE_DEFAULT_BUDGET);
+		~SpriteSheetCache();
+
+		SpriteSheetCache(const SpriteSheetCache&) = delete;
+		SpriteSheetCache& operator=(const SpriteSheetCache&) = delete;
+
+		// Adds a reference, sheet is loaded from data if it's not cached
+		DrawableHandle Acquire(data::grpID id, std::shared_ptr<const data::A_SpriteSheetData> data);
+
+		// Returns nullptr and adds no reference if sheet is not cached
+		DrawableHandle TryAcquire(data::grpID id);
+
+		void Release(data::grpID id);
+
+		// GPU must not use the evicted sheets anymore
+		void Trim();
+
+		uint64_t GetResidentBytes() const { return _residentBytes; }
+		int      GetResidentCount() const { return _entries.size(); }
+
+		SpriteCacheStats TakeStats();
+
+	private:
+
+		struct Entry
+		{
+			DrawableHandle handle;
+			uint64_t       size;
+			int            references = 0;
+			uint64_t       lastReleased = 0;
+		};
+
+	private:
+
+		A_Graphics* _graphics;
+		uint64_t    _budget;
+
+		std::unordered_map<data::grpID, Entry> _entries;
+
+		uint64_t _residentBytes = 0;
+		uint64_t _releaseCounter = 0;
+
+		SpriteCacheStats _stats;
+	};
+}
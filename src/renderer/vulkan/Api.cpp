@@ -9,7 +9,7 @@
 
 namespace renderer::vulkan
 {
-	std::unique_ptr<A_Graphics> CreateGraphics(void* window, const data::Assets* assets)
+	std::unique_ptr<A_Graphics> CreateGraphics(void* window, const data::Assets* assets, const GraphicsSettings& settings)
 	{
 		SDL_Window* sdlWindow = reinterpret_cast<SDL_Window*>(window);
 
@@ -18,6 +18,6 @@ namespace renderer::vulkan
 			throw std::runtime_error("Instance of window is not supported");
 		}
 
-		return std::make_unique<Graphics>(sdlWindow, assets);
+		return std::make_unique<Graphics>(sdlWindow, assets, settings);
 	}
 }
\ No newline at end of file
@@ -7,5 +7,5 @@
 
 namespace renderer::vulkan
 {
-	extern std::unique_ptr<A_Graphics> CreateGraphics(void* window, const data::Assets* assets);
+	extern std::unique_ptr<A_Graphics> CreateGraphics(void* window, const data::Assets* assets, const GraphicsSettings& settings = {});
 }
@@ -1,23 +1,33 @@
 #pragma once
 
 #include "data/Sprite.hpp"
-#include <glm/vec2.hpp>
+#include <cstdint>
+#include <memory>
 #include <vector>
 
 namespace renderer::vulkan
 {
-	class Atlas
+	struct AtlasFrame
 	{
-	public:
-
-		Atlas(uint32_t width, uint32_t height, std::vector<data::SpriteRect>&);
-	
-		glm::vec<2, uint32_t> GetDimensions() const;
-		data::SpriteRect      GetFrame(int frame) const;
-
-	private:
+		uint32_t         layer;
+		data::SpriteRect rect;
+		bool             resident = false;
+		bool             requested = false;  // queued to be made resident
+	};
 
-		glm::vec<2, uint32_t>         _dimensions;
-		std::vector<data::SpriteRect> _rectangles;
+	// Space a sprite sheet holds in the sprite atlas. Frames are decoded from
+	//  data the first time they are drawn and may be evicted again
+	struct AtlasPlacement
+	{
+		std::shared_ptr<const data::A_SpriteSheetData> data;
+		std::vector<data::SpriteData>                  spriteDataList;
+		std::vector<AtlasFrame>                        frames;
+		uint32_t                                       firstRow;  // of the shared frame table
 	};
-}
\ No newline at end of file
+
+	// Whole part of u selects the layer, right edges stay below the next one
+	inline float EncodeAtlasLayer(float u, uint32_t layer)
+	{
+		return u + 2.0f * layer;
+	}
+}
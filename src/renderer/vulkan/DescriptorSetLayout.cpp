@@ -78,6 +78,7 @@ namespace renderer::vulkan
 		switch(type)
 		{
 			case BindSampler: return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			case BindStorageBuffer: return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
 		}
 
 		throw runtime_error("Unknown descriptor type");
@@ -88,6 +89,7 @@ namespace renderer::vulkan
 		switch(type)
 		{
 			case BindSampler: return VK_SHADER_STAGE_FRAGMENT_BIT;
+			case BindStorageBuffer: return VK_SHADER_STAGE_VERTEX_BIT;
 		}
 
 		throw runtime_error("Unknown descriptor type");
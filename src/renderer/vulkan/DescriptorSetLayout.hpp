@@ -8,7 +8,7 @@ namespace renderer::vulkan
 {
 	enum DescriptorBindType
 	{
-		BindSampler
+		BindSampler, BindStorageBuffer
 	};
 
 	class DescriptorSetLayout
@@ -1,8 +1,10 @@
 #include "Drawable.hpp"
+#include "SpriteAtlas.hpp"
 #include "data/Common.hpp"
 #include "data/Sprite.hpp"
 #include "data/Tileset.hpp"
 
+#include <algorithm>
 #include <cstring>
 #include <glm/ext/vector_float2.hpp>
 #include <iostream>
@@ -16,26 +18,29 @@ namespace renderer::vulkan {
 	//   Sprite sheet
 	//  TODO: description
 	// =========================================
-	SpriteSheet::SpriteSheet(std::vector<data::SpriteData>& spriteDataList, Atlas& atlas, Image* image) : 
-		_spriteDataList(std::move(spriteDataList)),
-		_atlas(std::move(atlas)),
+	SpriteSheet::SpriteSheet(AtlasPlacement& placement, Image* image) : 
+		_placement(std::move(placement)),
 		_spriteAtlasImage(image)
 	{}
 
 	std::size_t SpriteSheet::GetPolygon(frameIndex frameIndex, Vertex* output, std::size_t maxCount, uint32_t width, uint32_t height) const
 	{
-		auto spriteData = _spriteDataList[frameIndex];
-		auto frameData  = _atlas.GetFrame(frameIndex);
-		auto atlasDims  = _atlas.GetDimensions();
+		auto spriteData                  = _placement.spriteDataList[frameIndex];
+		auto [layer, frame, resident, _] = _placement.frames[frameIndex];
 
-		width = width ? width : frameData.w;
-		height = height ? height : frameData.h;
+		width = width ? width : frame.w;
+		height = height ? height : frame.h;
+
+		if (!resident)
+		{
+			width = height = 0;
+		}
 
 		auto [bottomLeft, topLeft, topRight, bottomRight] = data::FrameVertices<Vertex>(
 			spriteData.offset.x, spriteData.offset.y, 
 			width, height,
-			frameData,
-			atlasDims.x, atlasDims.y, 
+			frame,
+			SpriteAtlas::PageSize, SpriteAtlas::PageSize, 
 			data::FlipNone);
 
 		output[0] = bottomLeft;
@@ -45,10 +50,23 @@ namespace renderer::vulkan {
 		output[4] = topRight;
 		output[5] = bottomRight;
 
+		for(int i = 0; i < 6; i++)
+		{
+			output[i].texCoord.x = EncodeAtlasLayer(output[i].texCoord.x, layer);
+		}
+
 		return 6;
 
 	}
 
+	void SpriteSheet::GetInstanceFrames(std::span<const DrawItem> items, uint32_t* output) const
+	{
+		for(std::size_t i = 0; i < items.size(); i++)
+		{
+			output[i] = _placement.firstRow + items[i].frame;
+		}
+	}
+
 	VkImageView SpriteSheet::GetImageView() const { return _spriteAtlasImage->GetViewHandle(); }
 
 	Image* SpriteSheet::GetImage() const { return _spriteAtlasImage; }
@@ -59,9 +77,9 @@ namespace renderer::vulkan {
 	//   Tileset
 	//  TODO: description
 	// =========================================
-	Tileset::Tileset(data::A_TilesetData& tilesetData, std::vector<uint32_t>& tileMap, Image* image, int cellSize, int textureWidth, int textureHeight)
-		: _tilesetData(tilesetData), _tileMap(tileMap), _image(image),
-			 CellSize(cellSize), TextureWidth(textureWidth), TextureHeight(textureHeight)
+	Tileset::Tileset(data::A_TilesetData& tilesetData, std::vector<uint32_t> tileMap, Image* image, int cellSize, int cellCount, int textureWidth, int textureHeight)
+		: _tilesetData(tilesetData), _tileMap(std::move(tileMap)), _image(image),
+			 CellSize(cellSize), CellCount(cellCount), TextureWidth(textureWidth), TextureHeight(textureHeight)
 	{
 	}
 
@@ -92,16 +110,107 @@ namespace renderer::vulkan {
 		return 6;
 	}
 
+	std::vector<FrameRect> Tileset::BuildFrameTable() const
+	{
+		// One row per cell of the texture, unused cells are never referenced
+		int columns = TextureWidth / CellSize;
+		int rows    = TextureHeight / CellSize;
+
+		std::vector<FrameRect> table(columns * rows);
+
+		float cellWidth  = static_cast<float>(CellSize) / TextureWidth;
+		float cellHeight = static_cast<float>(CellSize) / TextureHeight;
+
+		for(int i = 0; i < table.size(); i++)
+		{
+			float left = (i % columns) * cellWidth;
+			float top  = (i / columns) * cellHeight;
+
+			table[i].uv   = { left, top, left + cellWidth, top + cellHeight };
+			table[i].rect = { 0, 0, CellSize, CellSize };
+		}
+
+		return table;
+	}
+
+	void Tileset::GetInstanceFrames(std::span<const DrawItem> items, uint32_t* output) const
+	{
+		for(std::size_t i = 0; i < items.size(); i++)
+		{
+			output[i] = GetPackedCell(items[i].frame);
+		}
+	}
+
+	uint32_t Tileset::GetPackedCell(tileID tile) const
+	{
+		auto flips = _tilesetData.GetFlipFlags(tile);
+		auto cell  = _tileMap[_tilesetData.GetMappedIndex(tile)];
+
+		return cell | static_cast<uint32_t>(flips) << 16;
+	}
+
 	VkImageView Tileset::GetImageView() const { return _image->GetViewHandle(); }
 
 	Image* Tileset::GetImage() const { return _image; }
 
 	DrawableType Tileset::GetType() const { return TilesetType; }
 
+	// =========================================
+	//   Tilemap
+	// =========================================
+	Tilemap::Tilemap(Tileset* tileset, Image* image, uint32_t width, uint32_t height)
+		: _tileset(tileset), _image(image), Width(width), Height(height)
+	{}
+
+	std::size_t Tilemap::GetPolygon(frameIndex, Vertex* output, std::size_t maxCount, uint32_t, uint32_t) const
+	{
+		data::SpriteRect tileRect = { 
+			static_cast<uint32_t>(_viewLeft), static_cast<uint32_t>(_viewTop), 
+			static_cast<uint32_t>(_viewWidth), static_cast<uint32_t>(_viewHeight) 
+		};
+
+		int cellSize = _tileset->CellSize;
+
+		// Texture size of 1 keeps coordinates in tiles, the shader wraps them into the window
+		auto [bottomLeft, topLeft, topRight, bottomRight] = data::FrameVertices<Vertex>(
+			_viewLeft * cellSize, _viewTop * cellSize, _viewWidth * cellSize, _viewHeight * cellSize, tileRect, 1, 1);
+
+		output[0] = bottomLeft;
+		output[1] = topLeft;
+		output[2] = topRight;
+		output[3] = bottomLeft;
+		output[4] = topRight;
+		output[5] = bottomRight;
+
+		return 6;
+	}
+
+	void Tilemap::SetView(int left, int top, int width, int height)
+	{
+		_viewLeft   = left;
+		_viewTop    = top;
+		_viewWidth  = width;
+		_viewHeight = height;
+	}
+
+	DrawableType Tilemap::GetType() const { return TilemapType; }
+
+	VkImageView Tilemap::GetImageView() const { return _image->GetViewHandle(); }
+
+	Image* Tilemap::GetImage() const { return _image; }
+
+	Tileset* Tilemap::GetTileset() const { return _tileset; }
+
 	Picture::Picture(uint32_t width, uint32_t height, uint32_t texWidth, uint32_t texHeight, Image* image) :
 		_width(width), _height(height), 
 		_texWidth(texWidth), _texHeight(texHeight),
-		_image(image)
+		_images { image }
+	{}
+
+	Picture::Picture(uint32_t width, uint32_t height, std::vector<Image*> images) :
+		_width(width), _height(height), 
+		_texWidth(width), _texHeight(height),
+		_images(std::move(images))
 	{}
 
 	std::size_t Picture::GetPolygon(frameIndex, Vertex* output, std::size_t maxCount, uint32_t width, uint32_t height) const
@@ -129,7 +238,78 @@ namespace renderer::vulkan {
 
 	DrawableType Picture::GetType() const { return PictureType; }
 
-	VkImageView Picture::GetImageView() const { return _image->GetViewHandle(); }
+	VkImageView Picture::GetImageView() const { return GetImage()->GetViewHandle(); }
+
+	Image* Picture::GetImage() const { return _images[_currentImage]; };
+
+	Image* Picture::AdvanceImage()
+	{
+		_currentImage = (_currentImage + 1) % _images.size();
+
+		return _images[_currentImage];
+	}
+
+	// =========================================
+	//   Video picture
+	// =========================================
+
+	// Conversion of normalized planes to RGB, offsets of range and chroma are folded into the last column
+	static VideoConstants MakeVideoConstants(const VideoFormat& format)
+	{
+		VideoConstants constants {};
 
-	Image* Picture::GetImage() const { return _image; };
+		constants.semiPlanar = format.semiPlanar;
+
+		if (format.matrix == ColorMatrix::Identity)
+		{
+			// Planes are G, B, R
+			constants.rows[0] = { 0, 0, 1, 0 };
+			constants.rows[1] = { 1, 0, 0, 0 };
+			constants.rows[2] = { 0, 1, 0, 0 };
+
+			return constants;
+		}
+
+		const float kr = format.matrix == ColorMatrix::Bt709 ? 0.2126f : 0.299f;
+		const float kb = format.matrix == ColorMatrix::Bt709 ? 0.0722f : 0.114f;
+		const float kg = 1.0f - kr - kb;
+
+		// Studio range keeps luma in 16..235 and chroma in 16..240
+		const float lumaScale    = format.fullRange ? 1.0f : 255.0f / 219.0f;
+		const float lumaOffset   = format.fullRange ? 0.0f : -16.0f / 219.0f;
+		const float chromaScale  = format.fullRange ? 1.0f : 255.0f / 224.0f;
+		const float chromaOffset = format.fullRange ? -128.0f / 255.0f : -128.0f / 224.0f;
+
+		const float rv = 2.0f * (1.0f - kr);
+		const float gu = -2.0f * kb * (1.0f - kb) / kg;
+		const float gv = -2.0f * kr * (1.0f - kr) / kg;
+		const float bu = 2.0f * (1.0f - kb);
+
+		constants.rows[0] = { lumaScale, 0,                rv * chromaScale, lumaOffset + rv * chromaOffset };
+		constants.rows[1] = { lumaScale, gu * chromaScale, gv * chromaScale, lumaOffset + (gu + gv) * chromaOffset };
+		constants.rows[2] = { lumaScale, bu * chromaScale, 0,                lumaOffset + bu * chromaOffset };
+
+		return constants;
+	}
+
+	VideoPicture::VideoPicture(uint32_t width, uint32_t height, const VideoFormat& format, std::vector<Image*> images, uint32_t planeCount) :
+		Picture(width, height, std::move(images)),
+		_format(format), _constants(MakeVideoConstants(format)), _planeCount(planeCount)
+	{}
+
+	DrawableType VideoPicture::GetType() const { return VideoType; }
+
+	Image* VideoPicture::GetImage() const { return GetPlane(0); }
+
+	Image* VideoPicture::GetPlane(uint32_t plane) const
+	{
+		plane = std::min(plane, _planeCount - 1);
+
+		return _images[_currentFrame * _planeCount + plane];
+	}
+
+	void VideoPicture::AdvanceFrame()
+	{
+		_currentFrame = (_currentFrame + 1) % (_images.size() / _planeCount);
+	}
 }
\ No newline at end of file
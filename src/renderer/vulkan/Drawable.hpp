@@ -2,7 +2,9 @@
 
 #include <array>
 #include <cstddef>
+#include <span>
 #include <stdexcept>
+#include <vector>
 #include <vulkan/vulkan_core.h>
 
 #include "../A_Graphics.hpp"
@@ -11,13 +13,14 @@
 #include "Vertex.hpp"
 #include "data/Sprite.hpp"
 #include "data/Tileset.hpp"
+#include "memory/Buffer.hpp"
 #include "memory/Image.hpp"
 
 namespace renderer::vulkan
 {
 	enum DrawableType
 	{
-		SpriteSheetType, TilesetType, PictureType
+		SpriteSheetType, TilesetType, PictureType, TilemapType, VideoType
 	};
 
 	class A_VulkanDrawable
@@ -39,14 +42,41 @@ namespace renderer::vulkan
 		virtual VkImageView GetImageView() const = 0;
 
 		virtual Image* GetImage() const = 0;
+
+		// Every image owned by drawable
+		virtual std::vector<Image*> GetImages() const { return { GetImage() }; }
+
+		// Rows for the frame table of instanced draws, empty if drawable can't be instanced
+		virtual std::vector<FrameRect> BuildFrameTable() const { return {}; }
+
+		// Drawables with equal keys are bound the same way and can share draws
+		virtual const void* GetStateKey() const { return this; }
+
+		// Writes frame table row | flip flags << 16 for each item
+		virtual void GetInstanceFrames(std::span<const DrawItem> items, uint32_t* output) const
+		{
+			for(std::size_t i = 0; i < items.size(); i++)
+				output[i] = items[i].frame;
+		}
+
+		void SetFrameTable(Buffer* frameTable) { _frameTable = frameTable; }
+
+		Buffer* GetFrameTable() const { return _frameTable; }
+
+	private:
+
+		Buffer* _frameTable = nullptr;
 	};
 
 	class SpriteSheet : public A_VulkanDrawable
 	{
 	public:
 
-		SpriteSheet(std::vector<data::SpriteData>&, Atlas&, Image*);
+		// Frames live in the layers of the atlas image. Layer of a frame is carried in
+		//  its texture coordinates, u is offset by twice the layer
+		SpriteSheet(AtlasPlacement&, Image* atlasImage);
 
+		// Frames that aren't resident give empty quads
 		std::size_t GetPolygon(frameIndex, Vertex* output, std::size_t maxCount, uint32_t width = 0, uint32_t height = 0) const override;
 
 		DrawableType GetType() const override;
@@ -55,18 +85,25 @@ namespace renderer::vulkan
 
 		Image* GetImage() const override;
 
+		// Rows of the shared frame table are written by the atlas
+		void GetInstanceFrames(std::span<const DrawItem> items, uint32_t* output) const override;
+
+		const void* GetStateKey() const override { return _spriteAtlasImage; }
+
+		AtlasPlacement&       GetPlacement() { return _placement; }
+		const AtlasPlacement& GetPlacement() const { return _placement; }
+
 	private:
 
-		Atlas  _atlas;
-		Image* _spriteAtlasImage;
-		std::vector<data::SpriteData> _spriteDataList;
+		AtlasPlacement _placement;
+		Image*         _spriteAtlasImage;
 	};
 
 	class Tileset : public A_VulkanDrawable
 	{
 	public:
 
-		Tileset(data::A_TilesetData&, std::vector<uint32_t>& tileMap, Image*, int cellSize, int textureWidth, int textureHeight);
+		Tileset(data::A_TilesetData&, std::vector<uint32_t> tileMap, Image*, int cellSize, int cellCount, int textureWidth, int textureHeight);
 
 		std::size_t GetPolygon(frameIndex, Vertex* output, std::size_t maxCount, uint32_t width = 0, uint32_t height = 0) const override;
 
@@ -76,23 +113,74 @@ namespace renderer::vulkan
 
 		Image* GetImage() const override;
 
+		std::vector<FrameRect> BuildFrameTable() const override;
+
+		void GetInstanceFrames(std::span<const DrawItem>, uint32_t* output) const override;
+
+		// Texture cell of the tile | flip flags << 16
+		uint32_t GetPackedCell(tileID) const;
+
 		const int CellSize;
+		const int CellCount;
 		const int TextureWidth, TextureHeight;
 
 	private:
 
-		data::A_TilesetData&   _tilesetData;
-		std::vector<uint32_t>& _tileMap;
+		data::A_TilesetData&  _tilesetData;
+		std::vector<uint32_t> _tileMap;  // texture cell of each tile
 
 		Image* _image;
 	};
 
+	// Window of the map's tile grid in a R16_UINT image, drawn as one quad over
+	//  the view. Tile (x, y) is kept in texel (x mod Width, y mod Height), so the
+	//  window follows the camera. Texels hold cell | flip flags << 14 or TILEMAP_EMPTY_TILE.
+	const uint16_t TILEMAP_EMPTY_TILE = 0xFFFF;
+
+	// Cell 0x3FFF flipped both ways would read as an empty tile
+	const int TILEMAP_MAX_CELLS = 0x3FFF;
+
+	class Tilemap : public A_VulkanDrawable
+	{
+	public:
+
+		Tilemap(Tileset* tileset, Image*, uint32_t width, uint32_t height);
+
+		// Quad over the view, texture coordinates are in map tiles
+		std::size_t GetPolygon(frameIndex, Vertex* output, std::size_t maxCount, uint32_t width = 0, uint32_t height = 0) const override;
+
+		DrawableType GetType() const override;
+
+		VkImageView GetImageView() const override;
+
+		Image* GetImage() const override;
+
+		Tileset* GetTileset() const;
+
+		// Area of the map drawn, in tiles
+		void SetView(int left, int top, int width, int height);
+
+		const uint32_t Width, Height;
+
+	private:
+
+		Tileset* _tileset;
+		Image*   _image;
+
+		int _viewLeft = 0, _viewTop = 0;
+		int _viewWidth = 0, _viewHeight = 0;
+	};
+
 	class Picture : public A_VulkanDrawable
 	{
 	public:
 
 		Picture(uint32_t width, uint32_t height, uint32_t textureWidth, uint32_t textureHeight, Image*);
 
+		// Streaming picture, images are written in turns so the one being
+		//  written isn't sampled by frames in flight
+		Picture(uint32_t width, uint32_t height, std::vector<Image*> images);
+
 		std::size_t GetPolygon(frameIndex, Vertex* output, std::size_t maxCount, uint32_t width = 0, uint32_t height = 0) const override;
 
 		DrawableType GetType() const override;
@@ -101,10 +189,54 @@ namespace renderer::vulkan
 
 		Image* GetImage() const override;
 
+		std::vector<Image*> GetImages() const override { return _images; }
+
+		// Makes the next image current and returns it for writing
+		Image* AdvanceImage();
+
+	protected:
+
+		std::vector<Image*> _images;
+
 	private:
 
 		uint32_t _texWidth, _texHeight;
 		uint32_t _width, _height;
-		Image* _image;
+
+		std::size_t _currentImage = 0;
+	};
+
+	// Picture of video frame planes, converted to RGB by the video shader.
+	//  Planes of a frame are written in turns like streaming pictures
+	class VideoPicture : public Picture
+	{
+	public:
+
+		// Images hold planeCount planes per frame, luma first
+		VideoPicture(uint32_t width, uint32_t height, const VideoFormat&, std::vector<Image*> images, uint32_t planeCount);
+
+		DrawableType GetType() const override;
+
+		// Luma plane of current frame
+		Image* GetImage() const override;
+
+		// Binds the second plane twice for semi planar formats
+		Image* GetPlane(uint32_t plane) const;
+
+		// Makes the next frame current
+		void AdvanceFrame();
+
+		uint32_t GetPlaneCount() const { return _planeCount; }
+
+		const VideoFormat& GetFormat() const { return _format; }
+
+		const VideoConstants& GetConstants() const { return _constants; }
+
+	private:
+
+		VideoFormat    _format;
+		VideoConstants _constants;
+		uint32_t       _planeCount;
+		uint32_t       _currentFrame = 0;
 	};
 }
\ No newline at end of file
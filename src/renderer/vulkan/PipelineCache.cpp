@@ -0,0 +1,167 @@
+#include "PipelineCache.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace renderer::vulkan
+{
+	using std::runtime_error;
+
+	const char     PIPELINE_CACHE_MAGIC[4] = { 'P', 'C', 'H', 'E' };
+	const uint32_t PIPELINE_CACHE_VERSION  = 1;
+
+	PipelineCache::PipelineCache() {}
+
+	PipelineCache::LoadResult PipelineCache::Create(Device* device, const std::string& path, const VkAllocationCallbacks* allocator)
+	{
+		_device    = device;
+		_allocator = allocator;
+		_path      = path;
+
+		auto result = LoadResult::Missing;
+
+		std::vector<uint8_t> data;
+		std::ifstream        input;
+
+		if (!_path.empty())
+		{
+			input.open(_path, std::ios::binary);
+		}
+
+		if (input.is_open())
+		{
+			FileHeader header {};
+			auto       expected = TakeDeviceHeader();
+
+			input.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+			// Driver checks its own header too, but takes any data of the same
+			//  cache UUID even if the driver was updated in between
+			bool matches = input.gcount() == sizeof(header)
+				&& memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0
+				&& header.version == expected.version
+				&& header.vendorID == expected.vendorID
+				&& header.deviceID == expected.deviceID
+				&& header.driverVersion == expected.driverVersion
+				&& memcmp(header.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+
+			// Size comes from the file too, a damaged one could ask for anything
+			if (matches)
+			{
+				auto start = input.tellg();
+
+				input.seekg(0, std::ios::end);
+				auto end = input.tellg();
+				input.seekg(start);
+
+				matches = start >= 0 && end >= start && header.dataSize <= static_cast<uint64_t>(end - start);
+			}
+
+			if (matches)
+			{
+				data.resize(header.dataSize);
+				input.read(reinterpret_cast<char*>(data.data()), data.size());
+
+				matches = input.gcount() == static_cast<std::streamsize>(data.size());
+			}
+
+			if (!matches)
+				data.clear();
+
+			result = matches ? LoadResult::Loaded : LoadResult::Rejected;
+		}
+
+		VkPipelineCacheCreateInfo createInfo { VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+		createInfo.initialDataSize = data.size();
+		createInfo.pInitialData    = data.empty() ? nullptr : data.data();
+
+		if (vkCreatePipelineCache(*_device, &createInfo, _allocator, &_cache) != VK_SUCCESS)
+		{
+			throw runtime_error("Failed to create pipeline cache");
+		}
+
+		_loadedSize = data.size();
+
+		return result;
+	}
+
+	void PipelineCache::Save()
+	{
+		if (_cache == VK_NULL_HANDLE || _path.empty())
+			return;
+
+		std::size_t size = 0;
+
+		// Called while the renderer is released, losing the cache is not worth an exception
+		if (vkGetPipelineCacheData(*_device, _cache, &size, nullptr) != VK_SUCCESS)
+		{
+			std::cout << "  Vulkan API: failed to read pipeline cache" << std::endl;
+			return;
+		}
+
+		std::vector<uint8_t> data(size);
+
+		if (vkGetPipelineCacheData(*_device, _cache, &size, data.data()) != VK_SUCCESS)
+		{
+			std::cout << "  Vulkan API: failed to read pipeline cache" << std::endl;
+			return;
+		}
+
+		auto header = TakeDeviceHeader();
+		header.dataSize = size;
+
+		auto temporaryPath = _path + ".tmp";
+
+		{
+			std::ofstream output(temporaryPath, std::ios::binary | std::ios::trunc);
+
+			if (!output.is_open())
+			{
+				// Next start compiles the pipelines again, nothing else is lost
+				std::cout << "  Vulkan API: failed to write pipeline cache to " << _path << std::endl;
+				return;
+			}
+
+			output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			output.write(reinterpret_cast<const char*>(data.data()), size);
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temporaryPath, _path, error);
+
+		if (error)
+		{
+			std::cout << "  Vulkan API: failed to write pipeline cache to " << _path << std::endl;
+		}
+	}
+
+	void PipelineCache::Destroy()
+	{
+		if (_cache != VK_NULL_HANDLE)
+			vkDestroyPipelineCache(*_device, _cache, _allocator);
+
+		_cache = VK_NULL_HANDLE;
+	}
+
+	PipelineCache::FileHeader PipelineCache::TakeDeviceHeader() const
+	{
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(*_device, &properties);
+
+		FileHeader header {};
+
+		memcpy(header.magic, PIPELINE_CACHE_MAGIC, sizeof(header.magic));
+		memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+		header.version       = PIPELINE_CACHE_VERSION;
+		header.vendorID      = properties.vendorID;
+		header.deviceID      = properties.deviceID;
+		header.driverVersion = properties.driverVersion;
+
+		return header;
+	}
+}
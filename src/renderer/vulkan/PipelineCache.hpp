@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vulkan/vulkan_core.h>
+
+#include "device/Device.hpp"
+
+namespace renderer::vulkan
+{
+	// Pipelines compiled by earlier runs, kept in a file. The file is used only
+	//  on the device and driver version that wrote it, others start empty
+	class PipelineCache
+	{
+	public:
+
+		enum class LoadResult
+		{
+			Missing, Rejected, Loaded
+		};
+
+		PipelineCache();
+
+		// Empty path keeps the cache in memory only
+		LoadResult Create(Device*, const std::string& path, const VkAllocationCallbacks* = nullptr);
+
+		// Written next to the file first and moved over it, a crash keeps the old one.
+		//  Failures are only logged, the next start compiles pipelines again
+		void Save();
+
+		void Destroy();
+
+		std::size_t GetLoadedSize() const { return _loadedSize; }
+
+		operator VkPipelineCache() const { return _cache; }
+
+	private:
+
+		struct FileHeader
+		{
+			char     magic[4];
+			uint32_t version;
+			uint32_t vendorID, deviceID, driverVersion;
+			uint8_t  pipelineCacheUUID[VK_UUID_SIZE];
+			uint64_t dataSize;
+		};
+
+		FileHeader TakeDeviceHeader() const;
+
+	private:
+
+		Device*                      _device = nullptr;
+		const VkAllocationCallbacks* _allocator = nullptr;
+		VkPipelineCache              _cache = VK_NULL_HANDLE;
+
+		std::string _path;
+		std::size_t _loadedSize = 0;
+	};
+}
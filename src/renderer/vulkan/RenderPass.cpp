@@ -1,5 +1,6 @@
 #include "RenderPass.hpp"
 
+#include <array>
 #include <stdexcept>
 #include <vulkan/vulkan_core.h>
 
@@ -13,19 +14,21 @@ namespace renderer::vulkan
 	RenderPass::RenderPass(Device* device, VkRenderPass renderPass, VkAllocationCallbacks* allocator) :
 		_device(device), _hwRenderPass(renderPass), _allocator(allocator) {}
 
-	RenderPass RenderPass::Create(Device& device, VkFormat format, VkAllocationCallbacks* allocator)
+	RenderPass RenderPass::Create(Device& device, VkFormat format, VkAllocationCallbacks* allocator, VkAttachmentLoadOp loadOp)
 	{
+		bool loads = loadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+
 		// create render pass
 		VkAttachmentDescription colorAttachment = {};
 		colorAttachment.flags   = 0;
 		colorAttachment.format  = format;
 		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		colorAttachment.loadOp  = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colorAttachment.loadOp  = loadOp;
 		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 
 		colorAttachment.stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		colorAttachment.initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
+		colorAttachment.initialLayout  = loads ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_UNDEFINED;
 		colorAttachment.finalLayout    = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
 		VkAttachmentReference colorAttachmentRef = {};
@@ -47,10 +50,10 @@ namespace renderer::vulkan
 		dependency.dependencyFlags = 0;
 		dependency.srcSubpass      = VK_SUBPASS_EXTERNAL;
 		dependency.srcStageMask    = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.srcAccessMask   = 0;
+		dependency.srcAccessMask   = loads ? VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT : 0;
 		dependency.dstSubpass      = 0;
 		dependency.dstStageMask    = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.dstAccessMask   = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependency.dstAccessMask   = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | (loads ? VK_ACCESS_COLOR_ATTACHMENT_READ_BIT : 0);
 
 		VkRenderPassCreateInfo renderPassInfo = { VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO };
 		renderPassInfo.attachmentCount = 1;
@@ -70,6 +73,64 @@ namespace renderer::vulkan
 		return RenderPass(&device, renderPass, allocator);
 	}
 
+	RenderPass RenderPass::CreateOffscreen(Device& device, VkFormat format, VkAllocationCallbacks* allocator)
+	{
+		VkAttachmentDescription colorAttachment = {};
+		colorAttachment.flags   = 0;
+		colorAttachment.format  = format;
+		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		colorAttachment.loadOp  = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+		colorAttachment.stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		colorAttachment.initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
+		colorAttachment.finalLayout    = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkAttachmentReference colorAttachmentRef = {};
+		colorAttachmentRef.attachment = 0;
+		colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkSubpassDescription subpass {};
+		subpass.pipelineBindPoint    = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments    = &colorAttachmentRef;
+
+		std::array<VkSubpassDependency, 2> dependencies {};
+
+		// Image is shared by frames in flight, the previous frame stops reading it first
+		dependencies[0].srcSubpass    = VK_SUBPASS_EXTERNAL;
+		dependencies[0].srcStageMask  = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].srcAccessMask = 0;
+		dependencies[0].dstSubpass    = 0;
+		dependencies[0].dstStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+		dependencies[1].srcSubpass    = 0;
+		dependencies[1].srcStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstSubpass    = VK_SUBPASS_EXTERNAL;
+		dependencies[1].dstStageMask  = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		VkRenderPassCreateInfo renderPassInfo = { VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO };
+		renderPassInfo.attachmentCount = 1;
+		renderPassInfo.pAttachments    = &colorAttachment;
+		renderPassInfo.subpassCount    = 1;
+		renderPassInfo.pSubpasses      = &subpass;
+		renderPassInfo.dependencyCount = dependencies.size();
+		renderPassInfo.pDependencies   = dependencies.data();
+
+		VkRenderPass renderPass;
+
+		if (vkCreateRenderPass(device, &renderPassInfo, allocator, &renderPass) != VK_SUCCESS)
+		{
+			throw runtime_error("Failed to create render pass");
+		}
+
+		return RenderPass(&device, renderPass, allocator);
+	}
+
 	RenderPass::operator VkRenderPass&()
 	{
 		return _hwRenderPass;
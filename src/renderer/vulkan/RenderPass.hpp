@@ -13,7 +13,12 @@ namespace renderer::vulkan
 		RenderPass();
 		RenderPass(Device*, VkRenderPass, VkAllocationCallbacks*);
 
-		static RenderPass Create(Device& device, VkFormat format, VkAllocationCallbacks* allocator = nullptr);
+		// Loading pass draws over what the previous pass left in the presented image
+		static RenderPass Create(Device& device, VkFormat format, VkAllocationCallbacks* allocator = nullptr, 
+														 VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR);
+
+		// Draws into an image sampled by fragment shaders of later passes
+		static RenderPass CreateOffscreen(Device& device, VkFormat format, VkAllocationCallbacks* allocator = nullptr);
 
 		void Destroy();
 
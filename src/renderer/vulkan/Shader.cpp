@@ -23,8 +23,8 @@ namespace renderer::vulkan
 
 	ShaderManager::ShaderManager() {}
 
-	ShaderManager::ShaderManager(Device* device, Config* config, RenderPass* renderPass, const VkAllocationCallbacks* allocator) 
-		: _device(device), _config(config), _renderPass(renderPass), _allocator(allocator) { }
+	ShaderManager::ShaderManager(Device* device, Config* config, RenderPass* renderPass, VkPipelineCache pipelineCache, const VkAllocationCallbacks* allocator) 
+		: _device(device), _config(config), _renderPass(renderPass), _pipelineCache(pipelineCache), _allocator(allocator) { }
 
 	VkShaderStageFlagBits GetShaderFlags(ShaderStage stage)
 	{
@@ -39,9 +39,21 @@ namespace renderer::vulkan
 		throw runtime_error("Unexpected exception");
 	}
 
-	const uint32_t ShaderManager::CreateShader(const uint32_t* moduleIndices, int count, VkFormat swapchainImageFormat, DescriptorSetLayout* setLayout)
+	const uint32_t ShaderManager::CreateShader(const uint32_t* moduleIndices, int count, VkFormat swapchainImageFormat, DescriptorSetLayout* setLayout,
+																						VertexLayout vertexLayout, uint32_t pushConstantSize, VkShaderStageFlags pushConstantStages,
+																						std::span<const uint32_t> specialization, RenderPass* renderPass)
 	{
 		vector<VkPipelineShaderStageCreateInfo> stageCreateInfoList(count);
+		vector<VkSpecializationMapEntry>        specializationEntries(specialization.size());
+
+		for(uint32_t i = 0; i < specialization.size(); i++)
+		{
+			specializationEntries[i] = { i, uint32_t(i * sizeof(uint32_t)), sizeof(uint32_t) };
+		}
+
+		VkSpecializationInfo specializationInfo {
+			uint32_t(specializationEntries.size()), specializationEntries.data(),
+			specialization.size_bytes(), specialization.data() };
 
 		for(int i = 0; i < count; i++)
 		{
@@ -53,6 +65,9 @@ namespace renderer::vulkan
 			stageCreateInfo.stage  = GetShaderFlags(module.GetType());
 			stageCreateInfo.pName  = "main";
 			stageCreateInfo.module = module;
+
+			if (module.GetType() == ShaderStage::Fragment && !specialization.empty())
+				stageCreateInfo.pSpecializationInfo = &specializationInfo;
 		}
 
 		VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo = { VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
@@ -64,11 +79,23 @@ namespace renderer::vulkan
 		auto attributeDescription = Vertex::GetAttributeDescriptions();
 		auto bindingDescription   = Vertex::GetBindingDescription();
 
+		if (vertexLayout == VertexLayout::PerInstance)
+		{
+			attributeDescription = InstanceData::GetAttributeDescriptions();
+			bindingDescription   = InstanceData::GetBindingDescription();
+		}
+
 		VkPipelineVertexInputStateCreateInfo vertexInputInfo { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO, 0,
 		vertexInputFlags,
 		1, &bindingDescription,
 		attributeDescription.size(), attributeDescription.data() };
 
+		if (vertexLayout == VertexLayout::None)
+		{
+			vertexInputInfo.vertexBindingDescriptionCount   = 0;
+			vertexInputInfo.vertexAttributeDescriptionCount = 0;
+		}
+
 		const VkPipelineInputAssemblyStateCreateFlags inputAssemblyFlags = 0;
 		const VkBool32                                primiteRestartEnable = VK_FALSE;
 
@@ -139,6 +166,14 @@ namespace renderer::vulkan
 			pipelineLayoutInfo.pSetLayouts = &setLayout->GetHandle();
 		}
 
+		VkPushConstantRange pushConstantRange { pushConstantStages, 0, pushConstantSize };
+
+		if (pushConstantSize > 0)
+		{
+			pipelineLayoutInfo.pushConstantRangeCount = 1;
+			pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		}
+
 		VkPipelineLayout pipelineLayout;
 
 		if (vkCreatePipelineLayout(*_device, &pipelineLayoutInfo, _allocator, &pipelineLayout) != VK_SUCCESS)
@@ -158,14 +193,14 @@ namespace renderer::vulkan
 		pipelineInfo.pColorBlendState = &colorBlendingCreateInfo;
 		pipelineInfo.pDynamicState = &dynamicStateCreateInfo;
 		pipelineInfo.layout = pipelineLayout;
-		pipelineInfo.renderPass = *_renderPass;
+		pipelineInfo.renderPass = renderPass != nullptr ? *renderPass : *_renderPass;
 		pipelineInfo.subpass = 0;
 		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 		pipelineInfo.basePipelineIndex = -1;
 
 		VkPipeline pipeline;
 
-		if (vkCreateGraphicsPipelines(*_device, VK_NULL_HANDLE, 1, &pipelineInfo, _allocator, &pipeline) != VK_SUCCESS)
+		if (vkCreateGraphicsPipelines(*_device, _pipelineCache, 1, &pipelineInfo, _allocator, &pipeline) != VK_SUCCESS)
 		{
 			throw runtime_error("Failed to create graphics pipeline");
 		}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <span>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
@@ -9,6 +10,7 @@
 
 #include "Config.hpp"
 #include "DescriptorSetLayout.hpp"
+#include "Vertex.hpp"
 
 namespace renderer::vulkan
 {
@@ -18,6 +20,14 @@ namespace renderer::vulkan
 		size_t size;
 	};
 
+	// SPIR-V compiled into the renderer, see cmake/EmbedSpirv.cmake
+	struct EmbeddedShaderCode
+	{
+		const char*     name;
+		const uint32_t* code;
+		size_t          size;
+	};
+
 	// Consist rendering pipeline
 	class Shader
 	{
@@ -62,11 +72,17 @@ namespace renderer::vulkan
 	public:
 	
 		ShaderManager();
-		ShaderManager(Device*, Config*, RenderPass* renderPass, const VkAllocationCallbacks* = nullptr);
+		ShaderManager(Device*, Config*, RenderPass* renderPass, VkPipelineCache, const VkAllocationCallbacks* = nullptr);
 
 		void Destroy();
 
-		const uint32_t CreateShader(const uint32_t* moduleIndices, int count, VkFormat swapchainImageFormat, DescriptorSetLayout* setLayout = nullptr); // actually creates a whole pipeline for vulkan api
+		// actually creates a whole pipeline for vulkan api. Constant i of the
+		//  fragment stage is specialized to specialization[i]. Pipeline draws in
+		//  the render pass of the manager unless another one is given
+		const uint32_t CreateShader(const uint32_t* moduleIndices, int count, VkFormat swapchainImageFormat, DescriptorSetLayout* setLayout = nullptr,
+																VertexLayout vertexLayout = VertexLayout::PerVertex, uint32_t pushConstantSize = 0,
+																VkShaderStageFlags pushConstantStages = VK_SHADER_STAGE_VERTEX_BIT,
+																std::span<const uint32_t> specialization = {}, RenderPass* renderPass = nullptr);
 		const uint32_t CreateShaderModule(ShaderModule::Stage, const ShaderCode& );
 
 		VkPipeline       GetShaderPipeline(uint32_t shaderIndex) { return _shaders[shaderIndex].GetPipeline(); };
@@ -77,8 +93,9 @@ namespace renderer::vulkan
 		const VkAllocationCallbacks* _allocator;
 		const Config*                _config;
 
-		Device*     _device;
-		RenderPass* _renderPass;
+		Device*         _device;
+		RenderPass*     _renderPass;
+		VkPipelineCache _pipelineCache;
 
 		std::vector<Shader>       _shaders;
 		std::vector<ShaderModule> _modules;
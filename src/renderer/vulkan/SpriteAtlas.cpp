@@ -0,0 +1,365 @@
+#include "SpriteAtlas.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+#include <utility/JobGraph.hpp>
+
+using namespace rectpack2D;
+
+namespace renderer::vulkan
+{
+	using std::runtime_error;
+
+	// Frames are palette indices
+	const uint32_t ATLAS_PIXEL_SIZE = 1;
+
+	// Image with a single layer would get a plain 2D view, shader samples an array
+	const uint32_t ATLAS_MIN_PAGE_COUNT = 2;
+
+	// Frames resolved at once before they are decoded on worker threads
+	const std::size_t PARALLEL_DECODE_MIN_FRAMES = 64;
+
+	SpriteAtlas::SpriteAtlas() : _rows(FrameTableRows) {}
+
+	void SpriteAtlas::Initialize(BufferAllocator* bufferAllocator, uint64_t budget)
+	{
+		_bufferAllocator = bufferAllocator;
+
+		auto pageCount = static_cast<uint32_t>(std::clamp<uint64_t>(budget / PageBytes, ATLAS_MIN_PAGE_COUNT, MaxPageCount));
+
+		_pages.resize(pageCount);
+		_tableRows.resize(FrameTableRows);
+
+		_image      = _bufferAllocator->CreateImageArray(PageSize, PageSize, pageCount, ATLAS_PIXEL_SIZE);
+		_frameTable = _bufferAllocator->CreateStorageBuffer(nullptr, FrameTableRows * sizeof(FrameRect));
+	}
+
+	AtlasPlacement SpriteAtlas::Insert(std::shared_ptr<const data::A_SpriteSheetData> spriteSheetData, std::vector<data::SpriteData>& spriteDataList)
+	{
+		if (spriteSheetData->GetPixelSize() != ATLAS_PIXEL_SIZE)
+		{
+			throw runtime_error("Sprite atlas holds palette indices only");
+		}
+
+		for(auto& spriteData : spriteDataList)
+		{
+			if (spriteData.dimensions.x > PageSize || spriteData.dimensions.y > PageSize)
+				throw runtime_error("Sprite frame is larger than a page of the atlas");
+		}
+
+		AtlasPlacement placement;
+
+		placement.firstRow = _rows.Allocate(spriteDataList.size(), 1);
+
+		if (placement.firstRow == TlsfAllocator::NoSpace)
+		{
+			throw runtime_error("Sprite atlas frame table is full");
+		}
+
+		placement.data           = std::move(spriteSheetData);
+		placement.spriteDataList = std::move(spriteDataList);
+		placement.frames.resize(placement.spriteDataList.size(), { 0, { 0, 0, 0, 0, false }, false });
+
+		// Empty until frames are drawn
+		for(uint32_t frame = 0; frame < placement.frames.size(); frame++)
+		{
+			WriteRow(placement, frame);
+		}
+
+		return placement;
+	}
+
+	void SpriteAtlas::Free(const AtlasPlacement& placement)
+	{
+		for(uint32_t i = 0; i < placement.frames.size(); i++)
+		{
+			auto& [layer, rect, resident, requested] = placement.frames[i];
+
+			if (!resident)
+				continue;
+
+			auto& page = _pages[layer];
+
+			auto it = std::find_if(page.frames.begin(), page.frames.end(), [&placement, i] (const PageFrame& pageFrame) {
+				return pageFrame.placement == &placement && pageFrame.frame == i;
+			});
+
+			*it = page.frames.back();
+			page.frames.pop_back();
+
+			// Space of frames can't be given back one by one, only whole pages are emptied
+			if (page.frames.empty())
+				page.spaces.reset(rect_wh(PageSize, PageSize));
+
+			_residency.residentFrames--;
+			_residency.residentBytes -= rect.w * rect.h * ATLAS_PIXEL_SIZE;
+		}
+
+		_rows.Free(placement.firstRow);
+	}
+
+	void SpriteAtlas::BeginFrame()
+	{
+		_clock++;
+		_full = false;
+
+		_residency.uploadedFrames    = 0;
+		_residency.uploadedBytes     = 0;
+		_residency.placeholderFrames = 0;
+		_residency.evictedPages      = 0;
+	}
+
+	void SpriteAtlas::Request(AtlasPlacement& placement, std::span<const DrawItem> items)
+	{
+		for(auto& item : items)
+		{
+			if (item.frame >= placement.frames.size())
+				continue;
+
+			auto& atlasFrame = placement.frames[item.frame];
+
+			if (atlasFrame.resident)
+			{
+				_pages[atlasFrame.layer].lastUsed = _clock;
+				continue;
+			}
+
+			auto [width, height] = placement.spriteDataList[item.frame].dimensions;
+
+			// Row of an empty frame draws nothing already
+			if (width == 0 || height == 0 || atlasFrame.requested)
+				continue;
+
+			atlasFrame.requested = true;
+
+			_requests.push_back({ &placement, item.frame, 0 });
+		}
+	}
+
+	void SpriteAtlas::Resolve()
+	{
+		if (_requests.empty())
+			return;
+
+		// Long sides first, short frames fill the gaps left next to them
+		std::sort(_requests.begin(), _requests.end(), [] (const FrameRequest& a, const FrameRequest& b) {
+			auto first  = a.placement->spriteDataList[a.frame].dimensions;
+			auto second = b.placement->spriteDataList[b.frame].dimensions;
+
+			return std::pair(std::max(first.x, first.y), first.x * first.y) > std::pair(std::max(second.x, second.y), second.x * second.y);
+		});
+
+		std::size_t pixelCount = 0;
+		auto        placed     = _requests.begin();
+
+		for(auto& request : _requests)
+		{
+			request.placement->frames[request.frame].requested = false;
+
+			if (!Place(*request.placement, request.frame))
+			{
+				_residency.placeholderFrames++;
+				continue;
+			}
+
+			auto [width, height] = request.placement->spriteDataList[request.frame].dimensions;
+
+			request.pixelOffset = pixelCount;
+			pixelCount += width * height * ATLAS_PIXEL_SIZE;
+
+			*placed++ = request;
+		}
+
+		_requests.erase(placed, _requests.end());
+
+		_pixels.resize(pixelCount);
+
+		DecodeRequests();
+
+		for(auto& [placement, frame, pixelOffset] : _requests)
+		{
+			auto& [layer, rect, resident, requested] = placement->frames[frame];
+
+			_bufferAllocator->UpdateImageRegion(_image, _pixels.data() + pixelOffset, rect.x, rect.y, rect.w, rect.h, ATLAS_PIXEL_SIZE, layer);
+
+			WriteRow(*placement, frame);
+
+			_residency.residentFrames++;
+			_residency.residentBytes += rect.w * rect.h * ATLAS_PIXEL_SIZE;
+			_residency.uploadedFrames++;
+			_residency.uploadedBytes += rect.w * rect.h * ATLAS_PIXEL_SIZE;
+		}
+
+		_requests.clear();
+	}
+
+	bool SpriteAtlas::Place(AtlasPlacement& placement, uint32_t frame)
+	{
+		auto [width, height] = placement.spriteDataList[frame].dimensions;
+
+		std::optional<rect_xywh> rect;
+		uint32_t                 page = 0;
+
+		for(; page < _pages.size(); page++)
+		{
+			if ((rect = _pages[page].spaces.insert(rect_wh(width, height))))
+				break;
+		}
+
+		// Smaller frames may still fit into gaps once every page was drawn in this frame
+		if (!rect && _full)
+			return false;
+
+		if (!rect)
+		{
+			auto leastUsed = _pages.size();
+
+			for(page = 0; page < _pages.size(); page++)
+			{
+				if (_pages[page].lastUsed == _clock)
+					continue;
+
+				if (leastUsed == _pages.size() || _pages[page].lastUsed < _pages[leastUsed].lastUsed)
+					leastUsed = page;
+			}
+
+			if (leastUsed == _pages.size())
+			{
+				_full = true;
+				return false;
+			}
+
+			page = leastUsed;
+
+			Evict(page);
+
+			rect = _pages[page].spaces.insert(rect_wh(width, height));
+		}
+
+		placement.frames[frame] = { page, { uint32_t(rect->x), uint32_t(rect->y), uint32_t(rect->w), uint32_t(rect->h), false }, true };
+
+		_pages[page].frames.push_back({ &placement, frame });
+		_pages[page].lastUsed = _clock;
+
+		return true;
+	}
+
+	void SpriteAtlas::DecodeRequests()
+	{
+		auto decode = [this] (std::size_t first, std::size_t last) {
+
+			for(std::size_t i = first; i < last; i++)
+			{
+				auto& [placement, frame, pixelOffset] = _requests[i];
+
+				auto [width, height] = placement->spriteDataList[frame].dimensions;
+				auto pixels          = _pixels.data() + pixelOffset;
+
+				// Transparent pixels are skipped by the reader
+				std::fill(pixels, pixels + width * height * ATLAS_PIXEL_SIZE, 0);
+
+				placement->data->ReadPixelData(frame, pixels, width * ATLAS_PIXEL_SIZE);
+			}
+		};
+
+		// Starting workers costs more than decoding a few frames
+		if (_requests.size() < PARALLEL_DECODE_MIN_FRAMES)
+		{
+			decode(0, _requests.size());
+			return;
+		}
+
+		utility::JobGraph jobs;
+
+		const std::size_t jobCount  = utility::JobGraph::GetDefaultThreadCount();
+		const std::size_t chunkSize = (_requests.size() + jobCount - 1) / jobCount;
+
+		for(std::size_t first = 0; first < _requests.size(); first += chunkSize)
+		{
+			auto last = std::min(first + chunkSize, _requests.size());
+
+			jobs.Add("DecodeFrames", [&decode, first, last] { decode(first, last); });
+		}
+
+		jobs.Start();
+		jobs.Wait();
+	}
+
+	void SpriteAtlas::Evict(uint32_t pageIndex)
+	{
+		auto& page = _pages[pageIndex];
+
+		// Frames in flight finish sampling the page before uploads overwrite it
+		for(auto [placement, frame] : page.frames)
+		{
+			auto& rect = placement->frames[frame].rect;
+
+			placement->frames[frame].resident = false;
+
+			WriteRow(*placement, frame);
+
+			_residency.residentFrames--;
+			_residency.residentBytes -= rect.w * rect.h * ATLAS_PIXEL_SIZE;
+		}
+
+		page.frames.clear();
+		page.spaces.reset(rect_wh(PageSize, PageSize));
+
+		_residency.evictedPages++;
+	}
+
+	void SpriteAtlas::WriteRow(const AtlasPlacement& placement, uint32_t frame)
+	{
+		const float pageSize = PageSize;
+
+		auto  offset = placement.spriteDataList[frame].offset;
+		auto& [layer, rect, resident, requested] = placement.frames[frame];
+		auto& row = _tableRows[placement.firstRow + frame];
+
+		// Frames that aren't resident are drawn as empty quads
+		if (resident)
+		{
+			row.uv = {
+				EncodeAtlasLayer(rect.x / pageSize, layer),
+				rect.y / pageSize,
+				EncodeAtlasLayer((rect.x + rect.w) / pageSize, layer),
+				(rect.y + rect.h) / pageSize,
+			};
+
+			row.rect = { offset.x, offset.y, rect.w, rect.h };
+		}
+		else
+		{
+			row.uv   = { 0, 0, 0, 0 };
+			row.rect = { offset.x, offset.y, 0, 0 };
+		}
+
+		_dirtyRows.push_back(placement.firstRow + frame);
+	}
+
+	void SpriteAtlas::Commit()
+	{
+		std::sort(_dirtyRows.begin(), _dirtyRows.end());
+		_dirtyRows.erase(std::unique(_dirtyRows.begin(), _dirtyRows.end()), _dirtyRows.end());
+
+		// Neighbouring rows go in one copy
+		for(std::size_t first = 0, last = 0; first < _dirtyRows.size(); first = last)
+		{
+			for(last = first + 1; last < _dirtyRows.size() && _dirtyRows[last] == _dirtyRows[last - 1] + 1; last++);
+
+			auto row   = _dirtyRows[first];
+			auto count = last - first;
+
+			_bufferAllocator->UpdateBufferData(_frameTable, &_tableRows[row], count * sizeof(FrameRect), row * sizeof(FrameRect));
+		}
+
+		_dirtyRows.clear();
+
+		_residency.usedPages = std::count_if(_pages.begin(), _pages.end(), [] (const Page& page) { return !page.frames.empty(); });
+		_residency.pageCount = _pages.size();
+		_residency.pageBytes = PageBytes * ATLAS_PIXEL_SIZE;
+	}
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <rectpack2D/finders_interface.h>
+#include <span>
+#include <vector>
+
+#include "../A_Graphics.hpp"
+#include "Atlas.hpp"
+#include "Vertex.hpp"
+#include "data/Sprite.hpp"
+#include "memory/BufferAllocator.hpp"
+#include "memory/TlsfAllocator.hpp"
+
+namespace renderer::vulkan
+{
+	// Frames of every sprite sheet packed into layers of one texture array, so
+	//  sheets share the image, the frame table and their draws. Frames are
+	//  decoded and uploaded the first time they are drawn. Layers are pages of
+	//  fixed size, as many as the budget allows, the least recently drawn page
+	//  is emptied when a frame fits nowhere else
+	class SpriteAtlas
+	{
+	public:
+
+		static constexpr uint32_t PageSize  = 2048;
+		static constexpr uint64_t PageBytes = PageSize * PageSize;
+		static constexpr uint32_t MaxPageCount = 256;
+
+		// Frame of instance data is 16 bits
+		static constexpr uint32_t FrameTableRows = 1 << 16;
+
+		SpriteAtlas();
+
+		void Initialize(BufferAllocator*, uint64_t budget);
+
+		// Takes frame table rows for the sheet, no frame is resident yet
+		AtlasPlacement Insert(std::shared_ptr<const data::A_SpriteSheetData>, std::vector<data::SpriteData>&);
+		void Free(const AtlasPlacement&);
+
+		// Starts counting uploads of a frame, pages drawn in it are kept until the next one
+		void BeginFrame();
+
+		// Keeps pages of resident frames of the items, queues the others
+		void Request(AtlasPlacement&, std::span<const DrawItem> items);
+
+		// Packs frames queued by every sheet in one pass, largest first, and
+		//  decodes them on worker threads when there are many. Frames no page
+		//  can take are drawn empty, they are tried again when drawn next time
+		void Resolve();
+
+		// Writes frame table rows changed since the last commit, counts used pages
+		void Commit();
+
+		Image*  GetImage() const { return _image; }
+		Buffer* GetFrameTable() const { return _frameTable; }
+
+		const SpriteResidency& GetResidency() const { return _residency; }
+
+	private:
+
+		typedef rectpack2D::empty_spaces<false, rectpack2D::default_empty_spaces> PageSpaces;
+
+		struct PageFrame
+		{
+			AtlasPlacement* placement;
+			uint32_t        frame;
+		};
+
+		struct FrameRequest
+		{
+			AtlasPlacement* placement;
+			uint32_t        frame;
+			std::size_t     pixelOffset;  // in the decoded pixels
+		};
+
+		struct Page
+		{
+			PageSpaces             spaces { rectpack2D::rect_wh(PageSize, PageSize) };
+			std::vector<PageFrame> frames;
+			uint64_t               lastUsed = 0;
+		};
+
+		bool Place(AtlasPlacement&, uint32_t frame);
+		void DecodeRequests();
+		void Evict(uint32_t page);
+		void WriteRow(const AtlasPlacement&, uint32_t frame);
+
+	private:
+
+		BufferAllocator* _bufferAllocator = nullptr;
+		Image*           _image = nullptr;
+		Buffer*          _frameTable = nullptr;
+
+		std::vector<Page> _pages;
+		TlsfAllocator     _rows;
+
+		// Copy of the frame table, rows are uploaded in runs on commit
+		std::vector<FrameRect> _tableRows;
+		std::vector<uint32_t>  _dirtyRows;
+
+		std::vector<FrameRequest> _requests;
+		std::vector<uint8_t>      _pixels;
+
+		// Counts frames, pages drawn in the current one can't be evicted
+		uint64_t _clock = 1;
+		bool     _full = false;
+
+		SpriteResidency _residency;
+	};
+}
@@ -0,0 +1,82 @@
+#include "Transform.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+	#define RENDERER_SSE2
+	#include <emmintrin.h>
+#endif
+
+namespace renderer::vulkan
+{
+	static_assert(sizeof(Vertex) == 4 * sizeof(float), "Vertex is expected to fit into one SSE register");
+	static_assert(sizeof(InstanceData) == sizeof(uint64_t), "Instance is expected to be written as one 64-bit value");
+	static_assert(offsetof(InstanceData, frame) == 4, "Frame and flags are expected in the upper half of instance");
+
+	void TransformVertices(const Vertex* input, Vertex* output, std::size_t count, glm::vec2 offset, glm::vec2 inverseExtent)
+	{
+		// (pos + offset) * 2 / extent - 1, texture coordinates pass through
+		float scaleX = inverseExtent.x * 2.0f;
+		float scaleY = inverseExtent.y * 2.0f;
+		float moveX  = offset.x * scaleX - 1.0f;
+		float moveY  = offset.y * scaleY - 1.0f;
+
+#ifdef RENDERER_SSE2
+		const __m128 scale = _mm_setr_ps(scaleX, scaleY, 1.0f, 1.0f);
+		const __m128 move  = _mm_setr_ps(moveX, moveY, 0.0f, 0.0f);
+
+		auto source      = reinterpret_cast<const float*>(input);
+		auto destination = reinterpret_cast<float*>(output);
+
+		for(std::size_t i = 0; i < count; i++)
+		{
+			__m128 vertex = _mm_loadu_ps(source + i * 4);
+
+			_mm_storeu_ps(destination + i * 4, _mm_add_ps(_mm_mul_ps(vertex, scale), move));
+		}
+#else
+		for(std::size_t i = 0; i < count; i++)
+		{
+			Vertex vertex = input[i];
+
+			vertex.pos.x = vertex.pos.x * scaleX + moveX;
+			vertex.pos.y = vertex.pos.y * scaleY + moveY;
+
+			output[i] = vertex;
+		}
+#endif
+	}
+
+	void TransformInstances(std::span<const DrawItem> items, const uint32_t* frames, data::position view, InstanceData* output)
+	{
+#ifdef RENDERER_SSE2
+		const __m128i viewVector = _mm_setr_epi32(view.x, view.y, 0, 0);
+
+		for(std::size_t i = 0; i < items.size(); i++)
+		{
+			__m128i position = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(&items[i].pos));
+
+			position = _mm_sub_epi32(position, viewVector);
+			position = _mm_packs_epi32(position, position);
+
+			uint64_t instance = static_cast<uint32_t>(_mm_cvtsi128_si32(position)) | static_cast<uint64_t>(frames[i]) << 32;
+
+			std::memcpy(output + i, &instance, sizeof(instance));
+		}
+#else
+		for(std::size_t i = 0; i < items.size(); i++)
+		{
+			auto relative = items[i].pos - view;
+
+			InstanceData instance;
+			instance.x     = std::clamp(relative.x, INT16_MIN, INT16_MAX);
+			instance.y     = std::clamp(relative.y, INT16_MIN, INT16_MAX);
+			instance.frame = frames[i] & 0xFFFF;
+			instance.flags = frames[i] >> 16;
+
+			output[i] = instance;
+		}
+#endif
+	}
+}
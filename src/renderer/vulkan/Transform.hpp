@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include <glm/ext/vector_float2.hpp>
+
+#include "../A_Graphics.hpp"
+#include "Vertex.hpp"
+
+namespace renderer::vulkan
+{
+	// Moves vertices by offset and maps them from pixels to normalized
+	//  device coordinates. Output is only written, so it can be mapped memory.
+	void TransformVertices(const Vertex* input, Vertex* output, std::size_t count, glm::vec2 offset, glm::vec2 inverseExtent);
+
+	// Builds instances from items made relative to the view, positions
+	//  are saturated to 16 bits. frames[i] holds frame | flags << 16.
+	void TransformInstances(std::span<const DrawItem> items, const uint32_t* frames, data::position view, InstanceData* output);
+}
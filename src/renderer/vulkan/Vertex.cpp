@@ -29,4 +29,25 @@ namespace renderer::vulkan
 
 		return array;
 	}
+
+	BindingDescription InstanceData::GetBindingDescription()
+	{
+		const BindingDescription bindingDescription {
+			.binding = 0,
+			.stride = sizeof(InstanceData),
+			.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE
+		};
+
+		return bindingDescription;
+	}
+
+	array<AttributeDescription, 2> InstanceData::GetAttributeDescriptions()
+	{
+		array<AttributeDescription, 2> array = {
+			AttributeDescription { 0, 0, VK_FORMAT_R16G16_SINT, offsetof(InstanceData, x) },
+			AttributeDescription { 1, 0, VK_FORMAT_R16G16_UINT, offsetof(InstanceData, frame) }
+		};
+
+		return array;
+	}
 }
\ No newline at end of file
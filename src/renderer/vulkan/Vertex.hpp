@@ -1,7 +1,10 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
 #include <glm/ext/vector_float2.hpp>
+#include <glm/ext/vector_float4.hpp>
+#include <glm/ext/vector_uint4.hpp>
 #include <vulkan/vulkan_core.h>
 
 namespace renderer::vulkan
@@ -15,4 +18,61 @@ namespace renderer::vulkan
 
 		static std::array<VkVertexInputAttributeDescription, 2> GetAttributeDescriptions();
 	};
+
+	// Flip flags of a draw item go above the frame's own ones in the packed frame.
+	//  Frame is flipped inside its rect, item is mirrored around its position
+	const uint32_t INSTANCE_MIRROR_SHIFT = 16 + 2;
+
+	// One quad of the instanced path, vertex shader expands it
+	//  using the drawable's frame table
+	struct InstanceData
+	{
+		int16_t  x, y;   // relative to the view
+		uint16_t frame;  // row in frame table
+		uint16_t flags;  // data::FlipFlags of the frame, mirror flags of the item
+
+		static VkVertexInputBindingDescription GetBindingDescription();
+
+		static std::array<VkVertexInputAttributeDescription, 2> GetAttributeDescriptions();
+	};
+
+	// Push constants of the instanced shader
+	struct InstanceConstants
+	{
+		glm::vec2 inverseExtent;
+	};
+
+	// Push constants of the tilemap shader
+	struct TilemapConstants
+	{
+		int32_t cellSize;
+	};
+
+	// Push constants of the video shader, rgb = rows * (y, u, v, 1)
+	struct VideoConstants
+	{
+		glm::vec4 rows[3];
+		int32_t   semiPlanar;
+	};
+
+	// Push constants of the resolve shader, ranges of the palette rotated
+	//  as first, count, period. Unused ones are empty
+	struct ResolveConstants
+	{
+		glm::uvec4 cycles[4];
+		uint32_t   tick;
+	};
+
+	// Row of frame table, laid out as std430 storage buffer
+	struct FrameRect
+	{
+		glm::vec4 uv;   // left, top, right, bottom
+		glm::vec4 rect; // offset and size in pixels
+	};
+
+	enum class VertexLayout
+	{
+		PerVertex, PerInstance,
+		None  // positions come from the vertex index
+	};
 }
\ No newline at end of file
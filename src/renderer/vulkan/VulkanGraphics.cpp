@@ -5,7 +5,8 @@
 #include "Drawable.hpp"
 #include "Sampler.hpp"
 #include "Shader.hpp"
-#include "SpritePacker.hpp"
+#include "SpriteAtlas.hpp"
+#include "Transform.hpp"
 #include "data/Assets.hpp"
 #include "data/Common.hpp"
 #include "data/Palette.hpp"
@@ -20,12 +21,17 @@
 #include "memory/MemoryManager.hpp"
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cstdint>
 #include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <glm/ext/matrix_transform.hpp>
 #include <iostream>
 #include <memory>
+#include <numeric>
+#include <span>
 #include <stdexcept>
 #include <vector>
 
@@ -35,6 +41,7 @@
 #include <glm/vec2.hpp>
 
 #include "DescriptorSetLayout.hpp"
+#include "EmbeddedShaders.hpp"
 	
 	#include <diagnostic/Image.hpp>
 
@@ -46,14 +53,20 @@ namespace renderer::vulkan
 	using std::vector;
 	using ShaderStage = ShaderModule::Stage;
 
+	// Colors in the first row, indices of each palette remap below
+	const uint32_t PALETTE_IMAGE_ROWS = data::PALETTE_REMAP_COUNT;
+
 	const std::vector<const char*> validationLayers = {
 		"VK_LAYER_KHRONOS_validation"
 	};
 
-	Graphics::Graphics(SDL_Window* window, const data::Assets* assets) : _window(window), _assets(assets)
+	Graphics::Graphics(SDL_Window* window, const data::Assets* assets, const GraphicsSettings& settings)
+		: _window(window), _assets(assets), _shaderOverridePath(settings.shaderOverridePath), _indexedRendering(settings.indexedRendering)
 	{
 		const VkAllocationCallbacks* allocator = VK_NULL_HANDLE;
 
+		auto startTime = std::chrono::steady_clock::now();
+
 		// Check out layers
 		vector<const char*> requiredLayers;
 
@@ -81,11 +94,23 @@ namespace renderer::vulkan
 
 		_renderPass = RenderPass::Create(_device, surfaceFormat.format);
 		_swapchain  = Swapchain::Create(_device, &_renderPass, _surface, surfaceFormat, _config);
-		_shaders    = ShaderManager(&_device, &_config, &_renderPass);
+
+		auto pipelineCacheLoad = _pipelineCache.Create(&_device, settings.pipelineCachePath, allocator);
+
+		_shaders = ShaderManager(&_device, &_config, &_renderPass, _pipelineCache);
+
+		if (_indexedRendering)
+		{
+			_indexRenderPass = RenderPass::CreateOffscreen(_device, VK_FORMAT_R8_UNORM);
+			_loadRenderPass  = RenderPass::Create(_device, surfaceFormat.format, nullptr, VK_ATTACHMENT_LOAD_OP_LOAD);
+		}
+
+		// OutputIndices of palettized fragment shaders
+		const array<uint32_t, 1> indexSpecialization = { 1 };
 
 		{
-			auto fragmentShaderModule = _shaders.CreateShaderModule(ShaderStage::Fragment, ReadShaderCode("shaders/tex_frag.spv"));
-			auto vertexShaderModule   = _shaders.CreateShaderModule(ShaderStage::Vertex, ReadShaderCode("shaders/tex_vert.spv"));
+			auto fragmentShaderModule = _shaders.CreateShaderModule(ShaderStage::Fragment, ReadShaderCode("tex_frag.spv"));
+			auto vertexShaderModule   = _shaders.CreateShaderModule(ShaderStage::Vertex, ReadShaderCode("tex_vert.spv"));
 			array<uint32_t, 2> modules = { fragmentShaderModule, vertexShaderModule };
 
 			_samplerLayout = DescriptorSetLayout::Builder(&_device)
@@ -96,8 +121,8 @@ namespace renderer::vulkan
 		}
 
 		{
-			auto fragmentShaderModule = _shaders.CreateShaderModule(ShaderStage::Fragment, ReadShaderCode("shaders/pal_frag.spv"));
-			auto vertexShaderModule   = _shaders.CreateShaderModule(ShaderStage::Vertex, ReadShaderCode("shaders/pal_vert.spv"));
+			auto fragmentShaderModule = _shaders.CreateShaderModule(ShaderStage::Fragment, ReadShaderCode("pal_frag.spv"));
+			auto vertexShaderModule   = _shaders.CreateShaderModule(ShaderStage::Vertex, ReadShaderCode("pal_vert.spv"));
 			array<uint32_t, 2> modules = { fragmentShaderModule, vertexShaderModule };
 
 			_standardLayout = DescriptorSetLayout::Builder(&_device)
@@ -106,13 +131,112 @@ namespace renderer::vulkan
 				.Create(allocator);
 
 			_mainShaderIndex = _shaders.CreateShader(modules.data(), modules.size(), _swapchain.GetFormat(), &_standardLayout);
+
+			if (_indexedRendering)
+			{
+				_mainIndexShaderIndex = _shaders.CreateShader(modules.data(), modules.size(), VK_FORMAT_R8_UNORM, &_standardLayout,
+																											VertexLayout::PerVertex, 0, VK_SHADER_STAGE_VERTEX_BIT, indexSpecialization, &_indexRenderPass);
+			}
+		}
+
+		{
+			auto fragmentShaderModule = _shaders.CreateShaderModule(ShaderStage::Fragment, ReadShaderCode("pal_frag.spv"));
+			auto vertexShaderModule   = _shaders.CreateShaderModule(ShaderStage::Vertex, ReadShaderCode("inst_vert.spv"));
+			array<uint32_t, 2> modules = { fragmentShaderModule, vertexShaderModule };
+
+			_instancedLayout = DescriptorSetLayout::Builder(&_device)
+				.AddBinding(BindSampler)
+				.AddBinding(BindSampler)
+				.AddBinding(BindStorageBuffer)
+				.Create(allocator);
+
+			_instancedShaderIndex = _shaders.CreateShader(modules.data(), modules.size(), _swapchain.GetFormat(), &_instancedLayout,
+																										VertexLayout::PerInstance, sizeof(InstanceConstants));
+
+			if (_indexedRendering)
+			{
+				_instancedIndexShaderIndex = _shaders.CreateShader(modules.data(), modules.size(), VK_FORMAT_R8_UNORM, &_instancedLayout,
+																													 VertexLayout::PerInstance, sizeof(InstanceConstants), VK_SHADER_STAGE_VERTEX_BIT,
+																													 indexSpecialization, &_indexRenderPass);
+			}
+		}
+
+		{
+			auto fragmentShaderModule = _shaders.CreateShaderModule(ShaderStage::Fragment, ReadShaderCode("atlas_frag.spv"));
+			auto vertexShaderModule   = _shaders.CreateShaderModule(ShaderStage::Vertex, ReadShaderCode("pal_vert.spv"));
+			_atlasModules = { fragmentShaderModule, vertexShaderModule };
+
+			_atlasShaderIndex = _shaders.CreateShader(_atlasModules.data(), _atlasModules.size(), _swapchain.GetFormat(), &_standardLayout);
+		}
+
+		{
+			auto fragmentShaderModule = _shaders.CreateShaderModule(ShaderStage::Fragment, ReadShaderCode("atlas_frag.spv"));
+			auto vertexShaderModule   = _shaders.CreateShaderModule(ShaderStage::Vertex, ReadShaderCode("inst_vert.spv"));
+			_atlasInstancedModules = { fragmentShaderModule, vertexShaderModule };
+
+			_atlasInstancedShaderIndex = _shaders.CreateShader(_atlasInstancedModules.data(), _atlasInstancedModules.size(), _swapchain.GetFormat(), &_instancedLayout,
+																												 VertexLayout::PerInstance, sizeof(InstanceConstants));
+		}
+
+		CreateSpriteShaderVariants();
+
+		{
+			auto fragmentShaderModule = _shaders.CreateShaderModule(ShaderStage::Fragment, ReadShaderCode("tilemap_frag.spv"));
+			auto vertexShaderModule   = _shaders.CreateShaderModule(ShaderStage::Vertex, ReadShaderCode("pal_vert.spv"));
+			array<uint32_t, 2> modules = { fragmentShaderModule, vertexShaderModule };
+
+			_tilemapLayout = DescriptorSetLayout::Builder(&_device)
+				.AddBinding(BindSampler)
+				.AddBinding(BindSampler)
+				.AddBinding(BindSampler)
+				.Create(allocator);
+
+			_tilemapShaderIndex = _shaders.CreateShader(modules.data(), modules.size(), _swapchain.GetFormat(), &_tilemapLayout,
+																									VertexLayout::PerVertex, sizeof(TilemapConstants), VK_SHADER_STAGE_FRAGMENT_BIT);
+
+			if (_indexedRendering)
+			{
+				_tilemapIndexShaderIndex = _shaders.CreateShader(modules.data(), modules.size(), VK_FORMAT_R8_UNORM, &_tilemapLayout,
+																												 VertexLayout::PerVertex, sizeof(TilemapConstants), VK_SHADER_STAGE_FRAGMENT_BIT,
+																												 indexSpecialization, &_indexRenderPass);
+			}
+		}
+
+		if (_indexedRendering)
+		{
+			auto fragmentShaderModule = _shaders.CreateShaderModule(ShaderStage::Fragment, ReadShaderCode("resolve_frag.spv"));
+			auto vertexShaderModule   = _shaders.CreateShaderModule(ShaderStage::Vertex, ReadShaderCode("resolve_vert.spv"));
+			array<uint32_t, 2> modules = { fragmentShaderModule, vertexShaderModule };
+
+			// Index target and palette take the bindings of a palettized draw
+			_resolveShaderIndex = _shaders.CreateShader(modules.data(), modules.size(), _swapchain.GetFormat(), &_standardLayout,
+																									VertexLayout::None, sizeof(ResolveConstants), VK_SHADER_STAGE_FRAGMENT_BIT);
+		}
+
+		{
+			auto fragmentShaderModule = _shaders.CreateShaderModule(ShaderStage::Fragment, ReadShaderCode("video_frag.spv"));
+			auto vertexShaderModule   = _shaders.CreateShaderModule(ShaderStage::Vertex, ReadShaderCode("tex_vert.spv"));
+			array<uint32_t, 2> modules = { fragmentShaderModule, vertexShaderModule };
+
+			_videoLayout = DescriptorSetLayout::Builder(&_device)
+				.AddBinding(BindSampler)
+				.AddBinding(BindSampler)
+				.AddBinding(BindSampler)
+				.Create(allocator);
+
+			_videoShaderIndex = _shaders.CreateShader(modules.data(), modules.size(), _swapchain.GetFormat(), &_videoLayout,
+																								VertexLayout::PerVertex, sizeof(VideoConstants), VK_SHADER_STAGE_FRAGMENT_BIT);
 		}
 
-		CreateDescriptorPools();
+		CreateDescriptorPool();
 
 		QueueFamilyIndices familyIndices = FindQueueFamilies(_device, _surface);
 		_commandPool = CreateCommandPool(_device, familyIndices.graphicsFamily.value());
-		_commandBuffer = CreateCommandBuffer(_device, _commandPool);
+
+		for(auto& frame : _frames)
+		{
+			frame.commandBuffer = CreateCommandBuffer(_device, _commandPool);
+		}
 
 		CreateSyncObjects();
 
@@ -120,7 +244,7 @@ namespace renderer::vulkan
 
 		_bufferAllocator = BufferAllocator(&_device, _device.GetGraphicsQueue(), _commandPool, 
 																				&_memoryManager, allocator);
-		_bufferAllocator.Initialize();
+		_bufferAllocator.Initialize(FRAMES_IN_FLIGHT);
 
 		_textureSampler = Sampler::Builder(_device)
 			.AnisotropyEnabled(VK_FALSE)
@@ -136,7 +260,40 @@ namespace renderer::vulkan
 			.RepeatMode(VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE)
 			.Create(allocator);	
 
-		_tilesetImage = _bufferAllocator.CreateTextureImage(nullptr, 256, 1, 4);
+		_tilesetImage = _bufferAllocator.CreateTextureImage(nullptr, data::PALETTE_SIZE, PALETTE_IMAGE_ROWS, 4);
+
+		std::array<uint8_t, data::PALETTE_SIZE> identity;
+		std::iota(identity.begin(), identity.end(), 0);
+
+		for(uint32_t remap = 1; remap < data::PALETTE_REMAP_COUNT; remap++)
+		{
+			SetPaletteRemap(static_cast<data::PaletteRemap>(remap), identity);
+		}
+
+		_spriteAtlas.Initialize(&_bufferAllocator, settings.spriteMemoryBudget);
+
+		if (_indexedRendering)
+		{
+			_indexTarget = _bufferAllocator.CreateRenderTarget(screenWidth, screenHeight, 1);
+			_indexFramebuffer.emplace(FrameBuffer::CreateBuffer(&_device, &_indexRenderPass, &_config, _indexTarget->GetViewHandle()));
+		}
+
+		auto initTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime);
+
+		std::cout << "  Vulkan API: initialized in " << initTime.count() << " ms" << (_indexedRendering ? ", indexed rendering" : "") << ", pipeline cache ";
+
+		switch(pipelineCacheLoad)
+		{
+			case PipelineCache::LoadResult::Loaded:
+				std::cout << "loaded " << _pipelineCache.GetLoadedSize() / 1024 << " KB" << std::endl;
+				break;
+			case PipelineCache::LoadResult::Rejected:
+				std::cout << "rejected, written by another device or driver" << std::endl;
+				break;
+			case PipelineCache::LoadResult::Missing:
+				std::cout << "missing" << std::endl;
+				break;
+		}
 	}
 
 	void Graphics::CreateInstance(vector<const char*>& enabledLayers)
@@ -196,33 +353,14 @@ namespace renderer::vulkan
 		// must be signaled initially so the program won't halt on the first frame
 		fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-		if (vkCreateSemaphore(_device, &semaphoreCreateInfo, allocator, &_imageAvailableSemaphore) != VK_SUCCESS || 
-				vkCreateSemaphore(_device, &semaphoreCreateInfo, allocator, &_renderFinishedSemaphore) != VK_SUCCESS ||
-				vkCreateFence(_device, &fenceCreateInfo, allocator, &_fence) != VK_SUCCESS)
-		{
-			throw runtime_error("Failed to create synchronization objects");
-		}
-	}
-
-	void Graphics::CreateDescriptorPools()
-	{
-		const VkAllocationCallbacks* allocator = nullptr;
-		const uint32_t MAX_SETS = 200;
-
-		array<VkDescriptorPoolSize, 1> poolSizes {
-			VkDescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_SETS),
-		};
-
-		VkDescriptorPoolCreateInfo poolInfo { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
-
-		poolInfo.poolSizeCount = poolSizes.size();
-		poolInfo.pPoolSizes    = poolSizes.data();
-		poolInfo.maxSets       = MAX_SETS;
-		poolInfo.flags         = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-
-		if (vkCreateDescriptorPool(_device, &poolInfo, allocator, &_descriptorPool) != VK_SUCCESS)
+		for(auto& frame : _frames)
 		{
-			throw runtime_error("Failed to create descriptor pool");
+			if (vkCreateSemaphore(_device, &semaphoreCreateInfo, allocator, &frame.imageAvailableSemaphore) != VK_SUCCESS || 
+					vkCreateSemaphore(_device, &semaphoreCreateInfo, allocator, &frame.renderFinishedSemaphore) != VK_SUCCESS ||
+					vkCreateFence(_device, &fenceCreateInfo, allocator, &frame.fence) != VK_SUCCESS)
+			{
+				throw runtime_error("Failed to create synchronization objects");
+			}
 		}
 	}
 
@@ -244,46 +382,28 @@ namespace renderer::vulkan
 		return score;
 	}
 
-	DrawableHandle Graphics::LoadSpriteSheet(data::A_SpriteSheetData& spriteSheetData)
+	DrawableHandle Graphics::LoadSpriteSheet(std::shared_ptr<const data::A_SpriteSheetData> spriteSheetData)
 	{
 		vector<data::SpriteData> spriteDataList;
 
-		for(int i = 0; i < spriteSheetData.GetSpriteCount(); i++)
+		for(int i = 0; i < spriteSheetData->GetSpriteCount(); i++)
 		{
-			auto frameData = spriteSheetData.GetSpriteData(i);
+			auto frameData = spriteSheetData->GetSpriteData(i);
 
 			spriteDataList.push_back(frameData);
 		}
 
-		SpritePacker spritePacker(spriteDataList);
-
-		auto atlas = spritePacker.CreateAtlas();
-		auto atlasWidth = atlas.GetDimensions().x;
-		auto atlasHeight = atlas.GetDimensions().y;
-
-		int pixelSize = spriteSheetData.GetPixelSize();
-		auto texturePixelData = std::make_shared<uint8_t[]>(atlasWidth * atlasHeight * pixelSize);
-
-		for(int i = 0; i < spriteSheetData.GetSpriteCount(); i++)
-		{
-			data::SpriteRect frameRect = atlas.GetFrame(i);
-
-			int  rowOffset = frameRect.y * atlasWidth * pixelSize;
-			int  colOffset = frameRect.x * pixelSize;
-			auto destinationData = texturePixelData.get() + rowOffset + colOffset;
-
-			spriteSheetData.ReadPixelData(i, destinationData, atlasWidth * pixelSize);
-		}
+		auto placement   = _spriteAtlas.Insert(std::move(spriteSheetData), spriteDataList);
+		auto spriteSheet = new SpriteSheet(placement, _spriteAtlas.GetImage());
 
-		auto image = _bufferAllocator.CreateTextureImage(texturePixelData.get(), atlasWidth, atlasHeight, pixelSize);
-		auto spriteSheet = new SpriteSheet(spriteDataList, atlas, image);
+		spriteSheet->SetFrameTable(_spriteAtlas.GetFrameTable());
 
 		_drawables.push_back(spriteSheet);
 
 		return spriteSheet;
 	}
 
-	DrawableHandle Graphics::LoadTileset(data::A_TilesetData& tilesetData, std::vector<bool>& usedTiles)
+	TilesetAtlas Graphics::BakeTileset(const data::A_TilesetData& tilesetData, const std::vector<bool>& usedTiles) const
 	{
 		int usedTilesCount = std::count(usedTiles.begin(), usedTiles.end(), true);
 		int tileSize       = tilesetData.GetTileSize();
@@ -293,19 +413,23 @@ namespace renderer::vulkan
 		bool halfWidth     = tilesetSquare <= textureHeight * textureHeight / 2;
 		int  textureWidth   = halfWidth ? textureHeight / 2 : textureHeight;
 
-		auto texturePixelData = std::make_shared<uint8_t[]>(textureWidth * textureHeight);
+		TilesetAtlas atlas;
+
+		atlas.pixels   = std::make_shared<uint8_t[]>(textureWidth * textureHeight);
+		atlas.width    = textureWidth;
+		atlas.height   = textureHeight;
+		atlas.cellSize = tileSize;
+		atlas.tileMap.resize(tilesetData.GetTileCount(), 0);
 
 		int offsetX = 0, offsetY = 0;
 		int index = 0;
 
-		_tileMap.resize(tilesetData.GetTileCount(), 0);
-
 		for (int i = 0; i < tilesetData.GetTileCount(); i++)
 		{
 			if (!usedTiles[i])
 				continue;
 
-			tilesetData.GetPixelData(i, texturePixelData.get(), offsetX + offsetY, textureWidth);
+			tilesetData.GetPixelData(i, atlas.pixels.get(), offsetX + offsetY, textureWidth);
 
 			offsetX += tileSize;
 
@@ -315,13 +439,22 @@ namespace renderer::vulkan
 				offsetY += textureWidth * tileSize;
 			}
 
-			_tileMap[i] = index++;
+			atlas.tileMap[i] = index++;
 		}
 
+		atlas.cellCount = index;
+
+		return atlas;
+	}
+
+	DrawableHandle Graphics::LoadTileset(data::A_TilesetData& tilesetData, TilesetAtlas atlas)
+	{
 		const int pixelSize = 1;
 
-		auto image = _bufferAllocator.CreateTextureImage(texturePixelData.get(), textureWidth, textureHeight, pixelSize);
-		Tileset *tileset = new Tileset(tilesetData, _tileMap, image, tileSize, textureWidth, textureHeight);
+		auto image = _bufferAllocator.CreateTextureImage(atlas.pixels.get(), atlas.width, atlas.height, pixelSize);
+		Tileset *tileset = new Tileset(tilesetData, std::move(atlas.tileMap), image, atlas.cellSize, atlas.cellCount, atlas.width, atlas.height);
+
+		CreateFrameTable(tileset);
 
 		_drawables.push_back(tileset);
 
@@ -347,346 +480,1208 @@ namespace renderer::vulkan
 		return picture;
 	}
 
-	DrawCall* Graphics::UseDrawCall(DrawableHandle drawableHandle)
-	{
-		// Break into another draw call
-		if (_currentDrawCall == nullptr || drawableHandle != _currentDrawCall->drawable)
-		{
-			// Validate new drawable
-			auto drawable = ConvertToDrawable(drawableHandle);
-
-			_drawCalls.emplace_back(drawable);
-			return &_drawCalls.back();
-		}
+	// One more than frames in flight, so the written image is never sampled
+	const uint32_t STREAMING_IMAGE_COUNT = FRAMES_IN_FLIGHT + 1;
 
-		return _currentDrawCall;
-	}
-
-	void Graphics::Draw(DrawableHandle drawableHandle, frameIndex frame, data::position position)
+	DrawableHandle Graphics::CreateStreamingImage(uint32_t width, uint32_t height, ImageFormat format)
 	{
-		_currentDrawCall = UseDrawCall(drawableHandle);
+		const uint32_t pixelSize = format == ImageFormat::R8 ? 1 : 4;
 
-		array<Vertex, 10> polygonVertices;
-
-		auto count = _currentDrawCall->drawable->GetPolygon(frame, polygonVertices, polygonVertices.size());
+		// Cleared, so it can be drawn before the first update
+		vector<uint8_t> clearPixels(width * height * pixelSize, 0);
+		vector<Image*>  images;
 
-		_currentDrawCall->vertexCount += count;
-
-		if (count > polygonVertices.size())
+		for(uint32_t i = 0; i < STREAMING_IMAGE_COUNT; i++)
 		{
-			throw runtime_error("Too much polygons");
+			images.push_back(_bufferAllocator.CreateTextureImage(clearPixels.data(), width, height, pixelSize));
 		}
 
-		double reverseWidth  = 1.0 / _config.GetExtents().width;
-		double reverseHeight = 1.0 / _config.GetExtents().height;
+		Picture *picture = new Picture(width, height, std::move(images));
 
-		for(int i = 0; i < count; i++)
-		{
-			auto& vertex = polygonVertices[i];
+		_drawables.push_back(picture);
+
+		return picture;
+	}
 
-			vertex.pos   += position - _currentPosition;
-			vertex.pos.x *= reverseWidth;
-			vertex.pos.y *= reverseHeight;
+	void Graphics::UpdateStreamingImage(DrawableHandle handle, const void* pixels)
+	{
+		auto drawable = ConvertToDrawable(handle);
 
-			vertex.pos = vertex.pos * 2.0f - 1.0f;
+		if (drawable->GetType() != PictureType || static_cast<Picture*>(drawable)->GetImages().size() != STREAMING_IMAGE_COUNT)
+		{
+			throw runtime_error("Drawable is not a streaming image");
 		}
 
-		_bufferAllocator.WriteToStreamBuffer(_currentDrawCall->streamData, sizeof(Vertex) * count, polygonVertices.data());
+		auto image = static_cast<Picture*>(drawable)->AdvanceImage();
+		auto [width, height, depth] = image->GetExtents();
 
-		_drawablesCache[_drawablesCacheIndex] = _currentDrawCall->drawable;
-		_drawablesCacheIndex = (_drawablesCacheIndex + 1) % _drawablesCache.size();
+		const uint32_t pixelSize = image->GetFormat() == VK_FORMAT_R8_UNORM ? 1 : 4;
+
+		_bufferAllocator.UpdateImageData(image, reinterpret_cast<const uint8_t*>(pixels), width, height, pixelSize);
 	}
 
-	void Graphics::Draw(DrawableHandle drawableHandle, data::position pos, uint32_t width, uint32_t height)
+	DrawableHandle Graphics::CreateVideoImage(uint32_t width, uint32_t height, const VideoFormat& format)
 	{
-		_currentDrawCall = UseDrawCall(drawableHandle);
-
-		array<Vertex, 10> polygonVertices;
+		const uint32_t planeCount = format.semiPlanar ? 2 : 3;
 
-		auto count = _currentDrawCall->drawable->GetPolygon(0, polygonVertices, polygonVertices.size(), width, height);
+		const uint32_t chromaWidth  = (width  + (1 << format.chromaShiftX) - 1) >> format.chromaShiftX;
+		const uint32_t chromaHeight = (height + (1 << format.chromaShiftY) - 1) >> format.chromaShiftY;
 
-		_currentDrawCall->vertexCount += count;
+		// Interleaved chroma of semi planar formats can be larger than luma
+		const uint32_t chromaSize = chromaWidth * chromaHeight * (format.semiPlanar ? 2 : 1);
 
-		if (count > polygonVertices.size())
-		{
-			throw runtime_error("Too much polygons");
-		}
+		// Cleared, so it can be drawn before the first update. Every plane reads from it
+		vector<uint8_t> clearPixels(std::max(width * height, chromaSize), 0);
+		vector<Image*>  images;
 
-		double reverseWidth  = 1.0 / _config.GetExtents().width;
-		double reverseHeight = 1.0 / _config.GetExtents().height;
-
-		for(int i = 0; i < count; i++)
+		for(uint32_t i = 0; i < STREAMING_IMAGE_COUNT; i++)
 		{
-			auto& vertex = polygonVertices[i];
-
-			vertex.pos   += pos - _currentPosition;
-			vertex.pos.x *= reverseWidth;
-			vertex.pos.y *= reverseHeight;
+			images.push_back(_bufferAllocator.CreateTextureImage(clearPixels.data(), width, height, 1));
 
-			vertex.pos = vertex.pos * 2.0f - 1.0f;
+			// Interleaved U and V of semi planar formats take two channels
+			if (format.semiPlanar)
+			{
+				images.push_back(_bufferAllocator.CreateTextureImage(clearPixels.data(), chromaWidth, chromaHeight, 2));
+			}
+			else
+			{
+				images.push_back(_bufferAllocator.CreateTextureImage(clearPixels.data(), chromaWidth, chromaHeight, 1));
+				images.push_back(_bufferAllocator.CreateTextureImage(clearPixels.data(), chromaWidth, chromaHeight, 1));
+			}
 		}
 
-		_bufferAllocator.WriteToStreamBuffer(_currentDrawCall->streamData, sizeof(Vertex) * count, polygonVertices.data());
+		VideoPicture *picture = new VideoPicture(width, height, format, std::move(images), planeCount);
 
-		_drawablesCache[_drawablesCacheIndex] = _currentDrawCall->drawable;
-		_drawablesCacheIndex = (_drawablesCacheIndex + 1) % _drawablesCache.size();
+		_drawables.push_back(picture);
+
+		return picture;
 	}
 
-	void Graphics::FreeDrawable(DrawableHandle drawableHandle)
+	void Graphics::UpdateVideoImage(DrawableHandle handle, std::span<const ImagePlane> planes)
 	{
-		if (_instance == nullptr)
+		auto drawable = ConvertToDrawable(handle);
+
+		if (drawable->GetType() != VideoType)
 		{
-			return;
+			throw runtime_error("Drawable is not a video image");
 		}
 
-		auto iterator = FindDrawable(drawableHandle);
-		auto drawable = *iterator;
-
-		_bufferAllocator.FreeImage(drawable->GetImage());
-
-		_drawables.erase(iterator);
+		auto picture = static_cast<VideoPicture*>(drawable);
 
-		// Remove drawable from cache
-		for(int i = 0; i < _drawablesCache.size(); i++)
+		if (planes.size() != picture->GetPlaneCount())
 		{
-			if (_drawablesCache[i] == drawable)
-			{
-				_drawablesCache[i] = nullptr;
-				break;
-			}
+			throw runtime_error("Video frame has wrong number of planes");
 		}
 
-		delete drawable;
-	}
+		picture->AdvanceFrame();
 
-	void Graphics::SetTilesetPalette(data::Palette& palette)
-	{
-		auto data = reinterpret_cast<const uint8_t*>(palette.GetColors());
+		for(uint32_t i = 0; i < planes.size(); i++)
+		{
+			auto image = picture->GetPlane(i);
+			auto [width, height, depth] = image->GetExtents();
+
+			const uint32_t pixelSize = image->GetFormat() == VK_FORMAT_R8G8_UNORM ? 2 : 1;
 
-		_bufferAllocator.UpdateImageData(_tilesetImage, data, 256, 1, 4);
+			_bufferAllocator.UpdateImageData(image, planes[i].pixels, width, height, pixelSize, planes[i].stride);
+		}
 	}
 
-	void Graphics::SetView(data::position pos)
+	// Tileset::GetPackedCell() in the 16 bits of a tilemap texel
+	uint16_t PackTilemapCell(uint32_t packedCell)
 	{
-		_currentPosition = pos;
+		return static_cast<uint16_t>((packedCell & 0xFFFF) | (packedCell >> 16) << 14);
 	}
-	
-	void Graphics::ClearDescriptorPool()
+
+	DrawableHandle Graphics::CreateTilemap(DrawableHandle tilesetHandle, uint32_t width, uint32_t height)
 	{
-		if (_descriptorSetCount == 0)
-			return;
+		auto tileset = ConvertToDrawable(tilesetHandle);
 
-		if (vkFreeDescriptorSets(_device, _descriptorPool, _descriptorSetCount, _descriptorSets) != VK_SUCCESS)
+		if (tileset->GetType() != TilesetType)
 		{
-			throw runtime_error("Failed to free descriptor sets");
+			throw runtime_error("Tilemap can only be created for a tileset");
 		}
 
-		_descriptorSetCount = 0;
-	}
+		if (static_cast<Tileset*>(tileset)->CellCount > TILEMAP_MAX_CELLS)
+		{
+			throw runtime_error("Tileset has too many cells for a tilemap");
+		}
 
-	void Graphics::BeginRendering()
-	{
-		// Wait for previous frame to be rendered
-		vkWaitForFences(_device, 1, &_fence, VK_TRUE, UINT64_MAX);
-		vkResetFences(_device, 1, &_fence);
+		const int pixelSize = 2;
 
-		vkResetCommandBuffer(_commandBuffer, 0);
+		vector<uint16_t> emptyTiles(width * height, TILEMAP_EMPTY_TILE);
 
-		_bufferAllocator.OnBeginRendering();
+		auto image = _bufferAllocator.CreateTextureImage(emptyTiles.data(), width, height, pixelSize, VK_FORMAT_R16_UINT);
+		auto tilemap = new Tilemap(static_cast<Tileset*>(tileset), image, width, height);
 
-		_drawCalls.clear();
-		_currentDrawCall = nullptr;
+		_drawables.push_back(tilemap);
 
-		ClearDescriptorPool();
+		return tilemap;
 	}
 
-	void Graphics::AllocateDescriptorSets()
+	Tilemap* Graphics::ConvertToTilemap(DrawableHandle tilemapHandle)
 	{
-		if (_drawCalls.size() == 0)
-		{
-			return;
-		}
+		auto drawable = ConvertToDrawable(tilemapHandle);
 
-		// for each drawable allocate descriptor set
-		vector<VkDescriptorSetLayout> layouts;
-
-		layouts.reserve(_drawCalls.size());
-
-		for(int i = 0; i < _drawCalls.size(); i++)
+		if (drawable->GetType() != TilemapType)
 		{
-			auto& drawCall = _drawCalls[i];
-			
-			if (drawCall.drawable->GetType() == PictureType)
-			{
-				layouts.push_back(_samplerLayout);
-			}
-			else
-			{
-				layouts.push_back(_standardLayout);
-			}
+			throw runtime_error("Drawable is not a tilemap");
 		}
 
-		_descriptorSetCount = layouts.size();
+		return static_cast<Tilemap*>(drawable);
+	}
+
+	void Graphics::UpdateTilemap(DrawableHandle tilemapHandle, int left, int top, int width, int height, const data::tileID* tiles, int columnStride)
+	{
+		auto tilemap = ConvertToTilemap(tilemapHandle);
+		auto tileset = tilemap->GetTileset();
 
-		VkDescriptorSetAllocateInfo   allocInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
-		allocInfo.descriptorPool     = _descriptorPool;
-		allocInfo.pSetLayouts        = layouts.data();
-		allocInfo.descriptorSetCount = layouts.size();
+		int windowWidth  = static_cast<int>(tilemap->Width);
+		int windowHeight = static_cast<int>(tilemap->Height);
 
-		if (vkAllocateDescriptorSets(_device, &allocInfo, _descriptorSets) != VK_SUCCESS)
+		if (left < 0 || top < 0 || width > windowWidth || height > windowHeight)
 		{
-			throw runtime_error("Failed to create descriptor pool");
+			throw runtime_error("Tilemap area doesn't fit its window");
 		}
-	}
 
-	void Graphics::WriteDescriptorSets()
-	{
-		for(int i = 0; i < _drawCalls.size(); i++)
+		const int pixelSize = 2;
+
+		// Area wraps around the window, so it's written in up to four parts
+		for(int partTop = top; partTop < top + height;)
 		{
-			auto& drawCall = _drawCalls[i];
+			int windowTop  = partTop % windowHeight;
+			int partHeight = std::min(top + height - partTop, windowHeight - windowTop);
 
-			if (drawCall.drawable->GetType() == PictureType)
+			for(int partLeft = left; partLeft < left + width;)
 			{
-				array<VkWriteDescriptorSet, 1> descriptorWrites{};
+				int windowLeft = partLeft % windowWidth;
+				int partWidth  = std::min(left + width - partLeft, windowWidth - windowLeft);
 
-				VkDescriptorImageInfo textureInfo {
-					.sampler = _textureLinearInterpSampler,
-					.imageView = drawCall.drawable->GetImageView(),
-					.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-				};
+				// Image rows go along x, tiles come in columns
+				vector<uint16_t> cells(partWidth * partHeight, TILEMAP_EMPTY_TILE);
 
-				descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				descriptorWrites[0].dstSet = _descriptorSets[i];
-				descriptorWrites[0].dstBinding = 0;
-				descriptorWrites[0].dstArrayElement = 0;
-				descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-				descriptorWrites[0].descriptorCount = 1;
-				descriptorWrites[0].pImageInfo = &textureInfo;
+				if (tiles != nullptr)
+				{
+					const data::tileID* partTiles = tiles + (partLeft - left) * columnStride + (partTop - top);
 
-				vkUpdateDescriptorSets(_device, descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
-			}
-			else
-			{
-				array<VkWriteDescriptorSet, 2> descriptorWrites{};
+					for(int x = 0; x < partWidth; x++)
+					for(int y = 0; y < partHeight; y++)
+					{
+						cells[x + y * partWidth] = PackTilemapCell(tileset->GetPackedCell(partTiles[x * columnStride + y]));
+					}
+				}
 
-				VkDescriptorImageInfo textureInfo {
-					.sampler = _textureSampler,
-					.imageView = drawCall.drawable->GetImageView(),
-					.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-				};
+				_bufferAllocator.UpdateImageRegion(tilemap->GetImage(), reinterpret_cast<const uint8_t*>(cells.data()), 
+																					 windowLeft, windowTop, partWidth, partHeight, pixelSize);
 
-				descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				descriptorWrites[0].dstSet = _descriptorSets[i];
-				descriptorWrites[0].dstBinding = 0;
-				descriptorWrites[0].dstArrayElement = 0;
-				descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-				descriptorWrites[0].descriptorCount = 1;
-				descriptorWrites[0].pImageInfo = &textureInfo;
+				partLeft += partWidth;
+			}
 
-				VkDescriptorImageInfo paletteInfo {
-					.sampler = _textureSampler,
-					.imageView = _tilesetImage->GetViewHandle(),
-					.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-				};
+			partTop += partHeight;
+		}
+	}
 
-				descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				descriptorWrites[1].dstSet = _descriptorSets[i];
-				descriptorWrites[1].dstBinding = 1;
-				descriptorWrites[1].dstArrayElement = 0;
-				descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-				descriptorWrites[1].descriptorCount = 1;
-				descriptorWrites[1].pImageInfo = &paletteInfo;
+	void Graphics::SetTilemapView(DrawableHandle tilemapHandle, int left, int top, int width, int height)
+	{
+		auto tilemap = ConvertToTilemap(tilemapHandle);
 
-				vkUpdateDescriptorSets(_device, descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
-			}
+		if (left < 0 || top < 0 || width > static_cast<int>(tilemap->Width) || height > static_cast<int>(tilemap->Height))
+		{
+			throw runtime_error("Tilemap view doesn't fit its window");
 		}
+
+		tilemap->SetView(left, top, width, height);
 	}
 
-	void Graphics::PresentToScreen()
+	void Graphics::CreateFrameTable(A_VulkanDrawable* drawable)
 	{
-		_bufferAllocator.OnPrepareForPresentation();
+		auto table = drawable->BuildFrameTable();
 
-		AllocateDescriptorSets();
-		WriteDescriptorSets();
+		// Instances address rows with 16 bits, bigger drawables stay on the vertex path
+		if (table.empty() || table.size() > UINT16_MAX + 1)
+		{
+			return;
+		}
 
-		// ==============================================
-		VkCommandBufferBeginInfo beginInfo { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+		drawable->SetFrameTable(_bufferAllocator.CreateStorageBuffer(table.data(), table.size() * sizeof(FrameRect)));
+	}
 
-		beginInfo.flags = 0;
-		beginInfo.pInheritanceInfo = nullptr;
+	// Modes of atlas_shader.frag, specialized per pipeline
+	enum class SpriteDrawMode : uint32_t
+	{
+		Normal, Shadow, Cloaked, Remap, Hallucination
+	};
+
+	SpriteDrawMode TakeSpriteDrawMode(data::DrawFunction function)
+	{
+		using data::DrawFunction;
 
-		if (vkBeginCommandBuffer(_commandBuffer, &beginInfo) != VK_SUCCESS)
+		switch(function)
 		{
-			throw runtime_error("Failed to begin recording command buffer");
+			case DrawFunction::NonVisionCloaking:
+			case DrawFunction::NonVisionCloaked:
+			case DrawFunction::NonVisionDecloaking:
+			case DrawFunction::VisionCloaking:
+			case DrawFunction::VisionCloaked:
+			case DrawFunction::VisionDecloaking:
+				return SpriteDrawMode::Cloaked;
+			case DrawFunction::Remapping:
+				return SpriteDrawMode::Remap;
+			case DrawFunction::Shadow:
+				return SpriteDrawMode::Shadow;
+			case DrawFunction::Hallucination:
+				return SpriteDrawMode::Hallucination;
+			default:
+				return SpriteDrawMode::Normal;
 		}
+	}
 
-		// Start render pass
-		VkRenderPassBeginInfo renderBeginInfo { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+	// Draw functions of one mode share the pipeline
+	uint32_t TakeSpriteVariantKey(SpriteDrawMode mode, uint32_t remapRow, bool instanced, bool indexed)
+	{
+		return static_cast<uint32_t>(mode) | remapRow << 8 | uint32_t(instanced) << 16 | uint32_t(indexed) << 17;
+	}
 
-		_currentImageIndex = _swapchain.GetNextImageIndex(_imageAvailableSemaphore);
+	// Layer is the most significant field of the sort key, order of calls the rest
+	const uint32_t SORT_LAYER_SHIFT = 56;
 
-		renderBeginInfo.renderPass = _renderPass;
-		renderBeginInfo.framebuffer = _swapchain.GetFrameBuffer(_currentImageIndex);
-		renderBeginInfo.renderArea.offset = {0, 0};
-		renderBeginInfo.renderArea.extent = _config.GetExtents();
+	DrawCall* Graphics::UseDrawCall(DrawableHandle drawableHandle, bool instanced, uint32_t width, uint32_t height)
+	{
+		// Break into another draw call
+		if (_currentDrawCall == nullptr || drawableHandle != _currentDrawCall->drawable || instanced != _currentDrawCall->instanced
+			|| width != _currentDrawCall->width || height != _currentDrawCall->height)
+		{
+			// Validate new drawable
+			auto drawable = ConvertToDrawable(drawableHandle);
 
-		VkClearValue clearColor = {{{0, 0, 0, 1}}};
-		renderBeginInfo.clearValueCount = 1;
-		renderBeginInfo.pClearValues = &clearColor;
+			bool indexed = DrawsIndices(drawable);
 
-		vkCmdBeginRenderPass(_commandBuffer, &renderBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			DrawCall drawCall { .drawable = drawable, .instanced = instanced, .indexed = indexed, .shaderIndex = TakeShaderIndex(drawable, instanced, indexed) };
 
-		// Prepare viewport
+			// Draws overlap inside a layer, state never outranks the order they were made in
+			drawCall.sortKey = uint64_t(_layer) << SORT_LAYER_SHIFT | _drawCalls.size();
 
-		auto [width, height] = _config.GetExtents();
+			drawCall.firstItem = _drawItems.size();
+			drawCall.width     = width;
+			drawCall.height    = height;
 
-		VkViewport viewport { 
-			0.0, 0.0, 
-			static_cast<float>(width), static_cast<float>(height), 
-			0.0f, 1.0f};
+			_drawCalls.push_back(drawCall);
 
-		vkCmdSetViewport(_commandBuffer, 0, 1, &viewport);
+			return &_drawCalls.back();
+		}
 
-		VkRect2D scissor { 
-			0, 0,
-			_config.GetExtents() };
+		return _currentDrawCall;
+	}
 
-		vkCmdSetScissor(_commandBuffer, 0, 1, &scissor);
+	bool Graphics::DrawsIndices(A_VulkanDrawable* drawable) const
+	{
+		if (!_indexedRendering)
+		{
+			return false;
+		}
 
-		// ==============================================
-		//   Draw
+		auto type = drawable->GetType();
 
-		for(int i = 0; i < _drawCalls.size(); i++)
+		// Colors that aren't in the palette or blend with what is below
+		if (type == PictureType || type == VideoType)
+		{
+			return false;
+		}
+		else if (type == SpriteSheetType)
 		{
-			auto& drawCall = _drawCalls[i];
+			auto mode = TakeSpriteDrawMode(_drawStyle.function);
 
-			VkPipeline pipeline;
-			VkPipelineLayout pipelineLayout;
+			return mode == SpriteDrawMode::Normal || mode == SpriteDrawMode::Remap;
+		}
+
+		return true;
+	}
+
+	uint32_t Graphics::TakeShaderIndex(A_VulkanDrawable* drawable, bool instanced, bool indexed)
+	{
+		if (drawable->GetType() == PictureType)
+		{
+			return _textureShaderIndex;
+		}
+		else if (drawable->GetType() == SpriteSheetType)
+		{
+			return TakeSpriteShaderIndex(instanced, indexed);
+		}
+		else if (instanced)
+		{
+			return indexed ? _instancedIndexShaderIndex : _instancedShaderIndex;
+		}
+		else if (drawable->GetType() == TilemapType)
+		{
+			return indexed ? _tilemapIndexShaderIndex : _tilemapShaderIndex;
+		}
+		else if (drawable->GetType() == VideoType)
+		{
+			return _videoShaderIndex;
+		}
+
+		return indexed ? _mainIndexShaderIndex : _mainShaderIndex;
+	}
+
+	uint32_t Graphics::TakeSpriteShaderIndex(bool instanced, bool indexed)
+	{
+		auto mode     = TakeSpriteDrawMode(_drawStyle.function);
+		auto remapRow = static_cast<uint32_t>(_drawStyle.remap);
+
+		// Row 0 holds colors, not a remap
+		if (mode == SpriteDrawMode::Remap && (remapRow == 0 || remapRow >= data::PALETTE_REMAP_COUNT))
+			mode = SpriteDrawMode::Normal;
+
+		if (mode == SpriteDrawMode::Normal && !indexed)
+			return instanced ? _atlasInstancedShaderIndex : _atlasShaderIndex;
+
+		if (mode != SpriteDrawMode::Remap)
+			remapRow = 0;
+
+		return _spriteShaderVariants.at(TakeSpriteVariantKey(mode, remapRow, instanced, indexed));
+	}
+
+	void Graphics::CreateSpriteShaderVariants()
+	{
+		const array<SpriteDrawMode, 5> modes = {
+			SpriteDrawMode::Normal, SpriteDrawMode::Shadow, SpriteDrawMode::Cloaked, SpriteDrawMode::Remap, SpriteDrawMode::Hallucination
+		};
+
+		for(bool indexed : { false, true })
+		for(bool instanced : { false, true })
+		for(auto mode : modes)
+		{
+			if (indexed && !_indexedRendering)
+				continue;
+
+			// Normal sprites of the swapchain pass have pipelines of their own,
+			//  styles blending colors never write indices
+			if (mode == SpriteDrawMode::Normal ? !indexed : indexed && mode != SpriteDrawMode::Remap)
+				continue;
+
+			uint32_t firstRow = mode == SpriteDrawMode::Remap ? 1 : 0;
+			uint32_t lastRow  = mode == SpriteDrawMode::Remap ? data::PALETTE_REMAP_COUNT : 1;
+
+			for(uint32_t remapRow = firstRow; remapRow < lastRow; remapRow++)
+			{
+				array<uint32_t, 3> specialization = { static_cast<uint32_t>(mode), remapRow, uint32_t(indexed) };
+
+				auto format     = indexed ? VK_FORMAT_R8_UNORM : _swapchain.GetFormat();
+				auto renderPass = indexed ? &_indexRenderPass : nullptr;
+
+				// Driver finds pipelines compiled by earlier runs in the pipeline cache
+				_spriteShaderVariants[TakeSpriteVariantKey(mode, remapRow, instanced, indexed)] = instanced
+					? _shaders.CreateShader(_atlasInstancedModules.data(), _atlasInstancedModules.size(), format, &_instancedLayout,
+																	VertexLayout::PerInstance, sizeof(InstanceConstants), VK_SHADER_STAGE_VERTEX_BIT, specialization, renderPass)
+					: _shaders.CreateShader(_atlasModules.data(), _atlasModules.size(), format, &_standardLayout,
+																	VertexLayout::PerVertex, 0, VK_SHADER_STAGE_VERTEX_BIT, specialization, renderPass);
+			}
+		}
+	}
+
+	bool Graphics::CanDrawInstanced(DrawableHandle drawableHandle)
+	{
+		if (!_instancingEnabled)
+		{
+			return false;
+		}
+
+		// Drawable of the current call is validated already
+		if (_currentDrawCall != nullptr && drawableHandle == _currentDrawCall->drawable)
+		{
+			return _currentDrawCall->instanced;
+		}
+
+		return ConvertToDrawable(drawableHandle)->GetFrameTable() != nullptr;
+	}
+
+	void Graphics::Draw(DrawableHandle drawableHandle, frameIndex frame, data::position position)
+	{
+		DrawItem item { position, frame };
+
+		DrawBatch(drawableHandle, { &item, 1 });
+	}
+
+	void Graphics::DrawBatch(DrawableHandle drawableHandle, std::span<const DrawItem> items)
+	{
+		if (items.empty())
+		{
+			return;
+		}
+
+		bool instanced = CanDrawInstanced(drawableHandle);
+
+		_currentDrawCall = UseDrawCall(drawableHandle, instanced);
+
+		// Written to the stream buffer once calls are sorted, view might change before
+		for(auto& item : items)
+		{
+			_drawItems.push_back({ item.pos - _currentPosition, item.frame, item.flip });
+		}
+
+		_currentDrawCall->itemCount += items.size();
+
+		_drawablesCache[_drawablesCacheIndex] = _currentDrawCall->drawable;
+		_drawablesCacheIndex = (_drawablesCacheIndex + 1) % _drawablesCache.size();
+	}
+
+	void Graphics::WriteInstances(RenderBatch& batch, A_VulkanDrawable* drawable, std::span<const DrawItem> items)
+	{
+		auto output = reinterpret_cast<InstanceData*>(
+			_bufferAllocator.ReserveStreamBuffer(batch.streamData, items.size() * sizeof(InstanceData)));
+
+		// Frames are looked up in chunks so the mapped memory is written only once
+		array<uint32_t, 256> frames;
+
+		for(std::size_t first = 0; first < items.size(); first += frames.size())
+		{
+			auto chunk = items.subspan(first, std::min(frames.size(), items.size() - first));
+
+			drawable->GetInstanceFrames(chunk, frames.data());
+
+			for(std::size_t i = 0; i < chunk.size(); i++)
+			{
+				frames[i] |= static_cast<uint32_t>(chunk[i].flip) << INSTANCE_MIRROR_SHIFT;
+			}
+
+			// Items are relative to the view already
+			TransformInstances(chunk, frames.data(), data::position(0, 0), output + first);
+		}
+
+		batch.instanceCount += items.size();
+	}
+
+	void Graphics::WriteQuads(RenderBatch& batch, A_VulkanDrawable* drawable, std::span<const DrawItem> items, uint32_t width, uint32_t height)
+	{
+		const uint32_t quadVertexCount = 6;
+
+		auto output = reinterpret_cast<Vertex*>(
+			_bufferAllocator.ReserveStreamBuffer(batch.streamData, items.size() * quadVertexCount * sizeof(Vertex)));
+
+		vec2 inverseExtent = { 1.0f / _config.GetExtents().width, 1.0f / _config.GetExtents().height };
+
+		array<Vertex, 10> polygonVertices;
+
+		for(auto& item : items)
+		{
+			auto count = drawable->GetPolygon(item.frame, polygonVertices, polygonVertices.size(), width, height);
+
+			if (count != quadVertexCount)
+			{
+				throw runtime_error("Only quads can be drawn in batches");
+			}
+
+			// Quads aren't culled, mirrored positions keep their texture coordinates
+			for(std::size_t i = 0; i < count; i++)
+			{
+				if (item.flip & data::FlipHorizontally)
+					polygonVertices[i].pos.x = -polygonVertices[i].pos.x;
+
+				if (item.flip & data::FlipVertically)
+					polygonVertices[i].pos.y = -polygonVertices[i].pos.y;
+			}
+
+			TransformVertices(polygonVertices.data(), output, count, vec2(item.pos), inverseExtent);
+
+			output += count;
+		}
+
+		batch.vertexCount += items.size() * quadVertexCount;
+	}
+
+	void Graphics::Draw(DrawableHandle drawableHandle, data::position pos, uint32_t width, uint32_t height)
+	{
+		_currentDrawCall = UseDrawCall(drawableHandle, false, width, height);
+
+		_drawItems.push_back({ pos - _currentPosition, 0 });
+
+		_currentDrawCall->itemCount++;
+
+		_drawablesCache[_drawablesCacheIndex] = _currentDrawCall->drawable;
+		_drawablesCacheIndex = (_drawablesCacheIndex + 1) % _drawablesCache.size();
+	}
+
+	void Graphics::FreeDrawable(DrawableHandle drawableHandle)
+	{
+		if (_instance == nullptr)
+		{
+			return;
+		}
+
+		auto iterator = FindDrawable(drawableHandle);
+		auto drawable = *iterator;
+
+		_drawables.erase(iterator);
+
+		// Remove drawable from cache
+		for(int i = 0; i < _drawablesCache.size(); i++)
+		{
+			if (_drawablesCache[i] == drawable)
+			{
+				_drawablesCache[i] = nullptr;
+				break;
+			}
+		}
+
+		// Frames in flight might still sample it, destroyed when this frame's slot is reused
+		_frames[_frameIndex].retiredDrawables.push_back(drawable);
+	}
+
+	void Graphics::DestroyDrawable(A_VulkanDrawable* drawable)
+	{
+		if (drawable->GetType() == SpriteSheetType)
+		{
+			// Image and frame table are the atlas ones, only the space is given back
+			_spriteAtlas.Free(static_cast<SpriteSheet*>(drawable)->GetPlacement());
+		}
+		else
+		{
+			for(auto image : drawable->GetImages())
+			{
+				_bufferAllocator.FreeImage(image);
+			}
+
+			if (drawable->GetFrameTable() != nullptr)
+			{
+				_bufferAllocator.FreeBuffer(drawable->GetFrameTable());
+			}
+		}
+
+		if (auto it = _descriptorSets.find(drawable); it != _descriptorSets.end())
+		{
+			for(auto& cached : it->second)
+			{
+				if (cached.set != VK_NULL_HANDLE)
+					vkFreeDescriptorSets(_device, cached.pool, 1, &cached.set);
+			}
+
+			_descriptorSets.erase(it);
+		}
+
+		delete drawable;
+	}
+
+	uint64_t Graphics::GetMemorySize(DrawableHandle drawableHandle)
+	{
+		auto drawable = ConvertToDrawable(drawableHandle);
+
+		uint64_t size = 0;
+
+		if (drawable->GetType() == SpriteSheetType)
+		{
+			for(auto& spriteData : static_cast<SpriteSheet*>(drawable)->GetPlacement().spriteDataList)
+			{
+				size += spriteData.dimensions.x * spriteData.dimensions.y;
+			}
+
+			return size;
+		}
+
+		for(auto image : drawable->GetImages())
+		{
+			size += image->GetSize();
+		}
+
+		return size;
+	}
+
+	void Graphics::SetTilesetPalette(data::Palette& palette)
+	{
+		// Called every frame, the palette only changes with the map
+		if (_tilesetPaletteValid && memcmp(_tilesetPalette.data(), palette.GetColors(), sizeof(_tilesetPalette)) == 0)
+			return;
+
+		memcpy(_tilesetPalette.data(), palette.GetColors(), sizeof(_tilesetPalette));
+		_tilesetPaletteValid = true;
+
+		UploadPalette();
+	}
+
+	void Graphics::SetPaletteCycles(std::span<const PaletteCycle> cycles)
+	{
+		if (cycles.size() > PALETTE_CYCLE_MAX)
+		{
+			throw runtime_error("Too many palette cycles");
+		}
+
+		std::array<PaletteCycle, PALETTE_CYCLE_MAX> next {};
+
+		for(uint32_t i = 0; i < cycles.size(); i++)
+		{
+			if (cycles[i].first + cycles[i].count > data::PALETTE_SIZE)
+			{
+				throw runtime_error("Palette cycle is out of the palette");
+			}
+
+			if (cycles[i].count > 0 && cycles[i].period == 0)
+			{
+				throw runtime_error("Palette cycle has no period");
+			}
+
+			next[i] = cycles[i];
+		}
+
+		if (next == _paletteCycles)
+			return;
+
+		_paletteCycles = next;
+
+		// Resolve pass takes them as push constants
+		if (!_indexedRendering && _tilesetPaletteValid)
+			UploadPalette();
+	}
+
+	void Graphics::SetPaletteTick(uint32_t tick)
+	{
+		_paletteTick = tick;
+
+		// Most ticks move no cycle, the palette is uploaded only when one does
+		if (!_indexedRendering && _tilesetPaletteValid && TakePaletteShifts() != _uploadedShifts)
+			UploadPalette();
+	}
+
+	std::array<uint32_t, PALETTE_CYCLE_MAX> Graphics::TakePaletteShifts() const
+	{
+		std::array<uint32_t, PALETTE_CYCLE_MAX> shifts {};
+
+		for(uint32_t i = 0; i < PALETTE_CYCLE_MAX; i++)
+		{
+			auto& cycle = _paletteCycles[i];
+
+			if (cycle.count > 0)
+				shifts[i] = _paletteTick / cycle.period % cycle.count;
+		}
+
+		return shifts;
+	}
+
+	void Graphics::UploadPalette()
+	{
+		auto colors = _tilesetPalette;
+
+		if (!_indexedRendering)
+		{
+			_uploadedShifts = TakePaletteShifts();
+
+			for(uint32_t cycle = 0; cycle < PALETTE_CYCLE_MAX; cycle++)
+			{
+				auto [first, count, period] = _paletteCycles[cycle];
+				auto shift = _uploadedShifts[cycle];
+
+				for(uint32_t i = 0; i < count; i++)
+				{
+					colors[first + i] = _tilesetPalette[first + (i + count - shift) % count];
+				}
+			}
+		}
+
+		_bufferAllocator.UpdateImageRegion(_tilesetImage, reinterpret_cast<const uint8_t*>(colors.data()), 0, 0, data::PALETTE_SIZE, 1, 4);
+	}
+
+	void Graphics::SetPaletteRemap(data::PaletteRemap remap, std::span<const uint8_t, data::PALETTE_SIZE> indices)
+	{
+		auto row = static_cast<uint32_t>(remap);
+
+		if (row == 0 || row >= PALETTE_IMAGE_ROWS)
+		{
+			throw runtime_error("Palette remap has no row in the palette image");
+		}
+
+		// Index is read from red, like the index of a frame pixel
+		std::array<data::Color, data::PALETTE_SIZE> pixels;
+
+		for(uint32_t i = 0; i < pixels.size(); i++)
+		{
+			pixels[i] = { indices[i], 0, 0, 0xFF };
+		}
+
+		_bufferAllocator.UpdateImageRegion(_tilesetImage, reinterpret_cast<const uint8_t*>(pixels.data()), 0, row, data::PALETTE_SIZE, 1, 4);
+	}
+
+	void Graphics::SetDrawStyle(const DrawStyle& style)
+	{
+		if (style == _drawStyle)
+			return;
+
+		_drawStyle = style;
+
+		_currentDrawCall = nullptr;
+	}
+
+	void Graphics::EnableInstancing(bool enabled)
+	{
+		_instancingEnabled = enabled;
+
+		// Calls made so far keep their mode
+		_currentDrawCall = nullptr;
+	}
+
+	void Graphics::SetView(data::position pos)
+	{
+		_currentPosition = pos;
+	}
+
+	void Graphics::SetLayer(uint8_t layer)
+	{
+		_layer = layer;
+
+		_currentDrawCall = nullptr;
+	}
+	
+	void Graphics::BeginRendering()
+	{
+		_frameIndex = (_frameIndex + 1) % FRAMES_IN_FLIGHT;
+
+		auto& frame = _frames[_frameIndex];
+
+		// Wait until GPU is done with the frame that used this slot,
+		//  frames recorded after it might still be in flight
+		vkWaitForFences(_device, 1, &frame.fence, VK_TRUE, UINT64_MAX);
+		vkResetFences(_device, 1, &frame.fence);
+
+		vkResetCommandBuffer(frame.commandBuffer, 0);
+
+		for(auto drawable : frame.retiredDrawables)
+		{
+			DestroyDrawable(drawable);
+		}
+
+		frame.retiredDrawables.clear();
+
+		_bufferAllocator.OnBeginRendering(_frameIndex);
+		_spriteAtlas.BeginFrame();
+
+		Defragment();
+
+		_drawCalls.clear();
+		_drawItems.clear();
+		_currentDrawCall = nullptr;
+		_layer = 0;
+		_drawStyle = {};
+	}
+
+	// Spent on moving images every frame while memory is being compacted
+	const std::chrono::microseconds DEFRAGMENT_TIME_BUDGET(500);
+	const VkDeviceSize              DEFRAGMENT_BYTE_BUDGET = 4 * 1024 * 1024;
+
+	void Graphics::Defragment()
+	{
+		if (!_defragmenting)
+		{
+			_reservedBeforeDefragment = _memoryManager.GetReservedSize();
+			_usedBeforeDefragment     = _memoryManager.GetUsedSize();
+		}
+
+		bool defragmenting = _bufferAllocator.Defragment(DEFRAGMENT_TIME_BUDGET, DEFRAGMENT_BYTE_BUDGET);
+
+		if (_defragmenting && !defragmenting)
+		{
+			const double megabyte = 1024.0 * 1024.0;
+
+			std::cout << "  Vulkan API: memory compacted, committed " << _reservedBeforeDefragment / megabyte << " MB -> "
+								<< _memoryManager.GetReservedSize() / megabyte << " MB, used " << _usedBeforeDefragment / megabyte << " MB -> "
+								<< _memoryManager.GetUsedSize() / megabyte << " MB" << std::endl;
+		}
+
+		_defragmenting = defragmenting;
+	}
+
+	VkDescriptorSetLayout Graphics::TakeDescriptorSetLayout(const RenderBatch& batch)
+	{
+		if (batch.drawable->GetType() == PictureType)
+		{
+			return _samplerLayout;
+		}
+		else if (batch.instanced)
+		{
+			return _instancedLayout;
+		}
+		else if (batch.drawable->GetType() == TilemapType)
+		{
+			return _tilemapLayout;
+		}
+		else if (batch.drawable->GetType() == VideoType)
+		{
+			return _videoLayout;
+		}
+
+		return _standardLayout;
+	}
+
+	DescriptorBindings Graphics::TakeDescriptorBindings(const RenderBatch& batch)
+	{
+		DescriptorBindings bindings;
+
+		auto type = batch.drawable->GetType();
+
+		if (type == PictureType)
+		{
+			bindings.views[0] = batch.drawable->GetImageView();
+		}
+		else if (type == VideoType)
+		{
+			auto picture = static_cast<VideoPicture*>(batch.drawable);
 
-			if (drawCall.drawable->GetType() == PictureType)
+			for(uint32_t plane = 0; plane < bindings.views.size(); plane++)
 			{
-				pipeline = _shaders.GetShaderPipeline(_textureShaderIndex);
-				pipelineLayout = _shaders.GetShaderPipelineLayout(_textureShaderIndex);
+				bindings.views[plane] = picture->GetPlane(plane)->GetViewHandle();
 			}
-			else
+		}
+		else
+		{
+			bool isTilemap = type == TilemapType;
+
+			// Tilemap samples cells from its tileset
+			bindings.views[0] = isTilemap ? static_cast<Tilemap*>(batch.drawable)->GetTileset()->GetImageView() : batch.drawable->GetImageView();
+			bindings.views[1] = _tilesetImage->GetViewHandle();
+
+			if (isTilemap)
+			{
+				bindings.views[2] = batch.drawable->GetImageView();
+			}
+
+			if (batch.instanced)
+			{
+				bindings.buffer = batch.drawable->GetFrameTable()->GetHandle();
+			}
+		}
+
+		return bindings;
+	}
+
+	VkDescriptorPool Graphics::CreateDescriptorPool()
+	{
+		const VkAllocationCallbacks* allocator = nullptr;
+		const uint32_t MAX_SETS = POOL_MAX_SETS;
+
+		// Tilemap sets take three samplers
+		array<VkDescriptorPoolSize, 2> poolSizes {
+			VkDescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_SETS * 3),
+			VkDescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_SETS),
+		};
+
+		VkDescriptorPoolCreateInfo poolInfo { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+
+		poolInfo.poolSizeCount = poolSizes.size();
+		poolInfo.pPoolSizes    = poolSizes.data();
+		poolInfo.maxSets       = MAX_SETS;
+		poolInfo.flags         = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+
+		VkDescriptorPool pool;
+
+		if (vkCreateDescriptorPool(_device, &poolInfo, allocator, &pool) != VK_SUCCESS)
+		{
+			throw runtime_error("Failed to create descriptor pool");
+		}
+
+		_descriptorPools.push_back(pool);
+
+		return pool;
+	}
+
+	VkSampler Graphics::TakeSampler(const RenderBatch& batch)
+	{
+		auto type = batch.drawable->GetType();
+
+		// Pictures are scaled and video chroma is upsampled by linear filtering
+		return type == PictureType || type == VideoType ? _textureLinearInterpSampler : _textureSampler;
+	}
+
+	void Graphics::AllocateDescriptorSet(VkDescriptorSetLayout layout, CachedDescriptorSet& cached)
+	{
+		VkDescriptorSetAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts        = &layout;
+
+		// Sets live as long as their drawable, pools are added when the last one is full
+		allocInfo.descriptorPool = _descriptorPools.back();
+
+		VkResult result = vkAllocateDescriptorSets(_device, &allocInfo, &cached.set);
+
+		if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+		{
+			allocInfo.descriptorPool = CreateDescriptorPool();
+
+			result = vkAllocateDescriptorSets(_device, &allocInfo, &cached.set);
+		}
+
+		if (result != VK_SUCCESS)
+		{
+			throw runtime_error("Failed to allocate descriptor set");
+		}
+
+		cached.pool     = allocInfo.descriptorPool;
+		cached.bindings = {};
+	}
+
+	void Graphics::WriteDescriptorSet(VkDescriptorSet set, const DescriptorBindings& bindings, VkSampler sampler)
+	{
+		array<VkWriteDescriptorSet, 3>  descriptorWrites{};
+		array<VkDescriptorImageInfo, 3> imageInfos{};
+		VkDescriptorBufferInfo          bufferInfo{};
+		uint32_t                        writeCount = 0;
+
+		for(uint32_t binding = 0; binding < bindings.views.size(); binding++)
+		{
+			if (bindings.views[binding] == VK_NULL_HANDLE)
+				continue;
+
+			imageInfos[binding] = {
+				.sampler = sampler,
+				.imageView = bindings.views[binding],
+				.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			};
+
+			auto& write = descriptorWrites[writeCount++];
+
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = set;
+			write.dstBinding = binding;
+			write.dstArrayElement = 0;
+			write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			write.descriptorCount = 1;
+			write.pImageInfo = &imageInfos[binding];
+		}
+
+		// Frame table takes the binding tilemaps use for cells
+		if (bindings.buffer != VK_NULL_HANDLE)
+		{
+			bufferInfo.buffer = bindings.buffer;
+			bufferInfo.offset = 0;
+			bufferInfo.range  = VK_WHOLE_SIZE;
+
+			auto& write = descriptorWrites[writeCount++];
+
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = set;
+			write.dstBinding = 2;
+			write.dstArrayElement = 0;
+			write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			write.descriptorCount = 1;
+			write.pBufferInfo = &bufferInfo;
+		}
+
+		vkUpdateDescriptorSets(_device, writeCount, descriptorWrites.data(), 0, nullptr);
+	}
+
+	void Graphics::UpdateDescriptorSets()
+	{
+		auto& frame = _frames[_frameIndex];
+
+		frame.descriptorSets.clear();
+
+		for(auto& batch : _renderBatches)
+		{
+			// GPU is done with sets of this frame slot, they can be rewritten
+			auto& cached   = _descriptorSets[batch.drawable][_frameIndex * 2 + batch.instanced];
+			auto  bindings = TakeDescriptorBindings(batch);
+
+			if (cached.set == VK_NULL_HANDLE)
+			{
+				AllocateDescriptorSet(TakeDescriptorSetLayout(batch), cached);
+			}
+
+			// Streamed frames and compacted images change views, most frames nothing changes
+			if (cached.bindings != bindings)
+			{
+				WriteDescriptorSet(cached.set, bindings, TakeSampler(batch));
+
+				cached.bindings = bindings;
+			}
+
+			frame.descriptorSets.push_back(cached.set);
+		}
+
+		if (_indexedRendering)
+		{
+			auto& cached = _resolveSets[_frameIndex];
+
+			// Palette image is moved by compaction like any other
+			DescriptorBindings bindings;
+			bindings.views[0] = _indexTarget->GetViewHandle();
+			bindings.views[1] = _tilesetImage->GetViewHandle();
+
+			if (cached.set == VK_NULL_HANDLE)
+			{
+				AllocateDescriptorSet(_standardLayout, cached);
+			}
+
+			if (cached.bindings != bindings)
+			{
+				WriteDescriptorSet(cached.set, bindings, _textureSampler);
+
+				cached.bindings = bindings;
+			}
+		}
+	}
+
+	void Graphics::BuildRenderBatches()
+	{
+		_renderBatches.clear();
+		_currentDrawCall = nullptr;
+
+		// Only layers move calls, inside one they keep their order
+		std::sort(_drawCalls.begin(), _drawCalls.end(), [] (const DrawCall& a, const DrawCall& b) {
+			return a.sortKey < b.sortKey;
+		});
+
+		// Missing frames of every sheet are packed together before any is written
+		for(auto& drawCall : _drawCalls)
+		{
+			if (drawCall.drawable->GetType() == SpriteSheetType)
+			{
+				auto items = std::span(_drawItems).subspan(drawCall.firstItem, drawCall.itemCount);
+
+				_spriteAtlas.Request(static_cast<SpriteSheet*>(drawCall.drawable)->GetPlacement(), items);
+			}
+		}
+
+		_spriteAtlas.Resolve();
+
+		for(auto& drawCall : _drawCalls)
+		{
+			// Neighbours of one state and mode share every binding, their items go one after another
+			if (_renderBatches.empty() || _renderBatches.back().drawable->GetStateKey() != drawCall.drawable->GetStateKey()
+				|| _renderBatches.back().instanced != drawCall.instanced || _renderBatches.back().shaderIndex != drawCall.shaderIndex)
 			{
-				pipeline = _shaders.GetShaderPipeline(_mainShaderIndex);
-				pipelineLayout = _shaders.GetShaderPipelineLayout(_mainShaderIndex);
+				_renderBatches.push_back({
+					.drawable = drawCall.drawable,
+					.shaderIndex = drawCall.shaderIndex,
+					.instanced = drawCall.instanced,
+					.indexed = drawCall.indexed,
+				});
 			}
 
-			drawCall.streamData.BindToCommandBuffer(_commandBuffer);
+			auto& batch = _renderBatches.back();
+			auto  items = std::span(_drawItems).subspan(drawCall.firstItem, drawCall.itemCount);
 
-			vkCmdBindPipeline(_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-			vkCmdBindDescriptorSets(_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, 
-															pipelineLayout, 0, 1, &_descriptorSets[i], 0, VK_NULL_HANDLE);
-			vkCmdDraw(_commandBuffer, drawCall.vertexCount, 1, 0, 0);
+			if (drawCall.instanced)
+			{
+				WriteInstances(batch, drawCall.drawable, items);
+			}
+			else
+			{
+				WriteQuads(batch, drawCall.drawable, items, drawCall.width, drawCall.height);
+			}
 		}
 
+		// Rows of frames uploaded or evicted above, submitted ahead of the frame
+		_spriteAtlas.Commit();
+
+		_statistics = {
+			.drawCalls = static_cast<uint32_t>(_drawCalls.size()),
+			.recordedDraws = static_cast<uint32_t>(_renderBatches.size()),
+			.sprites = _spriteAtlas.GetResidency(),
+		};
+	}
+
+	void Graphics::PresentToScreen()
+	{
+		auto& frame = _frames[_frameIndex];
+
+		BuildRenderBatches();
+		UpdateDescriptorSets();
+
 		// ==============================================
+		VkCommandBufferBeginInfo beginInfo { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+
+		beginInfo.flags = 0;
+		beginInfo.pInheritanceInfo = nullptr;
+
+		if (vkBeginCommandBuffer(frame.commandBuffer, &beginInfo) != VK_SUCCESS)
+		{
+			throw runtime_error("Failed to begin recording command buffer");
+		}
+
+		auto [width, height] = _config.GetExtents();
+
+		// Viewport and scissor are dynamic state of the command buffer, every pass keeps them
+		VkViewport viewport { 
+			0.0, 0.0, 
+			static_cast<float>(width), static_cast<float>(height), 
+			0.0f, 1.0f};
+
+		vkCmdSetViewport(frame.commandBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor { 
+			0, 0,
+			_config.GetExtents() };
+
+		vkCmdSetScissor(frame.commandBuffer, 0, 1, &scissor);
+
+		_currentImageIndex = _swapchain.GetNextImageIndex(frame.imageAvailableSemaphore);
+
+		// Every part is a run of indexed batches and the blended ones after it. Indices
+		//  are resolved before the blended batches, so they keep their place in the order
+		std::size_t partStart = 0;
+
+		do
+		{
+			std::size_t partMiddle = partStart;
+
+			while (partMiddle < _renderBatches.size() && _renderBatches[partMiddle].indexed)
+				partMiddle++;
+
+			std::size_t partEnd = partMiddle;
+
+			while (partEnd < _renderBatches.size() && !_renderBatches[partEnd].indexed)
+				partEnd++;
+
+			bool firstPart = partStart == 0;
+
+			if (partMiddle > partStart)
+			{
+				VkRenderPassBeginInfo indexBeginInfo { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+
+				// Index 0 is resolved as transparent, previous parts are already in the swapchain image
+				VkClearValue clearIndex = {{{0, 0, 0, 0}}};
+
+				indexBeginInfo.renderPass = _indexRenderPass;
+				indexBeginInfo.framebuffer = *_indexFramebuffer;
+				indexBeginInfo.renderArea.offset = {0, 0};
+				indexBeginInfo.renderArea.extent = _config.GetExtents();
+				indexBeginInfo.clearValueCount = 1;
+				indexBeginInfo.pClearValues = &clearIndex;
+
+				vkCmdBeginRenderPass(frame.commandBuffer, &indexBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+				RecordBatches(frame.commandBuffer, partStart, partMiddle);
+
+				vkCmdEndRenderPass(frame.commandBuffer);
+			}
+
+			// Start render pass, later parts draw over the first one
+			VkRenderPassBeginInfo renderBeginInfo { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
 
-		vkCmdEndRenderPass(_commandBuffer);
+			renderBeginInfo.renderPass = firstPart ? _renderPass : _loadRenderPass;
+			renderBeginInfo.framebuffer = _swapchain.GetFrameBuffer(_currentImageIndex);
+			renderBeginInfo.renderArea.offset = {0, 0};
+			renderBeginInfo.renderArea.extent = _config.GetExtents();
 
-		if (vkEndCommandBuffer(_commandBuffer) != VK_SUCCESS)
+			VkClearValue clearColor = {{{0, 0, 0, 1}}};
+			renderBeginInfo.clearValueCount = firstPart ? 1 : 0;
+			renderBeginInfo.pClearValues = firstPart ? &clearColor : nullptr;
+
+			vkCmdBeginRenderPass(frame.commandBuffer, &renderBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+			// ==============================================
+			//   Draw
+
+			if (partMiddle > partStart)
+			{
+				RecordResolve(frame.commandBuffer);
+			}
+
+			RecordBatches(frame.commandBuffer, partMiddle, partEnd);
+
+			// ==============================================
+
+			vkCmdEndRenderPass(frame.commandBuffer);
+
+			partStart = partEnd;
+		}
+		while (partStart < _renderBatches.size());
+
+		if (vkEndCommandBuffer(frame.commandBuffer) != VK_SUCCESS)
 		{
 			throw runtime_error("Failed to record command buffer");
 		}
@@ -695,24 +1690,140 @@ namespace renderer::vulkan
 		Present();
 	}
 
+	void Graphics::RecordBatches(VkCommandBuffer commandBuffer, std::size_t first, std::size_t last)
+	{
+		auto& frame = _frames[_frameIndex];
+
+		auto [width, height] = _config.GetExtents();
+
+		// Every batch streams from the same buffer, bound once and addressed by first vertex or instance
+		Buffer*          boundBuffer = nullptr;
+		VkPipeline       boundPipeline = VK_NULL_HANDLE;
+		VkDescriptorSet  boundSet = VK_NULL_HANDLE;
+
+		for(std::size_t i = first; i < last; i++)
+		{
+			auto& batch = _renderBatches[i];
+
+			VkPipeline       pipeline = _shaders.GetShaderPipeline(batch.shaderIndex);
+			VkPipelineLayout pipelineLayout = _shaders.GetShaderPipelineLayout(batch.shaderIndex);
+
+			if (batch.streamData.buffer != boundBuffer)
+			{
+				VkBuffer     buffer = batch.streamData.buffer->GetHandle();
+				VkDeviceSize offset = 0;
+
+				vkCmdBindVertexBuffers(commandBuffer, 0, 1, &buffer, &offset);
+
+				boundBuffer = batch.streamData.buffer;
+			}
+
+			if (pipeline != boundPipeline)
+			{
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+				boundPipeline = pipeline;
+				_statistics.pipelineBinds++;
+
+				// Layouts differ between pipelines, set and constants are bound again
+				boundSet = VK_NULL_HANDLE;
+
+				if (batch.instanced)
+				{
+					InstanceConstants constants { .inverseExtent = { 1.0f / width, 1.0f / height } };
+
+					vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+				}
+			}
+
+			if (frame.descriptorSets[i] != boundSet)
+			{
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+																pipelineLayout, 0, 1, &frame.descriptorSets[i], 0, VK_NULL_HANDLE);
+
+				boundSet = frame.descriptorSets[i];
+				_statistics.descriptorSetBinds++;
+			}
+
+			if (batch.instanced)
+			{
+				uint32_t firstInstance = batch.streamData.offsetInMemory / sizeof(InstanceData);
+
+				// Every instance is one quad of two triangles
+				vkCmdDraw(commandBuffer, 6, batch.instanceCount, 0, firstInstance);
+			}
+			else
+			{
+				if (batch.drawable->GetType() == TilemapType)
+				{
+					TilemapConstants constants { .cellSize = static_cast<Tilemap*>(batch.drawable)->GetTileset()->CellSize };
+
+					vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(constants), &constants);
+				}
+				else if (batch.drawable->GetType() == VideoType)
+				{
+					auto& constants = static_cast<VideoPicture*>(batch.drawable)->GetConstants();
+
+					vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(constants), &constants);
+				}
+
+				uint32_t firstVertex = batch.streamData.offsetInMemory / sizeof(Vertex);
+
+				vkCmdDraw(commandBuffer, batch.vertexCount, 1, firstVertex, 0);
+			}
+		}
+	}
+
+	void Graphics::RecordResolve(VkCommandBuffer commandBuffer)
+	{
+		VkPipelineLayout pipelineLayout = _shaders.GetShaderPipelineLayout(_resolveShaderIndex);
+
+		ResolveConstants constants {};
+
+		static_assert(std::size(constants.cycles) == PALETTE_CYCLE_MAX);
+
+		for(uint32_t i = 0; i < PALETTE_CYCLE_MAX; i++)
+		{
+			constants.cycles[i] = { _paletteCycles[i].first, _paletteCycles[i].count, _paletteCycles[i].period, 0 };
+		}
+
+		// Cycles are evaluated per pixel, nothing is uploaded when they move
+		constants.tick = _paletteTick;
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _shaders.GetShaderPipeline(_resolveShaderIndex));
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &_resolveSets[_frameIndex].set, 0, VK_NULL_HANDLE);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(constants), &constants);
+
+		_statistics.pipelineBinds++;
+		_statistics.descriptorSetBinds++;
+
+		// One triangle covers the screen, every pixel reads its index once
+		vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+	}
+
 	void Graphics::Submit()
 	{
+		auto& frame = _frames[_frameIndex];
+
+		// Everything loaded since the last frame goes in one batch ahead of it
+		_bufferAllocator.SubmitUploads();
+
 		VkSubmitInfo submitInfo { VK_STRUCTURE_TYPE_SUBMIT_INFO };
 
-		array<VkSemaphore, 1> waitSemaphores = { _imageAvailableSemaphore };
+		array<VkSemaphore, 1> waitSemaphores = { frame.imageAvailableSemaphore };
 		VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
 
 		submitInfo.waitSemaphoreCount = waitSemaphores.size();
 		submitInfo.pWaitSemaphores = waitSemaphores.data();
 		submitInfo.pWaitDstStageMask = waitStages;
 		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &_commandBuffer;
+		submitInfo.pCommandBuffers = &frame.commandBuffer;
 
-		array<VkSemaphore, 1> signalSemaphores = { _renderFinishedSemaphore };
+		array<VkSemaphore, 1> signalSemaphores = { frame.renderFinishedSemaphore };
 		submitInfo.signalSemaphoreCount = signalSemaphores.size();
 		submitInfo.pSignalSemaphores = signalSemaphores.data();
 
-		if (vkQueueSubmit(_device.GetGraphicsQueue(), 1, &submitInfo, _fence) != VK_SUCCESS)
+		if (vkQueueSubmit(_device.GetGraphicsQueue(), 1, &submitInfo, frame.fence) != VK_SUCCESS)
 		{
 			throw runtime_error("Failed to submit draw command buffer");
 		}
@@ -720,9 +1831,11 @@ namespace renderer::vulkan
 
 	void Graphics::Present()
 	{
+		auto& frame = _frames[_frameIndex];
+
 		VkPresentInfoKHR presentInfo { VK_STRUCTURE_TYPE_PRESENT_INFO_KHR };
 
-		array<VkSemaphore, 1> waitSemaphores = { _renderFinishedSemaphore };
+		array<VkSemaphore, 1> waitSemaphores = { frame.renderFinishedSemaphore };
 
 		presentInfo.waitSemaphoreCount = waitSemaphores.size();
 		presentInfo.pWaitSemaphores = waitSemaphores.data();
@@ -741,20 +1854,57 @@ namespace renderer::vulkan
 		vkQueuePresentKHR(_device.GetPresentQueue(), &presentInfo);
 	}
 
-	ShaderCode Graphics::ReadShaderCode(const char* path)
+	ShaderCode Graphics::ReadShaderCode(const char* name)
 	{
 		ShaderCode output;
-		output.size = _assets->GetSize(path);
+
+		if (!_shaderOverridePath.empty())
+		{
+			std::ifstream input(std::filesystem::path(_shaderOverridePath) / name, std::ios::binary | std::ios::ate);
+
+			if (input.is_open())
+			{
+				output.size = input.tellg();
+				output.code = std::make_unique<uint8_t[]>(output.size);
+
+				input.seekg(0);
+				input.read(reinterpret_cast<char*>(output.code.get()), output.size);
+
+				return output;
+			}
+		}
+
+		auto shader = std::find_if(std::begin(shaders::embedded), std::end(shaders::embedded), [name] (const EmbeddedShaderCode& shader) {
+			return strcmp(shader.name, name) == 0;
+		});
+
+		if (shader == std::end(shaders::embedded))
+		{
+			throw runtime_error("Shader is not built into the renderer");
+		}
+
+		output.size = shader->size;
 		output.code = std::make_unique<uint8_t[]>(output.size);
 
-		_assets->ReadBytes(path, output.code.get());
+		memcpy(output.code.get(), shader->code, output.size);
 
 		return output;
 	}
 
 	void Graphics::WaitIdle()
 	{
+		_bufferAllocator.SubmitUploads();
+
 		vkDeviceWaitIdle(_device);
+
+		// Nothing is in flight anymore
+		for(auto& frame : _frames)
+		{
+			for(auto drawable : frame.retiredDrawables)
+				DestroyDrawable(drawable);
+
+			frame.retiredDrawables.clear();
+		}
 	}
 
 	A_VulkanDrawable* Graphics::ConvertToDrawable(DrawableHandle handle)
@@ -791,43 +1941,68 @@ namespace renderer::vulkan
 	{
 		const VkAllocationCallbacks* const allocator = nullptr;
 
-		if (_descriptorPool != VK_NULL_HANDLE)
+		for(auto pool : _descriptorPools)
 		{
-			vkDestroyDescriptorPool(_device, _descriptorPool, allocator);
+			vkDestroyDescriptorPool(_device, pool, allocator);
 		}
 
-		_descriptorPool = VK_NULL_HANDLE;
+		_descriptorPools.clear();
+		_descriptorSets.clear();
+		_resolveSets = {};
 
 		_standardLayout.Destroy();
 
 		_samplerLayout.Destroy();
 
+		_instancedLayout.Destroy();
+
+		_tilemapLayout.Destroy();
+
+		_videoLayout.Destroy();
+
 		for(auto drawable : _drawables)
 		{
 			delete drawable;
 		}
 
+		for(auto& frame : _frames)
+		{
+			for(auto drawable : frame.retiredDrawables)
+				delete drawable;
+
+			frame.retiredDrawables.clear();
+		}
+
 		_textureSampler.Destroy();
 
 		_textureLinearInterpSampler.Destroy();
 
+		// Index target itself goes with the other images
+		if (_indexFramebuffer)
+			_indexFramebuffer->Destroy();
+
+		_indexFramebuffer.reset();
+
 		_bufferAllocator.Release();
 
 		_memoryManager.Release();
 
-		if (_imageAvailableSemaphore)
-			vkDestroySemaphore(_device, _imageAvailableSemaphore, allocator);
+		for(auto& frame : _frames)
+		{
+			if (frame.imageAvailableSemaphore)
+				vkDestroySemaphore(_device, frame.imageAvailableSemaphore, allocator);
 
-		if (_renderFinishedSemaphore)
-			vkDestroySemaphore(_device, _renderFinishedSemaphore, allocator);
+			if (frame.renderFinishedSemaphore)
+				vkDestroySemaphore(_device, frame.renderFinishedSemaphore, allocator);
 
-		if (_fence)
-			vkDestroyFence(_device, _fence, allocator);
+			if (frame.fence)
+				vkDestroyFence(_device, frame.fence, allocator);
 
-		if (_commandBuffer)
-			vkFreeCommandBuffers(_device, _commandPool, 1, &_commandBuffer);
+			if (frame.commandBuffer)
+				vkFreeCommandBuffers(_device, _commandPool, 1, &frame.commandBuffer);
 
-		_commandBuffer = nullptr;
+			frame.commandBuffer = nullptr;
+		}
 
 		if (_commandPool)
 			vkDestroyCommandPool(_device, _commandPool, allocator);
@@ -835,6 +2010,16 @@ namespace renderer::vulkan
 		_commandPool = nullptr;
 
 		_shaders.Destroy();
+
+		// Pipelines compiled in this run are kept for the next one
+		_pipelineCache.Save();
+		_pipelineCache.Destroy();
+
+		if (_indexedRendering)
+		{
+			_indexRenderPass.Destroy();
+			_loadRenderPass.Destroy();
+		}
 		
 		_renderPass.Destroy();
 
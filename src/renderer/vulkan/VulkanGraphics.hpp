@@ -6,20 +6,26 @@
 #include <array>
 #include <filesystem/Storage.hpp>
 #include <memory>
+#include <optional>
+#include <span>
+#include <unordered_map>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
 #include "../A_Graphics.hpp"
 #include "DescriptorSetLayout.hpp"
 #include "Drawable.hpp"
+#include "PipelineCache.hpp"
 #include "RenderPass.hpp"
 #include "Sampler.hpp"
 #include "Shader.hpp"
+#include "SpriteAtlas.hpp"
 #include "Window.hpp"
 #include "data/Assets.hpp"
 #include "data/Common.hpp"
 #include "data/Sprite.hpp"
 #include "device/Device.hpp"
+#include "device/Framebuffer.hpp"
 #include "device/SwapChain.hpp"
 #include "memory/BufferAllocator.hpp"
 #include "Vertex.hpp"
@@ -33,12 +39,71 @@ namespace renderer::vulkan
 
 	extern const std::vector<const char*> validationLayers;
 
+	// Sets per descriptor pool, another pool is created when all are full
 	const uint32_t POOL_MAX_SETS = 200;
 
+	// Frames CPU can record while GPU still renders the previous ones
+	const uint32_t FRAMES_IN_FLIGHT = 2;
+
+	// Everything a frame uses until its fence is signaled
+	struct FrameResources
+	{
+		VkCommandBuffer  commandBuffer = VK_NULL_HANDLE;
+		VkFence          fence = VK_NULL_HANDLE;
+		VkSemaphore      imageAvailableSemaphore = VK_NULL_HANDLE, renderFinishedSemaphore = VK_NULL_HANDLE;
+
+		// Set of each draw call, owned by the drawables
+		std::vector<VkDescriptorSet> descriptorSets;
+
+		// Freed while this frame was recorded, destroyed once its fence is signaled
+		std::vector<A_VulkanDrawable*> retiredDrawables;
+	};
+
+	// Resources written to a descriptor set, bindings without them are null
+	struct DescriptorBindings
+	{
+		std::array<VkImageView, 3> views {};
+		VkBuffer                   buffer = VK_NULL_HANDLE;
+
+		bool operator==(const DescriptorBindings&) const = default;
+	};
+
+	// Set kept with its drawable, rewritten only when bound resources change
+	struct CachedDescriptorSet
+	{
+		VkDescriptorSet    set = VK_NULL_HANDLE;
+		VkDescriptorPool   pool = VK_NULL_HANDLE;
+		DescriptorBindings bindings;
+	};
+
+	// One set per frame in flight for plain and instanced draws
+	typedef std::array<CachedDescriptorSet, FRAMES_IN_FLIGHT * 2> DrawableDescriptorSets;
+
+	// Draws made through the interface, sorted and merged into batches when presented
 	struct DrawCall
 	{
 		A_VulkanDrawable* drawable = nullptr;
+		bool              instanced = false;
+		bool              indexed = false;
+		uint32_t          shaderIndex = 0;
+
+		// Layer and order of the call from the high bits down
+		uint64_t sortKey = 0;
+
+		// Range of the frame's draw items, sized draws stretch every item
+		uint32_t firstItem = 0, itemCount = 0;
+		uint32_t width = 0, height = 0;
+	};
+
+	// Calls sharing all state, recorded as one draw
+	struct RenderBatch
+	{
+		A_VulkanDrawable* drawable = nullptr;
+		uint32_t          shaderIndex = 0;
 		uint32_t          vertexCount = 0;
+		uint32_t          instanceCount = 0;
+		bool              instanced = false;
+		bool              indexed = false;
 		StreamData        streamData;
 	};
 
@@ -46,24 +111,47 @@ namespace renderer::vulkan
 	{
 	public:
 
-		Graphics(SDL_Window* window, const data::Assets* assets);
+		Graphics(SDL_Window* window, const data::Assets* assets, const GraphicsSettings& settings = {});
 
-		DrawableHandle LoadSpriteSheet(data::A_SpriteSheetData&) override;
-		DrawableHandle LoadTileset(data::A_TilesetData&, std::vector<bool>& usedTiles) override;
+		DrawableHandle LoadSpriteSheet(std::shared_ptr<const data::A_SpriteSheetData>) override;
+		TilesetAtlas   BakeTileset(const data::A_TilesetData&, const std::vector<bool>& usedTiles) const override;
+		DrawableHandle LoadTileset(data::A_TilesetData&, TilesetAtlas) override;
 		DrawableHandle LoadImage(uint32_t* pixels, uint32_t width, uint32_t height) override;
 
+		DrawableHandle CreateStreamingImage(uint32_t width, uint32_t height, ImageFormat) override;
+		void UpdateStreamingImage(DrawableHandle, const void* pixels) override;
+
+		DrawableHandle CreateVideoImage(uint32_t width, uint32_t height, const VideoFormat&) override;
+		void UpdateVideoImage(DrawableHandle, std::span<const ImagePlane> planes) override;
+
+		DrawableHandle CreateTilemap(DrawableHandle tileset, uint32_t width, uint32_t height) override;
+		void UpdateTilemap(DrawableHandle tilemap, int left, int top, int width, int height, const data::tileID* tiles, int columnStride) override;
+		void SetTilemapView(DrawableHandle tilemap, int left, int top, int width, int height) override;
+
 		void Draw(DrawableHandle, frameIndex, data::position) override;
 		void Draw(DrawableHandle, data::position, uint32_t width, uint32_t height) override;
+		void DrawBatch(DrawableHandle, std::span<const DrawItem>) override;
 		void FreeDrawable(DrawableHandle) override;
 
+		uint64_t GetMemorySize(DrawableHandle) override;
+
 		void SetTilesetPalette(data::Palette&) override;
+		void SetPaletteCycles(std::span<const PaletteCycle>) override;
+		void SetPaletteTick(uint32_t tick) override;
+		void SetPaletteRemap(data::PaletteRemap, std::span<const uint8_t, data::PALETTE_SIZE> indices) override;
+		void SetDrawStyle(const DrawStyle&) override;
+
+		void EnableInstancing(bool) override;
 
 		void SetView(data::position pos) override;
+		void SetLayer(uint8_t layer) override;
 		void BeginRendering() override;
 		void PresentToScreen() override;
 
 		const char* GetName() const override { return "Vulkan"; }
 
+		RenderStatistics GetRenderStatistics() const override { return _statistics; }
+
 		void WaitIdle() override;
 
 		void Release() override;
@@ -73,50 +161,107 @@ namespace renderer::vulkan
 		void CreateInstance(std::vector<const char*>& enabledLayers);
 		void EnableValidationLayers(std::vector<const char*>& layerList);
 		void CreateSyncObjects();
-		void CreateDescriptorPools();
-		DrawCall* UseDrawCall(DrawableHandle);
-		void ClearDescriptorPool();
-		void AllocateDescriptorSets();
-		void WriteDescriptorSets();
+		VkDescriptorPool CreateDescriptorPool();
+		DrawCall* UseDrawCall(DrawableHandle, bool instanced = false, uint32_t width = 0, uint32_t height = 0);
+		bool CanDrawInstanced(DrawableHandle);
+		bool DrawsIndices(A_VulkanDrawable*) const;
+		uint32_t TakeShaderIndex(A_VulkanDrawable*, bool instanced, bool indexed);
+		uint32_t TakeSpriteShaderIndex(bool instanced, bool indexed);
+		void CreateSpriteShaderVariants();
+		std::array<uint32_t, PALETTE_CYCLE_MAX> TakePaletteShifts() const;
+		void UploadPalette();
+		void BuildRenderBatches();
+		void WriteInstances(RenderBatch&, A_VulkanDrawable*, std::span<const DrawItem>);
+		void WriteQuads(RenderBatch&, A_VulkanDrawable*, std::span<const DrawItem>, uint32_t width, uint32_t height);
+		void CreateFrameTable(A_VulkanDrawable*);
+		void DestroyDrawable(A_VulkanDrawable*);
+		VkDescriptorSetLayout TakeDescriptorSetLayout(const RenderBatch&);
+		DescriptorBindings TakeDescriptorBindings(const RenderBatch&);
+		VkSampler TakeSampler(const RenderBatch&);
+		void AllocateDescriptorSet(VkDescriptorSetLayout, CachedDescriptorSet&);
+		void WriteDescriptorSet(VkDescriptorSet, const DescriptorBindings&, VkSampler);
+		void UpdateDescriptorSets();
+		// Records batches [first, last), all of them go to the same pass
+		void RecordBatches(VkCommandBuffer, std::size_t first, std::size_t last);
+		void RecordResolve(VkCommandBuffer);
+		void Defragment();
 		void Submit();
 		void Present();
 
 		A_VulkanDrawable* ConvertToDrawable(DrawableHandle);
+		Tilemap*          ConvertToTilemap(DrawableHandle);
 		std::vector<A_VulkanDrawable*>::iterator FindDrawable(DrawableHandle);
 
-		ShaderCode ReadShaderCode(const char* path);
+		// Built in code unless the override directory holds the file
+		ShaderCode ReadShaderCode(const char* name);
 
 	private:
 
 		// TODO: hide these members in implementation
 		const data::Assets*  _assets;
+		std::string          _shaderOverridePath;
 
 		Config              _config;
 		VkInstance          _instance;
 		VkSurfaceKHR        _surface;
 		VkCommandPool       _commandPool;
-		VkCommandBuffer     _commandBuffer;
 		Swapchain           _swapchain;
 		Device              _device;
 		Window              _window;
 		RenderPass          _renderPass;
+		PipelineCache       _pipelineCache;
 		ShaderManager       _shaders;
 		BufferAllocator     _bufferAllocator;
 		MemoryManager       _memoryManager;
-		DescriptorSetLayout _standardLayout, _samplerLayout;
-		VkDescriptorPool    _descriptorPool;
-		VkDescriptorSet     _descriptorSets[POOL_MAX_SETS];
-		int                 _descriptorSetCount = 0;
+		DescriptorSetLayout _standardLayout, _samplerLayout, _instancedLayout, _tilemapLayout, _videoLayout;
+
+		std::array<FrameResources, FRAMES_IN_FLIGHT> _frames;
+		uint32_t                                     _frameIndex = 0;
 
-		Image*                _tilesetImage;
-		std::vector<uint32_t> _tileMap;
+		std::vector<VkDescriptorPool>                                 _descriptorPools;
+		std::unordered_map<A_VulkanDrawable*, DrawableDescriptorSets> _descriptorSets;
 
-		VkSemaphore _imageAvailableSemaphore, _renderFinishedSemaphore;
-		VkFence     _fence;
+		Image*      _tilesetImage;
+		SpriteAtlas _spriteAtlas;
+
+		// Last palette given, uploaded to the tileset image rotated by the
+		//  cycles unless they are applied by the resolve pass
+		std::array<data::Color, data::PALETTE_SIZE> _tilesetPalette;
+		bool                                        _tilesetPaletteValid = false;
+
+		std::array<PaletteCycle, PALETTE_CYCLE_MAX> _paletteCycles {};
+		uint32_t                                    _paletteTick = 0;
+
+		// Places each cycle is rotated by in the uploaded palette
+		std::array<uint32_t, PALETTE_CYCLE_MAX> _uploadedShifts {};
+
+		// Target of palettized draws in indexed rendering, resolved into the swapchain image.
+		//  Draws after a blended one go to the target again, the swapchain pass is then
+		//  resumed by the loading pass
+		bool                       _indexedRendering = false;
+		RenderPass                 _indexRenderPass, _loadRenderPass;
+		Image*                     _indexTarget = nullptr;
+		std::optional<FrameBuffer> _indexFramebuffer;
+		uint32_t                   _mainIndexShaderIndex, _instancedIndexShaderIndex, _tilemapIndexShaderIndex, _resolveShaderIndex;
+
+		std::array<CachedDescriptorSet, FRAMES_IN_FLIGHT> _resolveSets;
 
 		data::position _currentPosition;
 		uint32_t       _currentImageIndex;
-		uint32_t       _mainShaderIndex, _textureShaderIndex;
+		uint32_t       _mainShaderIndex, _textureShaderIndex, _instancedShaderIndex, _tilemapShaderIndex, _videoShaderIndex;
+		uint32_t       _atlasShaderIndex, _atlasInstancedShaderIndex;
+
+		// Sprite sheet pipelines of draw styles, all created with the renderer so
+		//  their indices don't depend on which style is drawn first
+		std::array<uint32_t, 2>                _atlasModules, _atlasInstancedModules;
+		std::unordered_map<uint32_t, uint32_t> _spriteShaderVariants;
+		DrawStyle                              _drawStyle;
+
+		bool _instancingEnabled = true;
+
+		// Memory before the running defragmentation started, for the report
+		bool         _defragmenting = false;
+		VkDeviceSize _reservedBeforeDefragment = 0, _usedBeforeDefragment = 0;
 
 		DrawCall* _currentDrawCall;
 
@@ -127,5 +272,10 @@ namespace renderer::vulkan
 		uint32_t                          _drawablesCacheIndex = 0;
 
 		std::vector<DrawCall>          _drawCalls;
+		std::vector<DrawItem>          _drawItems;
+		std::vector<RenderBatch>       _renderBatches;
+
+		uint8_t          _layer = 0;
+		RenderStatistics _statistics;
 	};
 }
\ No newline at end of file
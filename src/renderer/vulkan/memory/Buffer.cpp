@@ -50,7 +50,8 @@ namespace renderer::vulkan
 
 			size = _size;
 
-		vkMapMemory(*_device, _hwMemory, offset, size, memoryFlags, dst);
+		// Offset is relative to the buffer, memory might be shared with others
+		vkMapMemory(*_device, _hwMemory, _offsetInMemory + offset, size, memoryFlags, dst);
 	}
 
 	void Buffer::UnmapMemory() const
@@ -59,6 +60,11 @@ namespace renderer::vulkan
 	}
 
 	void Buffer::CopyTo(Image& image, VkCommandBuffer commandBuffer, VkQueue queue)
+	{
+		CopyTo(image, { 0, 0, 0 }, image.GetExtents(), commandBuffer, queue);
+	}
+
+	void Buffer::CopyTo(Image& image, VkOffset3D offset, VkExtent3D extent, VkCommandBuffer commandBuffer, VkQueue queue)
 	{
 		BeginSingleTimeCommand(commandBuffer);
 		{
@@ -73,8 +79,8 @@ namespace renderer::vulkan
 			copyRegion.imageSubresource.baseArrayLayer = 0;
 			copyRegion.imageSubresource.layerCount = 1;
 
-			copyRegion.imageOffset = { 0, 0, 0 };
-			copyRegion.imageExtent = image.GetExtents();
+			copyRegion.imageOffset = offset;
+			copyRegion.imageExtent = extent;
 
 			vkCmdCopyBufferToImage(commandBuffer, _hwBuffer, image.GetHandle(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
 		}
@@ -123,6 +129,8 @@ namespace renderer::vulkan
 
 	VkDeviceMemory Buffer::GetMemoryHandle() const { return _hwMemory; }
 
+	VkDeviceSize Buffer::GetMemoryOffset() const { return _offsetInMemory; }
+
 	VkDeviceSize Buffer::GetSize() const { return _size; }
 
 	VkMemoryPropertyFlagBits Buffer::GetMemoryPropertyFlags() const { return _propertyFlags; }
@@ -136,6 +144,8 @@ namespace renderer::vulkan
 			case StreamVertexBuffer:
 			case StagingBuffer:
 				return VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+			case FrameTableBuffer:
+				return VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 		}
 
 		throw runtime_error("Unexpected exception");
@@ -148,6 +158,8 @@ namespace renderer::vulkan
 				return VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
 			case StagingBuffer:
 				return VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+			case FrameTableBuffer:
+				return VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 		}
 
 		throw runtime_error("Unexpected exception");
@@ -11,7 +11,7 @@ namespace renderer::vulkan
 
 	enum BufferType
 	{
-		StreamVertexBuffer, StagingBuffer
+		StreamVertexBuffer, StagingBuffer, FrameTableBuffer
 	};
 
 	class Buffer
@@ -27,10 +27,12 @@ namespace renderer::vulkan
 		void MapMemory(void** dst, uint64_t size = BUFFER_WHOLE_SIZE, VkDeviceSize offset = 0) const;
 		void UnmapMemory() const;
 		void CopyTo(Image& image, VkCommandBuffer commandBuffer, VkQueue queue);
+		void CopyTo(Image& image, VkOffset3D offset, VkExtent3D extent, VkCommandBuffer commandBuffer, VkQueue queue);
 		void CopyTo(Buffer& dstBuffer, VkDeviceSize size, VkCommandBuffer commandBuffer, VkQueue queue); // only for staging buffers
 
 		VkDeviceSize GetMemoryAlignment() const;
 		VkDeviceMemory GetMemoryHandle() const;
+		VkDeviceSize GetMemoryOffset() const;
 		VkDeviceSize GetSize() const;
 		VkMemoryPropertyFlagBits GetMemoryPropertyFlags() const;
 
@@ -16,47 +16,49 @@ namespace renderer::vulkan
 	using std::array;
 	using data::Aligned;
 
+	const uint64_t bufferAlignment = 16;
+
+	// Draws address streamed data by first vertex or instance of one bound buffer
+	static_assert(bufferAlignment % sizeof(Vertex) == 0 && bufferAlignment % sizeof(InstanceData) == 0);
+
 	BufferAllocator::BufferAllocator() {}
 
 	BufferAllocator::BufferAllocator(Device* device, VkQueue graphicsQueue, VkCommandPool commandPool, MemoryManager* memoryManager, const VkAllocationCallbacks* allocator)
-		: _device(device), _graphicsQueue(graphicsQueue), _commandPool(commandPool), _memoryManager(memoryManager), _allocator(allocator)
+		: _device(device), _graphicsQueue(graphicsQueue), _commandPool(commandPool), _memoryManager(memoryManager), _allocator(allocator),
+			_uploads(device, graphicsQueue, commandPool)
 		{}
 
-	void BufferAllocator::Initialize()
+	void BufferAllocator::Initialize(uint32_t frameCount)
 	{
 		const VkDeviceSize dynamicBufferSize = MinimalMemorySize;
-		const VkDeviceSize stagingBufferSize = MinimalMemorySize / 4;
+		// Holds uploads of a whole map load, so they are submitted at once
+		const VkDeviceSize stagingBufferSize = MinimalMemorySize;
 
 		_dynamicBuffer = Buffer::Create(dynamicBufferSize, _device, StreamVertexBuffer, _allocator);
 
 		BindMemoryToBuffer(_dynamicBuffer);
 
-		_stagingBuffer = Buffer::Create(stagingBufferSize, _device, StagingBuffer, _allocator);
+		// Each frame in flight streams into its own region, memory stays mapped
+		_dynamicRegionSize = dynamicBufferSize / frameCount / bufferAlignment * bufferAlignment;
+
+		_dynamicBuffer.MapMemory(&_dynamicBufferMappedMemory);
 
-		BindMemoryToBuffer(_stagingBuffer);
+		Buffer stagingBuffer = Buffer::Create(stagingBufferSize, _device, StagingBuffer, _allocator);
 
-		VkCommandBufferAllocateInfo commandBufferInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
-		commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    commandBufferInfo.commandPool = _commandPool;
-    commandBufferInfo.commandBufferCount = 1;
+		BindMemoryToBuffer(stagingBuffer);
 
-		if (vkAllocateCommandBuffers(*_device, &commandBufferInfo, &_stagingCommandBuffer) != VK_SUCCESS)
-		{
-			throw runtime_error("Failed to allocate command buffer");
-		}
+		_uploads.Initialize(stagingBuffer);
 	}
-		
-	const uint64_t bufferAlignment = 16;
 
 	const StreamData BufferAllocator::WriteToStreamBuffer(uint64_t size, const void* srcData)
 	{
-		if (_dynamicBufferOffset + size > _dynamicBuffer.GetSize())
+		_dynamicBufferOffset = Aligned(_dynamicBufferOffset, bufferAlignment);
+
+		if (_dynamicBufferOffset + size > _dynamicBufferEnd)
 		{
 			throw runtime_error("Failed to write to vertex buffer: buffer size exceeded");
 		}
 
-		_dynamicBufferOffset = Aligned(_dynamicBufferOffset, bufferAlignment);
-
 		StreamData streamData = { &_dynamicBuffer, _dynamicBufferOffset, size };
 
 		// Write data to streaming buffer
@@ -72,11 +74,11 @@ namespace renderer::vulkan
 
 	void BufferAllocator::WriteToStreamBuffer(StreamData& streamData, uint64_t size, const void* srcData)
 	{
-		if (_dynamicBufferOffset + size > _dynamicBuffer.GetSize())
-		{
-			throw runtime_error("Failed to write to vertex buffer: buffer size exceeded");
-		}
+		memcpy(ReserveStreamBuffer(streamData, size), srcData, size);
+	}
 
+	void* BufferAllocator::ReserveStreamBuffer(StreamData& streamData, uint64_t size)
+	{
 		if (streamData.buffer == nullptr)
 		{
 			_dynamicBufferOffset = Aligned(_dynamicBufferOffset, bufferAlignment);
@@ -85,10 +87,12 @@ namespace renderer::vulkan
 			streamData.offsetInMemory = _dynamicBufferOffset;
 		}
 
-		// Write data to streaming buffer
-		uint8_t *dstData = reinterpret_cast<uint8_t*>(_dynamicBufferMappedMemory) + _dynamicBufferOffset;
+		if (_dynamicBufferOffset + size > _dynamicBufferEnd)
+		{
+			throw runtime_error("Failed to write to vertex buffer: buffer size exceeded");
+		}
 
-		memcpy(dstData, srcData, size);
+		uint8_t *dstData = reinterpret_cast<uint8_t*>(_dynamicBufferMappedMemory) + _dynamicBufferOffset;
 
 		streamData.size += size;
 
@@ -96,6 +100,8 @@ namespace renderer::vulkan
 		_dynamicBufferOffset += size;
 		
 		assert(streamData.offsetInMemory + streamData.size == _dynamicBufferOffset);
+
+		return dstData;
 	}
 
 	VkFormat BufferAllocator::TakeImageFormat(int pixelSize) const
@@ -103,16 +109,19 @@ namespace renderer::vulkan
 		switch(pixelSize)
 		{
 			case 1: return VK_FORMAT_R8_UNORM;
+			case 2: return VK_FORMAT_R8G8_UNORM;
 			case 4: return VK_FORMAT_R8G8B8A8_UNORM;
 		}
 
 		throw runtime_error("Unsupported format");
 	}
 
-	Image* BufferAllocator::CreateTextureImage(const void* data, uint32_t width, uint32_t height, uint32_t pixelSize)
+	Image* BufferAllocator::CreateTextureImage(const void* data, uint32_t width, uint32_t height, uint32_t pixelSize, VkFormat format)
 	{
 		// Creating image
-		auto format = TakeImageFormat(pixelSize);
+		if (format == VK_FORMAT_UNDEFINED)
+			format = TakeImageFormat(pixelSize);
+
 		Image* image = new Image(Image::Create(format, VK_IMAGE_TILING_OPTIMAL, width, height, _device, _allocator));
 
 		VkMemoryRequirements requirements;
@@ -126,39 +135,70 @@ namespace renderer::vulkan
 
 		if (data != nullptr)
 		{
-			auto dataBytes = reinterpret_cast<const uint8_t*>(data);
+			_uploads.UploadImage(image, data, { 0, 0, 0 }, { width, height, 1 }, pixelSize);
+		}
+
+		return image;
+	}
 
-			// Copy pixel data to staging buffer
-			image->TransitionImageLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, _stagingCommandBuffer, _graphicsQueue);
+	void BufferAllocator::UpdateImageData(Image* image, const uint8_t* data, uint32_t width, uint32_t height, uint32_t pixelSize, uint32_t rowStride)
+	{
+		_uploads.UploadImage(image, data, { 0, 0, 0 }, { width, height, 1 }, pixelSize, rowStride);
+	}
 
-			void* stagingBufferDst;
-			_stagingBuffer.MapMemory(&stagingBufferDst, width * height * pixelSize);
+	Buffer* BufferAllocator::CreateStorageBuffer(const void* data, uint64_t size)
+	{
+		Buffer* buffer = new Buffer(Buffer::Create(size, _device, FrameTableBuffer, _allocator));
 
-			memcpy(stagingBufferDst, dataBytes, width * height * pixelSize);
+		BindMemoryToBuffer(*buffer);
 
-			_stagingBuffer.UnmapMemory();
-			_stagingBuffer.CopyTo(*image, _stagingCommandBuffer, _graphicsQueue);
+		_buffers.push_back(buffer);
 
-			image->TransitionImageLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, _stagingCommandBuffer, _graphicsQueue);
+		if (data != nullptr)
+		{
+			_uploads.UploadBuffer(buffer, data, size);
 		}
 
+		return buffer;
+	}
+
+	void BufferAllocator::UpdateBufferData(Buffer* buffer, const void* data, uint64_t size, uint64_t offset)
+	{
+		_uploads.UploadBuffer(buffer, data, size, offset);
+	}
+
+	void BufferAllocator::UpdateImageRegion(Image* image, const uint8_t* data, uint32_t left, uint32_t top, uint32_t width, uint32_t height, uint32_t pixelSize, uint32_t layer)
+	{
+		_uploads.UploadImage(image, data, { static_cast<int32_t>(left), static_cast<int32_t>(top), 0 }, { width, height, 1 }, pixelSize, 0, layer);
+	}
+
+	Image* BufferAllocator::CreateImageArray(uint32_t width, uint32_t height, uint32_t layerCount, uint32_t pixelSize)
+	{
+		Image* image = new Image(Image::Create(TakeImageFormat(pixelSize), VK_IMAGE_TILING_OPTIMAL, width, height, _device, _allocator, layerCount));
+
+		VkMemoryRequirements requirements;
+		image->GetMemoryRequirements(requirements);
+
+		_memoryManager->BindMemoryToImage(*image, requirements, image->GetMemoryPropertyFlags());
+
+		_images.push_back(image);
+
 		return image;
 	}
 
-	void BufferAllocator::UpdateImageData(Image* image, const uint8_t* data, uint32_t width, uint32_t height, uint32_t pixelSize)
+	Image* BufferAllocator::CreateRenderTarget(uint32_t width, uint32_t height, uint32_t pixelSize)
 	{
-		// Copy pixel data to staging buffer
-		image->TransitionImageLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, _stagingCommandBuffer, _graphicsQueue);
+		Image* image = new Image(Image::Create(TakeImageFormat(pixelSize), VK_IMAGE_TILING_OPTIMAL, width, height, _device, _allocator, 1,
+																					 VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT));
 
-		void* stagingBufferDst;
-		_stagingBuffer.MapMemory(&stagingBufferDst, width * height * pixelSize);
+		VkMemoryRequirements requirements;
+		image->GetMemoryRequirements(requirements);
 
-		memcpy(stagingBufferDst, data, width * height * pixelSize);
+		_memoryManager->BindDedicatedMemoryToImage(*image, requirements, image->GetMemoryPropertyFlags());
 
-		_stagingBuffer.UnmapMemory();
-		_stagingBuffer.CopyTo(*image, _stagingCommandBuffer, _graphicsQueue);
+		_images.push_back(image);
 
-		image->TransitionImageLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, _stagingCommandBuffer, _graphicsQueue);
+		return image;
 	}
 
 	// Looks for memory to bind for buffer
@@ -174,20 +214,100 @@ namespace renderer::vulkan
 		_memoryManager->BindMemoryToBuffer(buffer, requirements, properMemoryTypeFlags);
 	}
 
-	void BufferAllocator::OnBeginRendering()
+	void BufferAllocator::OnBeginRendering(uint32_t frameIndex)
 	{
-		_dynamicBufferOffset = 0;
+		_dynamicBufferOffset = frameIndex * _dynamicRegionSize;
+		_dynamicBufferEnd    = _dynamicBufferOffset + _dynamicRegionSize;
 
-		_dynamicBuffer.MapMemory(&_dynamicBufferMappedMemory);
+		_uploads.Collect();
+
+		// Frames sampling the old copy were submitted before the move, they're done too
+		std::erase_if(_retiredImages, [this] (auto& retired) {
+			if (!_uploads.IsComplete(retired.ticket))
+				return false;
+
+			_memoryManager->Free(&retired.image);
+			retired.image.Destroy();
+
+			return true;
+		});
+	}
+
+	bool BufferAllocator::Defragment(std::chrono::microseconds timeBudget, VkDeviceSize byteBudget)
+	{
+		auto deadline = std::chrono::steady_clock::now() + timeBudget;
+		auto source   = _memoryManager->FindDefragmentationSource();
+
+		if (source == VK_NULL_HANDLE)
+		{
+			return !_retiredImages.empty();
+		}
+
+		// Queued uploads still target current handles
+		_uploads.Flush();
+
+		VkDeviceSize movedBytes = 0;
+		std::size_t  firstMoved = _retiredImages.size();
+
+		for(auto image : _images)
+		{
+			if (movedBytes >= byteBudget || std::chrono::steady_clock::now() >= deadline)
+				break;
+
+			// Images that were never written have nothing to copy, they stay
+			if (image->GetMemoryHandle() != source || image->GetLayout() != VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+				continue;
+
+			auto [width, height, depth] = image->GetExtents();
+
+			Image moved = Image::Create(image->GetFormat(), VK_IMAGE_TILING_OPTIMAL, width, height, _device, _allocator, image->GetLayerCount());
+
+			VkMemoryRequirements requirements;
+			moved.GetMemoryRequirements(requirements);
+
+			if (!_memoryManager->BindMemoryToImageOutside(moved, requirements, moved.GetMemoryPropertyFlags(), source))
+			{
+				moved.Destroy();
+				break;
+			}
+
+			_retiredImages.push_back({ *image, 0 });
+			*image = moved;
+
+			_uploads.MoveImage(_retiredImages.back().image, image);
+
+			movedBytes += image->GetSize();
+		}
+
+		if (firstMoved == _retiredImages.size())
+		{
+			return false;
+		}
+
+		auto ticket = _uploads.Flush();
+
+		for(auto it = _retiredImages.begin() + firstMoved; it != _retiredImages.end(); it++)
+		{
+			it->ticket = ticket;
+		}
+
+		return true;
+	}
+
+	uploadTicket BufferAllocator::SubmitUploads()
+	{
+		return _uploads.Flush();
 	}
 
-	void BufferAllocator::OnPrepareForPresentation()
+	bool BufferAllocator::IsUploadComplete(uploadTicket ticket)
 	{
-		_dynamicBuffer.UnmapMemory();
+		return _uploads.IsComplete(ticket);
 	}
 
 	void BufferAllocator::FreeImage(Image* image)
 	{
+		_uploads.Cancel(image);
+
 		_memoryManager->Free(image);
 
 		image->Destroy();
@@ -202,8 +322,37 @@ namespace renderer::vulkan
 		_images.erase(it);
 	}
 
+	void BufferAllocator::FreeBuffer(Buffer* buffer)
+	{
+		_uploads.Cancel(buffer);
+
+		_memoryManager->Free(buffer);
+
+		buffer->Destroy();
+
+		auto it = std::find(_buffers.begin(), _buffers.end(), buffer);
+
+		if (it == _buffers.end())
+		{
+			throw runtime_error("Failed to remove buffer from the list");
+		}
+
+		_buffers.erase(it);
+
+		delete buffer;
+	}
+
 	void BufferAllocator::Release()
 	{
+		_uploads.Release();
+
+		for(auto& retired : _retiredImages)
+		{
+			retired.image.Destroy();
+		}
+
+		_retiredImages.clear();
+
 		for(auto image : _images)
 		{
 			image->Destroy();
@@ -211,23 +360,20 @@ namespace renderer::vulkan
 			delete image;
 		}
 
-		_dynamicBuffer.Destroy();
-		_stagingBuffer.Destroy();
-
-		if (_stagingCommandBuffer != VK_NULL_HANDLE)
+		for(auto buffer : _buffers)
 		{
-			vkFreeCommandBuffers(*_device, _commandPool, 1, &_stagingCommandBuffer);
+			buffer->Destroy();
+
+			delete buffer;
 		}
 
-		_stagingCommandBuffer = VK_NULL_HANDLE;
-	}
+		if (_dynamicBufferMappedMemory != nullptr)
+		{
+			_dynamicBuffer.UnmapMemory();
 
-	void StreamData::BindToCommandBuffer(VkCommandBuffer commandBuffer)
-	{
-		const uint32_t bufferCount = 1;
-		array<VkBuffer, bufferCount> buffers = { buffer->GetHandle() };
-		array<VkDeviceSize, bufferCount> offsets = { offsetInMemory };
+			_dynamicBufferMappedMemory = nullptr;
+		}
 
-		vkCmdBindVertexBuffers(commandBuffer, 0, bufferCount, buffers.data(), offsets.data());
+		_dynamicBuffer.Destroy();
 	}
 }
\ No newline at end of file
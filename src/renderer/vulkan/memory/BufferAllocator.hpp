@@ -7,7 +7,9 @@
 #include "Buffer.hpp"
 #include "Image.hpp"
 #include "MemoryManager.hpp"
+#include "UploadQueue.hpp"
 
+#include <chrono>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
@@ -20,8 +22,6 @@ namespace renderer::vulkan
 		Buffer*  buffer = nullptr;
 		uint64_t offsetInMemory = 0;
 		uint64_t size = 0;
-
-		void BindToCommandBuffer(VkCommandBuffer);
 	};
 
 	class BufferAllocator
@@ -31,21 +31,51 @@ namespace renderer::vulkan
 		BufferAllocator();
 		BufferAllocator(Device* device, VkQueue graphicsQueue, VkCommandPool, MemoryManager*, const VkAllocationCallbacks*);
 
-		void Initialize();
+		// Stream buffer is split between frames in flight
+		void Initialize(uint32_t frameCount);
 
 		const StreamData WriteToStreamBuffer(uint64_t size, const void* data);
 
 		void WriteToStreamBuffer(StreamData& streamData, uint64_t size, const void* data);
 
-		Image* CreateTextureImage(const void* data, uint32_t width, uint32_t height, uint32_t pixelSize);
-		void   UpdateImageData(Image*, const uint8_t* data, uint32_t width, uint32_t height, uint32_t pixelSize);
+		// Appends size bytes to the stream and returns mapped memory for them,
+		//  memory is write-only, reading it back might be very slow
+		void* ReserveStreamBuffer(StreamData& streamData, uint64_t size);
+
+		// Uploads below are queued and reach GPU with the next SubmitUploads,
+		//  data can be freed as soon as they return
+
+		// Format is picked by pixel size when it's undefined
+		Image* CreateTextureImage(const void* data, uint32_t width, uint32_t height, uint32_t pixelSize, VkFormat format = VK_FORMAT_UNDEFINED);
+		void   UpdateImageData(Image*, const uint8_t* data, uint32_t width, uint32_t height, uint32_t pixelSize, uint32_t rowStride = 0);
+		void   UpdateImageRegion(Image*, const uint8_t* data, uint32_t left, uint32_t top, uint32_t width, uint32_t height, uint32_t pixelSize, uint32_t layer = 0);
+
+		// Layers are written by UpdateImageRegion
+		Image* CreateImageArray(uint32_t width, uint32_t height, uint32_t layerCount, uint32_t pixelSize);
+
+		// Color attachment sampled by later passes, its memory is dedicated so
+		//  defragmentation leaves it alone
+		Image* CreateRenderTarget(uint32_t width, uint32_t height, uint32_t pixelSize);
 
-		// Needs to be reset every frame
-		void OnBeginRendering();
+		// Device local buffer filled through the staging buffer, left unwritten without data
+		Buffer* CreateStorageBuffer(const void* data, uint64_t size);
+		void    UpdateBufferData(Buffer*, const void* data, uint64_t size, uint64_t offset);
 
-		void OnPrepareForPresentation();
+		// Needs to be reset every frame, streamed data goes to the region
+		//  of the frame, GPU must be done with its previous contents
+		void OnBeginRendering(uint32_t frameIndex);
+
+		// Sends queued uploads as one batch, work submitted later sees them
+		uploadTicket SubmitUploads();
+		bool         IsUploadComplete(uploadTicket);
 
 		void FreeImage(Image*);
+		void FreeBuffer(Buffer*);
+
+		// Moves images out of the sparsest memory block into other blocks until
+		//  the budget runs out, so the block can be freed. Image objects stay the
+		//  same, their handles change. Returns false when there's nothing to do
+		bool Defragment(std::chrono::microseconds timeBudget, VkDeviceSize byteBudget);
 
 		void Release();
 
@@ -67,15 +97,26 @@ namespace renderer::vulkan
 
 		Buffer   _dynamicBuffer;
 		uint64_t _dynamicBufferOffset = 0;
+		uint64_t _dynamicBufferEnd = 0;
+		uint64_t _dynamicRegionSize = 0;
 		void*    _dynamicBufferMappedMemory = nullptr;
 
-		Buffer   _stagingBuffer;
+		UploadQueue _uploads;
 
 		VkQueue  _graphicsQueue = nullptr;
 
 		VkCommandPool   _commandPool = nullptr;
-		VkCommandBuffer _stagingCommandBuffer = nullptr;
 
-		std::vector<Image*> _images;
+		std::vector<Image*>  _images;
+		std::vector<Buffer*> _buffers;
+
+		// Old copies of moved images, freed when their move completes
+		struct RetiredImage
+		{
+			Image        image;
+			uploadTicket ticket;
+		};
+
+		std::vector<RetiredImage> _retiredImages;
 	};
 }
\ No newline at end of file
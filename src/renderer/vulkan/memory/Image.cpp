@@ -17,7 +17,8 @@ namespace renderer::vulkan
 		{}
 
 	Image Image::Create(VkFormat format, VkImageTiling tiling, 
-											uint32_t width, uint32_t height,  Device* device, const VkAllocationCallbacks* allocator)
+											uint32_t width, uint32_t height,  Device* device, const VkAllocationCallbacks* allocator, uint32_t layerCount,
+											VkImageUsageFlags usage)
 	{
 		const VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
@@ -26,11 +27,11 @@ namespace renderer::vulkan
 		info.extent.height = height;
 		info.extent.depth = 1;
 		info.mipLevels = 1;
-		info.arrayLayers = 1;
+		info.arrayLayers = layerCount;
 		info.format = format;
 		info.tiling = tiling;
 		info.imageType = VK_IMAGE_TYPE_2D;
-		info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		info.usage = usage;
 		info.initialLayout = initialLayout;
 		info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		info.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -45,8 +46,12 @@ namespace renderer::vulkan
 		VkMemoryRequirements requirements;
 		vkGetImageMemoryRequirements(*device, hwImage, &requirements);
 
-		return Image(device, width, height, requirements.size, hwImage, format, initialLayout,
-								 requirements.alignment, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, allocator);
+		Image image(device, width, height, requirements.size, hwImage, format, initialLayout,
+								requirements.alignment, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, allocator);
+
+		image._layerCount = layerCount;
+
+		return image;
 	}
 
 	void Image::BindMemory(VkDeviceMemory memory, VkDeviceSize offsetInMemory)
@@ -59,12 +64,12 @@ namespace renderer::vulkan
 		VkImageViewCreateInfo viewInfo  {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
 		viewInfo.image = _hwImage;
 		viewInfo.format = _format;
-		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.viewType = _layerCount > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
 		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		viewInfo.subresourceRange.baseMipLevel = 0;
 		viewInfo.subresourceRange.levelCount = 1;
 		viewInfo.subresourceRange.baseArrayLayer = 0;
-		viewInfo.subresourceRange.layerCount = 1;
+		viewInfo.subresourceRange.layerCount = _layerCount;
 
 		if (vkCreateImageView(*_device, &viewInfo, _allocator, &_hwImageView) != VK_SUCCESS)
 		{
@@ -79,53 +84,9 @@ namespace renderer::vulkan
 	{
 		BeginSingleTimeCommand(commandBuffer);
 		{
-			VkImageMemoryBarrier barrier{};
-			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			barrier.oldLayout = _currentLayout;
-			barrier.newLayout = nextLayout;
-			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			barrier.image = _hwImage;
-			barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			barrier.subresourceRange.baseMipLevel = 0;
-			barrier.subresourceRange.levelCount = 1;
-			barrier.subresourceRange.baseArrayLayer = 0;
-			barrier.subresourceRange.layerCount = 1;
-			barrier.srcAccessMask = 0;
-			barrier.dstAccessMask = 0;
-
-			VkPipelineStageFlags sourceStage, destinationStage;
-
-			if (_currentLayout == VK_IMAGE_LAYOUT_UNDEFINED && nextLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
-			{
-				barrier.srcAccessMask = 0;
-				barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-				sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-				destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-			}
-			else if (_currentLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && nextLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-			{
-				barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-				sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-				destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-			}
-			else if (_currentLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL && nextLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
-			{
-				barrier.srcAccessMask = 0;
-				barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-				sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-				destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-			}
-			else
-			{
-				throw runtime_error("Unsupported layout transition");
-			}
-
-			_currentLayout = nextLayout;
+			VkPipelineStageFlags sourceStage = 0, destinationStage = 0;
+
+			auto barrier = TakeLayoutBarrier(nextLayout, sourceStage, destinationStage);
 
 			vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage, 0, 
 														0, VK_NULL_HANDLE,
@@ -136,6 +97,66 @@ namespace renderer::vulkan
 		EndSingleTimeCommandAndSubmit(commandBuffer, queue);
 	}
 
+	VkImageMemoryBarrier Image::TakeLayoutBarrier(VkImageLayout nextLayout, VkPipelineStageFlags& sourceStage, VkPipelineStageFlags& destinationStage)
+	{
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = _currentLayout;
+		barrier.newLayout = nextLayout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = _hwImage;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = _layerCount;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = 0;
+
+		if (_currentLayout == VK_IMAGE_LAYOUT_UNDEFINED && nextLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
+		{
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+			sourceStage |= VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+			destinationStage |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+		}
+		else if (_currentLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && nextLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+		{
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+			sourceStage |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+			destinationStage |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		}
+		else if (_currentLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL && nextLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
+		{
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+			// Frames in flight may still sample the image
+			sourceStage |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			destinationStage |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+		}
+		else if (_currentLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL && nextLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)
+		{
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+			sourceStage |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			destinationStage |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+		}
+		else
+		{
+			throw runtime_error("Unsupported layout transition");
+		}
+
+		_currentLayout = nextLayout;
+
+		return barrier;
+	}
+
 	void Image::BeginSingleTimeCommand(VkCommandBuffer commandBuffer)
 	{
 		VkCommandBufferBeginInfo beginInfo { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr,
@@ -174,6 +195,21 @@ namespace renderer::vulkan
 		return { _width, _height, 1 };
 	}
 
+	VkFormat Image::GetFormat() const
+	{
+		return _format;
+	}
+
+	uint32_t Image::GetLayerCount() const
+	{
+		return _layerCount;
+	}
+
+	VkImageLayout Image::GetLayout() const
+	{
+		return _currentLayout;
+	}
+
 	VkDeviceMemory Image::GetMemoryHandle() const
 	{
 		return _memory;
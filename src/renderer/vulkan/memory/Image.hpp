@@ -8,6 +8,8 @@ namespace renderer::vulkan
 {
 	const uint64_t IMAGE_WHOLE_SIZE = 0;
 
+	const VkImageUsageFlags TEXTURE_IMAGE_USAGE = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+
 	class Image
 	{
 	public:
@@ -17,17 +19,26 @@ namespace renderer::vulkan
 					VkFormat, VkImageLayout, VkDeviceSize alignment, 
 					VkMemoryPropertyFlagBits, const VkAllocationCallbacks*);
 
+		// Images of more than one layer are viewed as arrays
 		static Image Create(VkFormat format, VkImageTiling tiling, 
 												uint32_t width, uint32_t height,
-												Device*, const VkAllocationCallbacks*);
+												Device*, const VkAllocationCallbacks*, uint32_t layerCount = 1,
+												VkImageUsageFlags usage = TEXTURE_IMAGE_USAGE);
 
 		void BindMemory(VkDeviceMemory memory, VkDeviceSize offsetInMemory);
 		void TransitionImageLayout(VkImageLayout nextLayout, VkCommandBuffer, VkQueue);
 
+		// Barrier for recording the transition elsewhere, image is assumed to be
+		//  in the next layout afterwards. Stages are added to the given masks
+		VkImageMemoryBarrier TakeLayoutBarrier(VkImageLayout nextLayout, VkPipelineStageFlags& sourceStage, VkPipelineStageFlags& destinationStage);
+
 		VkDeviceSize GetMemoryAlignment() const;
 		VkDeviceSize GetSize() const;
 		VkMemoryPropertyFlagBits GetMemoryPropertyFlags() const;
 		VkExtent3D   GetExtents();
+		VkFormat     GetFormat() const;
+		uint32_t     GetLayerCount() const;
+		VkImageLayout GetLayout() const;
 
 		VkDeviceMemory GetMemoryHandle() const;
 		VkDeviceSize   GetMemoryOffset() const;
@@ -46,7 +57,7 @@ namespace renderer::vulkan
 		void EndSingleTimeCommandAndSubmit(VkCommandBuffer, VkQueue);
 
 		VkFormat       _format;
-		uint32_t       _width, _height, _pixelSize;
+		uint32_t       _width, _height, _pixelSize, _layerCount = 1;
 		Device*        _device = VK_NULL_HANDLE;
 		VkDeviceSize   _size = 0, _alignment = 0, _offsetInMemory = 0;
 		VkImage        _hwImage = VK_NULL_HANDLE;
@@ -1,84 +1,185 @@
 #include "MemoryManager.hpp"
 #include "Image.hpp"
-#include "data/Common.hpp"
 
 #include <algorithm>
-#include <cassert>
 #include <stdexcept>
 
 namespace renderer::vulkan
 {
 	using std::runtime_error;
-	using Region = MemoryRegion;
 
 	MemoryManager::MemoryManager() {}
 
-	MemoryManager::MemoryManager(Device* device, const VkAllocationCallbacks* allocator)
-		: _device(device), _allocator(allocator) {}
+	MemoryManager::MemoryManager(Device* device, const VkAllocationCallbacks* allocator, MemoryConfig config)
+		: _device(device), _allocator(allocator), _config(config) {}
 
 	void MemoryManager::BindMemoryToBuffer(Buffer& buffer, VkMemoryRequirements& requirements, VkMemoryPropertyFlagBits properties)
 	{
-		auto [requiredSize, alignment, typeBits] = requirements;
+		auto [memory, offset] = Allocate(requirements, properties);
 
-		auto& memory        = UseMemory(alignment, typeBits, properties, requiredSize);
-		auto [offset, size] = memory.GetNewLockedRegion(alignment, requiredSize);
+		buffer.BindMemory(memory, offset);
 
-		assert(size == requiredSize);
-
-		buffer.BindMemory(memory.hwMemory, offset);
+		FindMemory(memory).bufferCount++;
 	}
 
 	void MemoryManager::BindMemoryToImage(Image& image, VkMemoryRequirements& requirements, VkMemoryPropertyFlagBits properties)
 	{
-		auto [requiredSize, alignment, typeBits] = requirements;
+		auto [memory, offset] = Allocate(requirements, properties);
+
+		image.BindMemory(memory, offset);
+	}
+
+	void MemoryManager::BindDedicatedMemoryToImage(Image& image, VkMemoryRequirements& requirements, VkMemoryPropertyFlagBits properties)
+	{
+		auto [size, alignment, typeBits] = requirements;
+
+		image.BindMemory(AllocateMemory(FindMemoryType(typeBits, properties), size, true).hwMemory, 0);
+	}
+
+	void MemoryManager::Free(Image* image)
+	{
+		Free(image->GetMemoryHandle(), image->GetMemoryOffset());
+	}
+
+	void MemoryManager::Free(Buffer* buffer)
+	{
+		FindMemory(buffer->GetMemoryHandle()).bufferCount--;
+
+		Free(buffer->GetMemoryHandle(), buffer->GetMemoryOffset());
+	}
+
+	VkDeviceMemory MemoryManager::FindDefragmentationSource() const
+	{
+		const Memory* source = nullptr;
 
-		if (requiredSize > MinimalMemorySize)
+		for(auto& memory : _memories)
 		{
-			throw runtime_error("Memory size is too high!");
+			if (memory.dedicated || memory.bufferCount > 0 || memory.allocator.IsEmpty())
+				continue;
+
+			VkDeviceSize freeElsewhere = 0;
+
+			for(auto& other : _memories)
+			{
+				if (&other != &memory && !other.dedicated && other.typeIndex == memory.typeIndex)
+					freeElsewhere += other.size - other.allocator.GetUsedSize();
+			}
+
+			auto usedSize = memory.allocator.GetUsedSize();
+
+			if (usedSize > freeElsewhere)
+				continue;
+
+			if (source == nullptr || usedSize < source->allocator.GetUsedSize())
+				source = &memory;
 		}
 
-		auto& memory        = UseMemory(alignment, typeBits, properties, requiredSize);
-		auto [offset, size] = memory.GetNewLockedRegion(alignment, requiredSize);
+		return source != nullptr ? source->hwMemory : VK_NULL_HANDLE;
+	}
+
+	bool MemoryManager::BindMemoryToImageOutside(Image& image, VkMemoryRequirements& requirements, VkMemoryPropertyFlagBits properties, VkDeviceMemory excluded)
+	{
+		auto [size, alignment, typeBits] = requirements;
 
-		assert(size == requiredSize);
+		auto [memory, offset] = AllocateInBlocks(FindMemoryType(typeBits, properties), size, alignment, excluded);
 
-		image.BindMemory(memory.hwMemory, offset);
+		if (memory == VK_NULL_HANDLE)
+		{
+			return false;
+		}
+
+		image.BindMemory(memory, offset);
+
+		return true;
 	}
 
-	void MemoryManager::Free(Image* image)
+	std::pair<VkDeviceMemory, VkDeviceSize> MemoryManager::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlagBits properties)
+	{
+		auto [size, alignment, typeBits] = requirements;
+
+		auto typeIndex = FindMemoryType(typeBits, properties);
+
+		// Host visible memory is mapped whole by its buffer, so it can't be shared
+		if (size >= _config.dedicatedThreshold || (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+		{
+			return { AllocateMemory(typeIndex, size, true).hwMemory, 0 };
+		}
+
+		auto allocation = AllocateInBlocks(typeIndex, size, alignment, VK_NULL_HANDLE);
+
+		if (allocation.first != VK_NULL_HANDLE)
+		{
+			return allocation;
+		}
+
+		auto& memory = AllocateMemory(typeIndex, std::max(_config.blockSize, size), false);
+		auto  offset = memory.allocator.Allocate(size, alignment);
+
+		return { memory.hwMemory, offset };
+	}
+
+	std::pair<VkDeviceMemory, VkDeviceSize> MemoryManager::AllocateInBlocks(uint32_t typeIndex, VkDeviceSize size, VkDeviceSize alignment, VkDeviceMemory excluded)
 	{
-		auto memoryHandle = image->GetMemoryHandle();
-		auto memoryOffset = image->GetMemoryOffset();
-		auto memorySize   = image->GetSize();
+		for(auto& memory : _memories)
+		{
+			if (memory.dedicated || memory.typeIndex != typeIndex || memory.hwMemory == excluded)
+				continue;
 
-		auto& memory = *std::find_if(_memories.begin(), _memories.end(), [memoryHandle] (auto mem) {
+			auto offset = memory.allocator.Allocate(size, alignment);
+
+			if (offset != TlsfAllocator::NoSpace)
+			{
+				return { memory.hwMemory, offset };
+			}
+		}
+
+		return { VK_NULL_HANDLE, 0 };
+	}
+
+	Memory& MemoryManager::FindMemory(VkDeviceMemory memoryHandle)
+	{
+		auto memoryIt = std::find_if(_memories.begin(), _memories.end(), [memoryHandle] (auto& mem) {
 			return mem.hwMemory == memoryHandle;
 		});
 
-		memory.UnlockMemory(memoryOffset, memorySize);
+		if (memoryIt == _memories.end())
+		{
+			throw runtime_error("Failed to find memory");
+		}
+
+		return *memoryIt;
 	}
 
-	Memory& MemoryManager::UseMemory(VkDeviceSize alignment, uint32_t typeBits, VkMemoryPropertyFlagBits properties, VkDeviceSize requiredSize)
+	void MemoryManager::Free(VkDeviceMemory memoryHandle, VkDeviceSize offset)
 	{
-		// Find if memory with this specific properties already exists
-		auto memoryIt = std::find_if(_memories.begin(), _memories.end(), 
-			[alignment, typeBits, properties, requiredSize] (auto& mem) { 
-				return mem.typeBits == typeBits && 
-							mem.properties == properties && 
-							mem.CanAllocateMemory(alignment, requiredSize); 
-				});
+		auto& memory = FindMemory(memoryHandle);
 
-		if (memoryIt != _memories.end())
+		if (!memory.dedicated)
 		{
-			return *memoryIt;
+			memory.allocator.Free(offset);
+
+			// One empty block of a type is kept for the next resources, e.g. of the next map
+			auto typeIndex = memory.typeIndex;
+
+			bool hasOtherBlock = std::any_of(_memories.begin(), _memories.end(), [memoryHandle, typeIndex] (auto& mem) {
+				return !mem.dedicated && mem.typeIndex == typeIndex && mem.hwMemory != memoryHandle;
+			});
+
+			if (!memory.allocator.IsEmpty() || !hasOtherBlock)
+				return;
 		}
 
-		auto typeIndex = FindMemoryType(typeBits, properties);
+		vkFreeMemory(*_device, memoryHandle, _allocator);
+
+		std::erase_if(_memories, [memoryHandle] (auto& mem) { return mem.hwMemory == memoryHandle; });
+	}
 
+	Memory& MemoryManager::AllocateMemory(uint32_t typeIndex, VkDeviceSize size, bool dedicated)
+	{
 		VkMemoryAllocateInfo allocInfo { 
 			.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, 
 			.pNext = nullptr, 
-			.allocationSize = MinimalMemorySize, 
+			.allocationSize = size, 
 			.memoryTypeIndex = typeIndex };
 
 		VkDeviceMemory memory;
@@ -88,9 +189,7 @@ namespace renderer::vulkan
 			throw runtime_error("Failed to allocate memory");
 		}
 
-		std::vector<MemoryRegion> memoryRegions = { { 0, allocInfo.allocationSize } };
-
-		_memories.emplace_back(typeBits, properties, memory, memoryRegions);
+		_memories.push_back({ typeIndex, memory, size, dedicated, dedicated ? TlsfAllocator() : TlsfAllocator(size) });
 
 		return _memories.back();
 	}
@@ -103,7 +202,7 @@ namespace renderer::vulkan
 		for (uint32_t i = 0; i < memProps.memoryTypeCount; i++)
 		{
 			auto memoryType = memProps.memoryTypes[i];
-			bool hasSuitableProps = memoryType.propertyFlags & properties;
+			bool hasSuitableProps = (memoryType.propertyFlags & properties) == properties;
 
 			if (typeFilter & (1 << i) && hasSuitableProps)
 			{
@@ -114,84 +213,67 @@ namespace renderer::vulkan
 		throw runtime_error("Failed to find suitable memory type");
 	}
 
-	bool Memory::CanAllocateMemory(VkDeviceSize alignment, VkDeviceSize requiredSize)
+	MemoryStatistics MemoryManager::GetStatistics() const
 	{
-		return std::any_of(freeRegions.begin(), freeRegions.end(), [alignment, requiredSize] (auto region) {
+		MemoryStatistics statistics;
 
-			auto [offset, regionSize] = region;
-			auto alignedOffset = data::Aligned(offset, alignment);
-			auto localOffset = alignedOffset - offset;
-
-			return localOffset + requiredSize <= regionSize;
-		});
-	}
-
-	MemoryRegion Memory::GetNewLockedRegion(VkDeviceSize alignment, VkDeviceSize allocatedSize)
-	{
-		auto it = std::find_if(freeRegions.begin(), freeRegions.end(), [alignment, allocatedSize] (auto region) {
-
-			auto [offset, regionSize] = region;
-			auto alignedOffset = data::Aligned(offset, alignment);
-			auto localOffset = alignedOffset - offset;
-
-			return localOffset + allocatedSize <= regionSize;
-		});
-
-		if (it == freeRegions.end())
+		for(auto& memory : _memories)
 		{
-			throw runtime_error("Failed to find any memory for buffer");
-		}
-
-		auto [offset, space] = *it;
+			statistics.reservedSize += memory.size;
 
-		freeRegions.erase(it);
-
-		auto alignedOffset = data::Aligned(offset, alignment);
-		auto trailingSpace = alignedOffset - offset;
+			if (memory.dedicated)
+			{
+				statistics.dedicatedCount++;
+				statistics.allocationCount++;
+				statistics.usedSize += memory.size;
 
-		if (trailingSpace > 0)
-			freeRegions.push_back( { offset, trailingSpace });
+				continue;
+			}
 
-		auto headingSpace = space - (allocatedSize + trailingSpace);
+			auto info = memory.allocator.GetFreeSpaceInfo();
 
-		if (headingSpace > 0)
-			freeRegions.push_back( { alignedOffset + allocatedSize, headingSpace } );
+			statistics.blockCount++;
+			statistics.usedSize          += memory.allocator.GetUsedSize();
+			statistics.allocationCount   += info.allocationCount;
+			statistics.freeRegionCount   += info.freeRegionCount;
+			statistics.freeSize          += info.freeSize;
+			statistics.largestFreeRegion  = std::max(statistics.largestFreeRegion, info.largestFreeRegion);
+		}
 
-		// Offset must be aligned
-		return { alignedOffset, allocatedSize };
+		return statistics;
 	}
 
-	void Memory::UnlockMemory(VkDeviceSize offset, VkDeviceSize size)
+	VkDeviceSize MemoryManager::GetReservedSize() const
 	{
-		freeRegions.emplace_back(offset, size);
+		VkDeviceSize size = 0;
 
-    // Merge connecting regions
-    std::sort(freeRegions.begin(), freeRegions.end(), [](auto a, auto b) {
-        return a.offset < b.offset || (a.offset == b.offset && a.size < b.size);
-    });
+		for(auto& memory : _memories)
+		{
+			size += memory.size;
+		}
 
-    std::vector<Region> merged;
-    Region current = freeRegions[0];
+		return size;
+	}
 
-    for (size_t i = 1; i < freeRegions.size(); ++i) {
-        if (freeRegions[i].offset <= current.end()) {
-            current.size = std::max(current.end(), freeRegions[i].end()) - current.offset;
-        } else {
-            merged.push_back(current);
-            current = freeRegions[i];
-        }
-    }
+	VkDeviceSize MemoryManager::GetUsedSize() const
+	{
+		VkDeviceSize size = 0;
 
-    merged.push_back(current);
+		for(auto& memory : _memories)
+		{
+			size += memory.dedicated ? memory.size : memory.allocator.GetUsedSize();
+		}
 
-		freeRegions = std::move(merged);
+		return size;
 	}
 
 	void MemoryManager::Release()
 	{
-		for(auto memory : _memories)
+		for(auto& memory : _memories)
 		{
 			vkFreeMemory(*_device, memory.hwMemory, _allocator);
 		}
+
+		_memories.clear();
 	}
-};
\ No newline at end of file
+};
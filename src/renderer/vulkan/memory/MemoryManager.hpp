@@ -1,36 +1,48 @@
 #pragma once
 
+#include <utility>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
 #include "../device/Device.hpp"
 #include "Buffer.hpp"
 #include "Image.hpp"
+#include "TlsfAllocator.hpp"
 
 namespace renderer::vulkan
 {
 	const VkDeviceSize MinimalMemorySize = 1024 * 10000;
 
-	struct MemoryRegion
+	struct MemoryConfig
 	{
-		VkDeviceSize offset, size;
+		// Size of memory blocks shared by smaller resources
+		VkDeviceSize blockSize = MinimalMemorySize;
 
-		inline VkDeviceSize end() const { return offset + size; }
+		// Resources at least this big get memory of their own
+		VkDeviceSize dedicatedThreshold = MinimalMemorySize / 2;
 	};
 
-	struct Memory
+	struct MemoryStatistics
 	{
-		uint32_t typeBits;
-		VkMemoryPropertyFlagBits properties;
-		VkDeviceMemory hwMemory;
+		uint32_t     blockCount = 0, dedicatedCount = 0, allocationCount = 0, freeRegionCount = 0;
+		VkDeviceSize reservedSize = 0, usedSize = 0, freeSize = 0, largestFreeRegion = 0;
 
-		std::vector<MemoryRegion> freeRegions;
+		// 0 when free space of blocks is in one region, close to 1 when it's scattered
+		float GetFragmentation() const { return freeSize == 0 ? 0.0f : 1.0f - float(largestFreeRegion) / freeSize; }
+	};
 
-		MemoryRegion GetNewLockedRegion(VkDeviceSize alignment, VkDeviceSize size);
+	struct Memory
+	{
+		uint32_t       typeIndex;
+		VkDeviceMemory hwMemory;
+		VkDeviceSize   size;
+		bool           dedicated;
 
-		bool CanAllocateMemory(VkDeviceSize alignment, VkDeviceSize size);
+		// Unused by dedicated memory
+		TlsfAllocator  allocator;
 
-		void UnlockMemory(VkDeviceSize offset, VkDeviceSize size);
+		// Buffers aren't moved by defragmentation, they pin the block
+		uint32_t       bufferCount = 0;
 	};
 
 	class MemoryManager
@@ -38,26 +50,52 @@ namespace renderer::vulkan
 	public:
 
 		MemoryManager();
-		MemoryManager(Device*, const VkAllocationCallbacks*);
+		MemoryManager(Device*, const VkAllocationCallbacks*, MemoryConfig = {});
 
 		void BindMemoryToBuffer(Buffer& buffer, VkMemoryRequirements& requirements, VkMemoryPropertyFlagBits);
 		void BindMemoryToImage(Image& image, VkMemoryRequirements& requirements, VkMemoryPropertyFlagBits);
+
+		// Memory of the image alone, no block is pinned by it
+		void BindDedicatedMemoryToImage(Image& image, VkMemoryRequirements& requirements, VkMemoryPropertyFlagBits);
 		
 		void Free(Image*);
+		void Free(Buffer*);
+
+		// Block worth emptying: images of the sparsest one fit into other blocks
+		//  of its type. Null handle if there's none
+		VkDeviceMemory FindDefragmentationSource() const;
+
+		// Binds image to a block other than excluded one, never allocates a new block.
+		//  False if there's no space
+		bool BindMemoryToImageOutside(Image&, VkMemoryRequirements&, VkMemoryPropertyFlagBits, VkDeviceMemory excluded);
+
+		MemoryStatistics GetStatistics() const;
+
+		// Cheap parts of statistics: device memory allocated and the part of it in use
+		VkDeviceSize GetReservedSize() const;
+		VkDeviceSize GetUsedSize() const;
 
 		void Release();
 
 	private:
-	
-		Memory&  UseMemory(VkDeviceSize alignment, uint32_t typeBits, VkMemoryPropertyFlagBits, VkDeviceSize size);
+
+		std::pair<VkDeviceMemory, VkDeviceSize> Allocate(const VkMemoryRequirements&, VkMemoryPropertyFlagBits);
+
+		// Suballocation in existing blocks of the type, null handle if none has space
+		std::pair<VkDeviceMemory, VkDeviceSize> AllocateInBlocks(uint32_t typeIndex, VkDeviceSize size, VkDeviceSize alignment, VkDeviceMemory excluded);
+		void Free(VkDeviceMemory, VkDeviceSize offset);
+
+		Memory&  AllocateMemory(uint32_t typeIndex, VkDeviceSize size, bool dedicated);
+		Memory&  FindMemory(VkDeviceMemory);
 		uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags);
 
 	private:
 	
 		const VkAllocationCallbacks* _allocator;
 
-		Device* _device;
+		Device*      _device;
+		MemoryConfig _config;
 
 		std::vector<Memory> _memories;
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,299 @@
+#include "TlsfAllocator.hpp"
+#include "data/Common.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+namespace renderer::vulkan
+{
+	using std::runtime_error;
+
+	TlsfAllocator::TlsfAllocator() : TlsfAllocator(0) {}
+
+	TlsfAllocator::TlsfAllocator(VkDeviceSize size) : _size(size)
+	{
+		for(auto& lists : _freeLists)
+		{
+			lists.fill(NoRegion);
+		}
+
+		if (size > 0)
+		{
+			auto region = NewRegion();
+			_regions[region].size = size;
+
+			InsertFree(region);
+		}
+	}
+
+	TlsfAllocator::SizeClass TlsfAllocator::TakeSizeClass(VkDeviceSize size)
+	{
+		// Small sizes get a list each
+		if (size < SubLevelCount)
+		{
+			return { 0, static_cast<uint32_t>(size) };
+		}
+
+		uint32_t highBit = std::bit_width(size) - 1;
+
+		return { highBit - SubLevelBits + 1, static_cast<uint32_t>(size >> (highBit - SubLevelBits)) - SubLevelCount };
+	}
+
+	TlsfAllocator::SizeClass TlsfAllocator::TakeSearchClass(VkDeviceSize size)
+	{
+		if (size >= SubLevelCount)
+		{
+			uint32_t highBit = std::bit_width(size) - 1;
+
+			size += (VkDeviceSize(1) << (highBit - SubLevelBits)) - 1;
+		}
+
+		return TakeSizeClass(size);
+	}
+
+	uint32_t TlsfAllocator::FindFreeRegion(VkDeviceSize size)
+	{
+		auto [level, subLevel] = TakeSearchClass(size);
+
+		if (level >= LevelCount)
+		{
+			return NoRegion;
+		}
+
+		uint32_t subLevelMap = _subLevelMaps[level] & (~0u << subLevel);
+
+		if (subLevelMap == 0)
+		{
+			uint64_t levelMap = level + 1 < LevelCount ? _levelMap & (~0ull << (level + 1)) : 0;
+
+			if (levelMap == 0)
+			{
+				return NoRegion;
+			}
+
+			level       = std::countr_zero(levelMap);
+			subLevelMap = _subLevelMaps[level];
+		}
+
+		return _freeLists[level][std::countr_zero(subLevelMap)];
+	}
+
+	VkDeviceSize TlsfAllocator::Allocate(VkDeviceSize size, VkDeviceSize alignment)
+	{
+		size      = std::max<VkDeviceSize>(size, 1);
+		alignment = std::max<VkDeviceSize>(alignment, 1);
+
+		auto fits = [this, size, alignment] (uint32_t region) {
+			auto& candidate = _regions[region];
+			return data::Aligned(candidate.offset, alignment) - candidate.offset + size <= candidate.size;
+		};
+
+		// Region found for size alone is usually aligned well enough already
+		uint32_t region = FindFreeRegion(size);
+
+		if (region == NoRegion || !fits(region))
+		{
+			region = FindFreeRegion(size + alignment - 1);
+		}
+
+		if (region == NoRegion)
+		{
+			return NoSpace;
+		}
+
+		RemoveFree(region);
+
+		auto offset  = _regions[region].offset;
+		auto padding = data::Aligned(offset, alignment) - offset;
+
+		// Neighbours of a free region are in use, so the cut offs don't need merging
+		if (padding > 0)
+		{
+			auto aligned = Split(region, padding);
+
+			InsertFree(region);
+			region = aligned;
+		}
+
+		if (_regions[region].size > size)
+		{
+			InsertFree(Split(region, size));
+		}
+
+		_allocations.emplace(_regions[region].offset, region);
+		_usedSize += size;
+
+		return _regions[region].offset;
+	}
+
+	void TlsfAllocator::Free(VkDeviceSize offset)
+	{
+		auto it = _allocations.find(offset);
+
+		if (it == _allocations.end())
+		{
+			throw runtime_error("Freed memory was not allocated");
+		}
+
+		uint32_t region = it->second;
+		_allocations.erase(it);
+
+		_usedSize -= _regions[region].size;
+
+		auto next = _regions[region].next;
+
+		if (next != NoRegion && _regions[next].free)
+		{
+			RemoveFree(next);
+			Merge(region);
+		}
+
+		auto previous = _regions[region].previous;
+
+		if (previous != NoRegion && _regions[previous].free)
+		{
+			RemoveFree(previous);
+			Merge(previous);
+
+			region = previous;
+		}
+
+		InsertFree(region);
+	}
+
+	FreeSpaceInfo TlsfAllocator::GetFreeSpaceInfo() const
+	{
+		FreeSpaceInfo info;
+
+		info.allocationCount = _allocations.size();
+
+		if (_regions.empty())
+		{
+			return info;
+		}
+
+		// First region never merges into another one
+		for(uint32_t region = 0; region != NoRegion; region = _regions[region].next)
+		{
+			auto& current = _regions[region];
+
+			if (current.free)
+			{
+				info.freeSize         += current.size;
+				info.largestFreeRegion = std::max(info.largestFreeRegion, current.size);
+				info.freeRegionCount++;
+			}
+		}
+
+		return info;
+	}
+
+	void TlsfAllocator::InsertFree(uint32_t region)
+	{
+		auto [level, subLevel] = TakeSizeClass(_regions[region].size);
+		auto& head = _freeLists[level][subLevel];
+
+		_regions[region].free         = true;
+		_regions[region].previousFree = NoRegion;
+		_regions[region].nextFree     = head;
+
+		if (head != NoRegion)
+		{
+			_regions[head].previousFree = region;
+		}
+
+		head = region;
+
+		_subLevelMaps[level] |= 1u << subLevel;
+		_levelMap            |= 1ull << level;
+	}
+
+	void TlsfAllocator::RemoveFree(uint32_t region)
+	{
+		auto& current = _regions[region];
+		auto [level, subLevel] = TakeSizeClass(current.size);
+
+		if (current.previousFree != NoRegion)
+		{
+			_regions[current.previousFree].nextFree = current.nextFree;
+		}
+		else
+		{
+			_freeLists[level][subLevel] = current.nextFree;
+		}
+
+		if (current.nextFree != NoRegion)
+		{
+			_regions[current.nextFree].previousFree = current.previousFree;
+		}
+
+		if (_freeLists[level][subLevel] == NoRegion)
+		{
+			_subLevelMaps[level] &= ~(1u << subLevel);
+
+			if (_subLevelMaps[level] == 0)
+				_levelMap &= ~(1ull << level);
+		}
+
+		current.free = false;
+		current.previousFree = current.nextFree = NoRegion;
+	}
+
+	uint32_t TlsfAllocator::Split(uint32_t region, VkDeviceSize size)
+	{
+		// Might move the regions, so nothing is referenced before
+		auto tail = NewRegion();
+
+		auto& head = _regions[region];
+		auto& rest = _regions[tail];
+
+		rest.offset   = head.offset + size;
+		rest.size     = head.size - size;
+		rest.previous = region;
+		rest.next     = head.next;
+
+		if (head.next != NoRegion)
+		{
+			_regions[head.next].previous = tail;
+		}
+
+		head.next = tail;
+		head.size = size;
+
+		return tail;
+	}
+
+	void TlsfAllocator::Merge(uint32_t region)
+	{
+		auto& current = _regions[region];
+		auto  next    = current.next;
+
+		current.size += _regions[next].size;
+		current.next  = _regions[next].next;
+
+		if (current.next != NoRegion)
+		{
+			_regions[current.next].previous = region;
+		}
+
+		_unusedRegions.push_back(next);
+	}
+
+	uint32_t TlsfAllocator::NewRegion()
+	{
+		if (!_unusedRegions.empty())
+		{
+			auto region = _unusedRegions.back();
+			_unusedRegions.pop_back();
+
+			_regions[region] = {};
+
+			return region;
+		}
+
+		_regions.emplace_back();
+
+		return _regions.size() - 1;
+	}
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace renderer::vulkan
+{
+	// Free space of a memory block, for fragmentation statistics
+	struct FreeSpaceInfo
+	{
+		VkDeviceSize freeSize = 0, largestFreeRegion = 0;
+		uint32_t     freeRegionCount = 0, allocationCount = 0;
+	};
+
+	// Two level segregated fit allocator of offsets inside one memory block.
+	//  Allocation and free take constant time: free regions are kept in lists
+	//  by size class, bitmaps tell which lists aren't empty
+	class TlsfAllocator
+	{
+	public:
+
+		static constexpr VkDeviceSize NoSpace = UINT64_MAX;
+
+		TlsfAllocator();
+		TlsfAllocator(VkDeviceSize size);
+
+		// Aligned offset of the region, NoSpace if there's no free region big enough
+		VkDeviceSize Allocate(VkDeviceSize size, VkDeviceSize alignment);
+
+		void Free(VkDeviceSize offset);
+
+		bool IsEmpty() const { return _allocations.empty(); }
+
+		VkDeviceSize  GetSize() const { return _size; }
+		VkDeviceSize  GetUsedSize() const { return _usedSize; }
+		FreeSpaceInfo GetFreeSpaceInfo() const;
+
+	private:
+
+		// Every size class of a power of two is split into 2^SubLevelBits lists
+		static constexpr uint32_t SubLevelBits  = 5;
+		static constexpr uint32_t SubLevelCount = 1 << SubLevelBits;
+		static constexpr uint32_t LevelCount    = 64 - SubLevelBits + 1;
+
+		static constexpr uint32_t NoRegion = UINT32_MAX;
+
+		// Regions follow each other in memory order, free ones are also linked in their list
+		struct Region
+		{
+			VkDeviceSize offset = 0, size = 0;
+			uint32_t     previous = NoRegion, next = NoRegion;
+			uint32_t     previousFree = NoRegion, nextFree = NoRegion;
+			bool         free = false;
+		};
+
+		struct SizeClass
+		{
+			uint32_t level, subLevel;
+		};
+
+		static SizeClass TakeSizeClass(VkDeviceSize size);
+
+		// Smallest class whose regions all hold size bytes
+		static SizeClass TakeSearchClass(VkDeviceSize size);
+
+		uint32_t FindFreeRegion(VkDeviceSize size);
+
+		void InsertFree(uint32_t region);
+		void RemoveFree(uint32_t region);
+
+		// New region of size bytes cut off the end of region
+		uint32_t Split(uint32_t region, VkDeviceSize size);
+
+		// Merges region with the next one, the next one is recycled
+		void Merge(uint32_t region);
+
+		uint32_t NewRegion();
+
+	private:
+
+		VkDeviceSize _size = 0, _usedSize = 0;
+
+		std::vector<Region>   _regions;
+		std::vector<uint32_t> _unusedRegions;
+
+		uint64_t                                                _levelMap = 0;
+		std::array<uint32_t, LevelCount>                        _subLevelMaps {};
+		std::array<std::array<uint32_t, SubLevelCount>, LevelCount> _freeLists;
+
+		// Region index by offset of allocations
+		std::unordered_map<VkDeviceSize, uint32_t> _allocations;
+	};
+}
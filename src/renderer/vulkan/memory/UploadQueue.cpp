@@ -0,0 +1,423 @@
+#include "UploadQueue.hpp"
+#include "../Command.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vulkan/vulkan_core.h>
+
+#include <data/Common.hpp>
+
+namespace renderer::vulkan
+{
+	using std::runtime_error;
+	using data::Aligned;
+
+	// Satisfies copy offset requirements of every texel size in use
+	const VkDeviceSize stagingAlignment = 16;
+
+	UploadQueue::UploadQueue() {}
+
+	UploadQueue::UploadQueue(Device* device, VkQueue queue, VkCommandPool commandPool)
+		: _device(device), _queue(queue), _commandPool(commandPool)
+		{}
+
+	void UploadQueue::Initialize(Buffer stagingBuffer)
+	{
+		_stagingBuffer = stagingBuffer;
+
+		void* memory;
+		_stagingBuffer.MapMemory(&memory);
+
+		_stagingMemory = reinterpret_cast<uint8_t*>(memory);
+	}
+
+	static bool RegionsOverlap(const VkBufferImageCopy& region, VkOffset3D offset, VkExtent3D extent, uint32_t layer)
+	{
+		if (region.imageSubresource.baseArrayLayer != layer)
+			return false;
+
+		auto x = region.imageOffset.x, y = region.imageOffset.y;
+		auto width = static_cast<int32_t>(region.imageExtent.width), height = static_cast<int32_t>(region.imageExtent.height);
+
+		return x < offset.x + static_cast<int32_t>(extent.width)  && offset.x < x + width &&
+					 y < offset.y + static_cast<int32_t>(extent.height) && offset.y < y + height;
+	}
+
+	void UploadQueue::UploadImage(Image* image, const void* data, VkOffset3D offset, VkExtent3D extent, uint32_t pixelSize, uint32_t rowStride, uint32_t layer)
+	{
+		const VkDeviceSize rowSize = static_cast<VkDeviceSize>(extent.width) * pixelSize;
+		const VkDeviceSize stride  = rowStride == 0 ? rowSize : rowStride;
+		const VkDeviceSize maxRows = _stagingBuffer.GetSize() / 2 / rowSize;
+
+		if (maxRows == 0)
+		{
+			throw runtime_error("Failed to upload image: row exceeds staging buffer");
+		}
+
+		// Copies inside one batch aren't ordered between each other
+		bool overlaps = std::any_of(_imageCopies.begin(), _imageCopies.end(), [image, offset, extent, layer] (auto& copy) {
+			return copy.image == image && RegionsOverlap(copy.region, offset, extent, layer);
+		});
+
+		if (overlaps)
+		{
+			Flush();
+		}
+
+		auto bytes = reinterpret_cast<const uint8_t*>(data);
+
+		for(uint32_t row = 0; row < extent.height;)
+		{
+			const uint32_t rows = static_cast<uint32_t>(std::min<VkDeviceSize>(maxRows, extent.height - row));
+			const VkDeviceSize size = rowSize * rows;
+
+			auto stagingOffset = Reserve(size);
+
+			if (stride == rowSize)
+			{
+				memcpy(_stagingMemory + stagingOffset, bytes + row * rowSize, size);
+			}
+			else
+			{
+				// Padded rows are packed on the way to staging
+				for(uint32_t i = 0; i < rows; i++)
+					memcpy(_stagingMemory + stagingOffset + i * rowSize, bytes + (row + i) * stride, rowSize);
+			}
+
+			VkBufferImageCopy region = {};
+
+			region.bufferOffset = stagingOffset;
+
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = 0;
+			region.imageSubresource.baseArrayLayer = layer;
+			region.imageSubresource.layerCount = 1;
+
+			region.imageOffset = { offset.x, offset.y + static_cast<int32_t>(row), offset.z };
+			region.imageExtent = { extent.width, rows, 1 };
+
+			_imageCopies.push_back({ image, region });
+
+			row += rows;
+		}
+	}
+
+	void UploadQueue::UploadBuffer(Buffer* buffer, const void* data, VkDeviceSize size, VkDeviceSize offset)
+	{
+		const VkDeviceSize maxChunk = _stagingBuffer.GetSize() / 2;
+
+		bool overlaps = std::any_of(_bufferCopies.begin(), _bufferCopies.end(), [buffer, size, offset] (auto& copy) {
+			return copy.buffer == buffer && copy.region.dstOffset < offset + size && offset < copy.region.dstOffset + copy.region.size;
+		});
+
+		if (overlaps)
+		{
+			Flush();
+		}
+
+		auto bytes = reinterpret_cast<const uint8_t*>(data);
+
+		for(VkDeviceSize done = 0; done < size;)
+		{
+			const VkDeviceSize chunk = std::min(maxChunk, size - done);
+
+			auto stagingOffset = Reserve(chunk);
+
+			memcpy(_stagingMemory + stagingOffset, bytes + done, chunk);
+
+			_bufferCopies.push_back({ buffer, { stagingOffset, offset + done, chunk } });
+
+			done += chunk;
+		}
+	}
+
+	void UploadQueue::MoveImage(Image source, Image* destination)
+	{
+		_imageMoves.push_back({ source, destination });
+	}
+
+	void UploadQueue::Cancel(Image* image)
+	{
+		std::erase_if(_imageCopies, [image] (auto& copy) { return copy.image == image; });
+		std::erase_if(_imageMoves, [image] (auto& move) { return move.destination == image; });
+	}
+
+	void UploadQueue::Cancel(Buffer* buffer)
+	{
+		std::erase_if(_bufferCopies, [buffer] (auto& copy) { return copy.buffer == buffer; });
+	}
+
+	uploadTicket UploadQueue::Flush()
+	{
+		// Cancelled copies still hold staging memory, their batch releases it
+		if (_pendingBytes == 0 && _imageMoves.empty())
+			return _lastTicket;
+
+		Batch batch = TakeFreeBatch();
+
+		VkCommandBufferBeginInfo beginInfo { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr,
+			 VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT };
+
+		vkResetCommandBuffer(batch.commandBuffer, 0);
+		vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+
+		// Kept between flushes, so steady streaming doesn't allocate
+		auto& images   = _batchImages;
+		auto& barriers = _barriers;
+
+		images.clear();
+		barriers.clear();
+
+		for(auto& copy : _imageCopies)
+		{
+			if (std::find(images.begin(), images.end(), copy.image) == images.end())
+				images.push_back(copy.image);
+		}
+
+		for(auto& move : _imageMoves)
+		{
+			images.push_back(move.destination);
+		}
+
+		VkPipelineStageFlags sourceStage = 0, destinationStage = 0;
+
+		for(auto image : images)
+		{
+			barriers.push_back(image->TakeLayoutBarrier(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, sourceStage, destinationStage));
+		}
+
+		for(auto& move : _imageMoves)
+		{
+			barriers.push_back(move.source.TakeLayoutBarrier(VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, sourceStage, destinationStage));
+		}
+
+		// Rows of shared buffers are rewritten while frames in flight may still read them
+		if (!_bufferCopies.empty())
+		{
+			sourceStage |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+			destinationStage |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+		}
+
+		if (sourceStage != 0)
+		{
+			vkCmdPipelineBarrier(batch.commandBuffer, sourceStage, destinationStage, 0,
+														0, VK_NULL_HANDLE,
+														0, VK_NULL_HANDLE,
+														barriers.size(), barriers.data());
+		}
+
+		for(auto& copy : _imageCopies)
+		{
+			vkCmdCopyBufferToImage(batch.commandBuffer, _stagingBuffer.GetHandle(), copy.image->GetHandle(),
+														 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy.region);
+		}
+
+		for(auto& copy : _bufferCopies)
+		{
+			vkCmdCopyBuffer(batch.commandBuffer, _stagingBuffer.GetHandle(), copy.buffer->GetHandle(), 1, &copy.region);
+		}
+
+		for(auto& move : _imageMoves)
+		{
+			VkImageCopy region = {};
+
+			region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, move.source.GetLayerCount() };
+			region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, move.source.GetLayerCount() };
+			region.extent         = move.source.GetExtents();
+
+			vkCmdCopyImage(batch.commandBuffer, move.source.GetHandle(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+										 move.destination->GetHandle(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+		}
+
+		// Shaders of later submissions see the copied data
+		barriers.clear();
+
+		sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		destinationStage = 0;
+
+		for(auto image : images)
+		{
+			barriers.push_back(image->TakeLayoutBarrier(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, sourceStage, destinationStage));
+		}
+
+		VkMemoryBarrier bufferBarrier { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		const uint32_t bufferBarrierCount = _bufferCopies.empty() ? 0 : 1;
+
+		if (bufferBarrierCount > 0)
+		{
+			destinationStage |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+		}
+
+		if (!barriers.empty() || bufferBarrierCount > 0)
+		{
+			vkCmdPipelineBarrier(batch.commandBuffer, sourceStage, destinationStage, 0,
+														bufferBarrierCount, &bufferBarrier,
+														0, VK_NULL_HANDLE,
+														barriers.size(), barriers.data());
+		}
+
+		vkEndCommandBuffer(batch.commandBuffer);
+
+		VkSubmitInfo submitInfo { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch.commandBuffer;
+
+		if (vkQueueSubmit(_queue, 1, &submitInfo, batch.fence) != VK_SUCCESS)
+		{
+			throw runtime_error("Failed to submit uploads");
+		}
+
+		batch.ticket       = ++_lastTicket;
+		batch.stagingBytes = _pendingBytes;
+
+		_submitted.push_back(batch);
+
+		_imageCopies.clear();
+		_bufferCopies.clear();
+		_imageMoves.clear();
+		_pendingBytes = 0;
+
+		return batch.ticket;
+	}
+
+	bool UploadQueue::IsComplete(uploadTicket ticket)
+	{
+		Collect();
+
+		return ticket <= _completedTicket;
+	}
+
+	void UploadQueue::Wait(uploadTicket ticket)
+	{
+		while (_completedTicket < ticket && !_submitted.empty())
+		{
+			RetireOldest();
+		}
+	}
+
+	void UploadQueue::Collect()
+	{
+		while (!_submitted.empty() && vkGetFenceStatus(*_device, _submitted.front().fence) == VK_SUCCESS)
+		{
+			RetireOldest();
+		}
+	}
+
+	VkDeviceSize UploadQueue::Reserve(VkDeviceSize size)
+	{
+		const VkDeviceSize capacity = _stagingBuffer.GetSize();
+
+		if (size > capacity)
+		{
+			throw runtime_error("Failed to upload: staging buffer size exceeded");
+		}
+
+		while (true)
+		{
+			if (_stagingUsed == 0)
+			{
+				_stagingHead = 0;
+			}
+
+			VkDeviceSize offset = Aligned(_stagingHead, stagingAlignment);
+			VkDeviceSize padding = offset - _stagingHead;
+
+			// Doesn't fit before the end, the tail of the ring is skipped
+			if (offset + size > capacity)
+			{
+				offset  = 0;
+				padding = capacity - _stagingHead;
+			}
+
+			const VkDeviceSize consumed = padding + size;
+
+			if (_stagingUsed + consumed <= capacity)
+			{
+				_stagingHead  = offset + size;
+				_stagingUsed  += consumed;
+				_pendingBytes += consumed;
+
+				return offset;
+			}
+
+			// Ring is full, oldest batch has to finish first
+			if (_submitted.empty())
+			{
+				Flush();
+			}
+
+			RetireOldest();
+		}
+	}
+
+	UploadQueue::Batch UploadQueue::TakeFreeBatch()
+	{
+		if (!_freeBatches.empty())
+		{
+			Batch batch = _freeBatches.back();
+			_freeBatches.pop_back();
+
+			return batch;
+		}
+
+		Batch batch;
+		batch.commandBuffer = CreateCommandBuffer(*_device, _commandPool);
+
+		VkFenceCreateInfo fenceCreateInfo { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+
+		if (vkCreateFence(*_device, &fenceCreateInfo, nullptr, &batch.fence) != VK_SUCCESS)
+		{
+			throw runtime_error("Failed to create upload fence");
+		}
+
+		return batch;
+	}
+
+	void UploadQueue::RetireOldest()
+	{
+		if (_submitted.empty())
+		{
+			throw runtime_error("No uploads to wait for");
+		}
+
+		Batch batch = _submitted.front();
+		_submitted.pop_front();
+
+		vkWaitForFences(*_device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+		vkResetFences(*_device, 1, &batch.fence);
+
+		_stagingUsed     -= batch.stagingBytes;
+		_completedTicket = batch.ticket;
+
+		_freeBatches.push_back(batch);
+	}
+
+	void UploadQueue::Release()
+	{
+		while (!_submitted.empty())
+		{
+			RetireOldest();
+		}
+
+		for(auto& batch : _freeBatches)
+		{
+			vkDestroyFence(*_device, batch.fence, nullptr);
+			vkFreeCommandBuffers(*_device, _commandPool, 1, &batch.commandBuffer);
+		}
+
+		_freeBatches.clear();
+
+		if (_stagingMemory != nullptr)
+		{
+			_stagingBuffer.UnmapMemory();
+
+			_stagingMemory = nullptr;
+		}
+
+		_stagingBuffer.Destroy();
+	}
+}
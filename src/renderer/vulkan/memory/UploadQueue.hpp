@@ -0,0 +1,115 @@
+#pragma once
+
+#include "../device/Device.hpp"
+
+#include "Buffer.hpp"
+#include "Image.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace renderer::vulkan
+{
+	// Identifies a submitted batch of uploads, later batches have greater ones
+	typedef uint64_t uploadTicket;
+
+	// Collects copies to device local images and buffers and submits them
+	//  in one command buffer: one barrier before all copies, one after.
+	//  Data is copied to the staging ring when queued, so callers can drop it.
+	//  Work submitted to the queue after a flush sees the uploaded data
+	class UploadQueue
+	{
+	public:
+
+		UploadQueue();
+		UploadQueue(Device*, VkQueue, VkCommandPool);
+
+		// Takes over a bound staging buffer, it stays mapped until release
+		void Initialize(Buffer stagingBuffer);
+
+		// Uploads larger than half of the staging ring are split into row bands.
+		//  Rows of data are rowStride bytes apart, or tightly packed when it's 0
+		void UploadImage(Image*, const void* data, VkOffset3D offset, VkExtent3D extent, uint32_t pixelSize, uint32_t rowStride = 0, uint32_t layer = 0);
+		void UploadBuffer(Buffer*, const void* data, VkDeviceSize size, VkDeviceSize offset = 0);
+
+		// Copies contents of source on GPU into destination, which isn't written yet.
+		//  Source must be kept alive until the batch completes
+		void MoveImage(Image source, Image* destination);
+
+		// Drops copies not submitted yet, target is about to be freed
+		void Cancel(Image*);
+		void Cancel(Buffer*);
+
+		// Submits everything queued since the last flush. Returns ticket of
+		//  the batch, or of the previous one when nothing was queued
+		uploadTicket Flush();
+
+		bool IsComplete(uploadTicket);
+		void Wait(uploadTicket);
+
+		// Recycles batches GPU is done with, never blocks
+		void Collect();
+
+		void Release();
+
+	private:
+
+		struct ImageCopy
+		{
+			Image*            image;
+			VkBufferImageCopy region;
+		};
+
+		struct BufferCopy
+		{
+			Buffer*      buffer;
+			VkBufferCopy region;
+		};
+
+		struct ImageMove
+		{
+			Image  source;
+			Image* destination;
+		};
+
+		struct Batch
+		{
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkFence         fence = VK_NULL_HANDLE;
+			uploadTicket    ticket = 0;
+			VkDeviceSize    stagingBytes = 0;
+		};
+
+		// Offset of size bytes in staging ring, waits for old batches if it's full
+		VkDeviceSize Reserve(VkDeviceSize size);
+
+		Batch TakeFreeBatch();
+		void  RetireOldest();
+
+	private:
+
+		Device*       _device = nullptr;
+		VkQueue       _queue = VK_NULL_HANDLE;
+		VkCommandPool _commandPool = VK_NULL_HANDLE;
+
+		Buffer       _stagingBuffer;
+		uint8_t*     _stagingMemory = nullptr;
+		VkDeviceSize _stagingHead = 0, _stagingUsed = 0;
+
+		// Queued since the last flush
+		std::vector<ImageCopy>  _imageCopies;
+		std::vector<BufferCopy> _bufferCopies;
+		std::vector<ImageMove>  _imageMoves;
+		VkDeviceSize            _pendingBytes = 0;
+
+		std::vector<Image*>               _batchImages;
+		std::vector<VkImageMemoryBarrier> _barriers;
+
+		std::deque<Batch>  _submitted;
+		std::vector<Batch> _freeBatches;
+
+		uploadTicket _lastTicket = 0, _completedTicket = 0;
+	};
+}
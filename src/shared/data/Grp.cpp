@@ -1,5 +1,6 @@
 #include "Grp.hpp"
 
+#include <algorithm>
 #include <cstring>
 #include <string>
 
@@ -7,20 +8,23 @@
 
 namespace data
 {
+	const int TRANSPARENT_FLAG = 0x80;
+	const int REPEAT_FLAG = 0x40;
 
 	const SpriteData Grp::GetSpriteData(int frameIndex) const
 	{
 		const int numOfChannels = 1;
 
-		auto frame = _frames[frameIndex];
+		auto frame  = _frames[frameIndex];
+		auto bounds = _bounds[frameIndex];
 
-		glm::vec<2, int> offset = frame.posOffset;
+		glm::vec<2, int> offset = glm::vec<2, int>(frame.posOffset) + glm::vec<2, int>(bounds.offset);
 		offset.x -= _header.dimensions.x / 2;
 		offset.y -= _header.dimensions.y / 2;
 
 		return { 
 			offset, 
-			frame.dimensions };
+			bounds.dimensions };
 	}
 
 	const int Grp::GetSpriteCount() const
@@ -35,17 +39,17 @@ namespace data
 
 	const int Grp::ReadPixelData(int frameIndex, uint8_t* out, int stride) const
 	{
-		const int TRANSPARENT_FLAG = 0x80;
-		const int REPEAT_FLAG = 0x40;
-
-		const GrpFrame& frame = _frames[frameIndex];
+		const GrpFrame&  frame  = _frames[frameIndex];
+		const GrpBounds& bounds = _bounds[frameIndex];
 		uint16_t* rleLinesOffsets = reinterpret_cast<uint16_t*>(_data.get() + frame.linesOffset);
 
-		int size = frame.dimensions.x * frame.dimensions.y;
+		int size = bounds.dimensions.x * bounds.dimensions.y;
+		int left = bounds.offset.x;
 
-		for(int y = 0; y < frame.dimensions.y; y++)
+		// Rows and runs outside of the bounds are transparent
+		for(int y = 0; y < bounds.dimensions.y; y++)
 		{
-			auto rleLines = reinterpret_cast<uint8_t*>(rleLinesOffsets) + rleLinesOffsets[y];
+			auto rleLines = reinterpret_cast<uint8_t*>(rleLinesOffsets) + rleLinesOffsets[bounds.offset.y + y];
 			auto pixelsRow = &out[y * stride];
 
 			for(int x = 0; x < frame.dimensions.x; )
@@ -61,7 +65,7 @@ namespace data
 					auto length     = flag & ~REPEAT_FLAG;
 					auto colorIndex = *rleLines++;
 
-					memset(pixelsRow + x, colorIndex, length);
+					memset(pixelsRow + x - left, colorIndex, length);
 
 					x += length;
 				}
@@ -69,7 +73,7 @@ namespace data
 				{
 					for(int l = 0; l < flag; l++)
 
-						pixelsRow[x++] = *rleLines++;
+						pixelsRow[x++ - left] = *rleLines++;
 				}
 			}
 		}
@@ -77,6 +81,51 @@ namespace data
 		return size;
 	}
 
+	// Walks run headers only, pixels aren't decoded
+	static GrpBounds FindOpaqueBounds(const uint8_t* data, const GrpFrame& frame)
+	{
+		auto rleLinesOffsets = reinterpret_cast<const uint16_t*>(data + frame.linesOffset);
+
+		int left = frame.dimensions.x, right = 0;
+		int top = frame.dimensions.y, bottom = 0;
+
+		for(int y = 0; y < frame.dimensions.y; y++)
+		{
+			auto rleLines = reinterpret_cast<const uint8_t*>(rleLinesOffsets) + rleLinesOffsets[y];
+
+			for(int x = 0; x < frame.dimensions.x; )
+			{
+				auto flag = *rleLines++;
+
+				if (flag & TRANSPARENT_FLAG)
+				{
+					x += flag & ~TRANSPARENT_FLAG;
+					continue;
+				}
+
+				int length = (flag & REPEAT_FLAG) ? flag & ~REPEAT_FLAG : flag;
+
+				// Broken run, the rest of the row is left out
+				if (length == 0)
+					break;
+
+				rleLines += (flag & REPEAT_FLAG) ? 1 : length;
+
+				left   = std::min(left, x);
+				right  = std::max(right, std::min(x + length, int(frame.dimensions.x)));
+				top    = std::min(top, y);
+				bottom = y + 1;
+
+				x += length;
+			}
+		}
+
+		if (right <= left)
+			return { { 0, 0 }, { 0, 0 } };
+
+		return { { left, top }, { right - left, bottom - top } };
+	}
+
 	glm::vec<2, int> Grp::GetDimensionsLimit() const
 	{
 		return { GRP_DIMENSIONS_LIMIT, GRP_DIMENSIONS_LIMIT };
@@ -96,15 +145,30 @@ namespace data
 	{
 		return _frames;
 	}
+
+	const GrpBounds& Grp::GetBounds(int frame) const
+	{
+		return _bounds[frame];
+	}
 	
-	Grp Grp::ReadGrpFile(filesystem::Storage& storage, const char* path)
+	std::shared_ptr<uint8_t[]> Grp::GetData() const
+	{
+		return _data;
+	}
+
+	int Grp::GetDataSize() const
+	{
+		return _dataSize;
+	}
+
+	Grp Grp::ReadGrpFile(filesystem::Storage& storage, const char* path, utility::Arena* arena)
 	{
 		std::string fullpath = "unit\\" + std::string(path);
 
 		filesystem::StorageFile file;
 		storage.Open(fullpath.c_str(), file);
 
-		auto data = std::make_shared<uint8_t[]>(file.GetFileSize());
+		auto data = utility::MakeShared<uint8_t[]>(arena, file.GetFileSize());
 		file.ReadBinary(data.get(), file.GetFileSize());
 
 		return ReadGrp(data, file.GetFileSize());
@@ -121,7 +185,15 @@ namespace data
 
 		reader.Read(out._frames.data(), out._header.frameAmount);
 
-		out._data = data;
+		out._data     = data;
+		out._dataSize = size;
+
+		out._bounds.reserve(out._frames.size());
+
+		for(auto& frame : out._frames)
+		{
+			out._bounds.push_back(FindOpaqueBounds(data.get(), frame));
+		}
 
 		return out;
 	}
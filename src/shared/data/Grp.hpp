@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "../filesystem/Storage.hpp"
+#include "../utility/Arena.hpp"
 
 #include <data/Sprite.hpp>
 
@@ -29,6 +30,13 @@ namespace data
 		uint32_t             linesOffset;
 	};
 
+	// Smallest box of a frame holding all of its opaque pixels, relative to the frame
+	struct GrpBounds
+	{
+		glm::vec<2, uint8_t> offset;
+		glm::vec<2, uint8_t> dimensions;
+	};
+
 	class Grp : public A_SpriteSheetData
 	{
 	public:
@@ -46,13 +54,22 @@ namespace data
 		const GrpFrame&  GetFrame(int frame) const;
 		const std::vector<GrpFrame>& GetFrames() const;
 
-		static Grp ReadGrpFile(filesystem::Storage& storage, const char* path);
+		// Sprite data and pixels cover only the bounds, transparent margins are trimmed
+		const GrpBounds& GetBounds(int frame) const;
+
+		// Raw file contents
+		std::shared_ptr<uint8_t[]> GetData() const;
+		int                        GetDataSize() const;
+
+		static Grp ReadGrpFile(filesystem::Storage& storage, const char* path, utility::Arena* arena = nullptr);
 		static Grp ReadGrp(std::shared_ptr<uint8_t[]> data, int size);
 
 	private:
 
 		GrpHeader                  _header;
 		std::vector<GrpFrame>      _frames;
+		std::vector<GrpBounds>     _bounds;
 		std::shared_ptr<uint8_t[]> _data;
+		int                        _dataSize = 0;
 	};
 }
\ No newline at end of file
@@ -1,9 +1,40 @@
+#include <array>
 #include <cassert>
 
 #include "Images.hpp"
 
 namespace data
 {
+	// Frame offsets and mirroring of the original engine for facings 0 to 31
+	constexpr std::array<FacingFrame, FACING_COUNT> ORIGINAL_FACING_FRAMES = {{
+		{  0, FlipNone }, {  1, FlipNone }, {  2, FlipNone }, {  3, FlipNone },
+		{  4, FlipNone }, {  5, FlipNone }, {  6, FlipNone }, {  7, FlipNone },
+		{  8, FlipNone }, {  9, FlipNone }, { 10, FlipNone }, { 11, FlipNone },
+		{ 12, FlipNone }, { 13, FlipNone }, { 14, FlipNone }, { 15, FlipNone },
+		{ 16, FlipNone }, { 15, FlipHorizontally }, { 14, FlipHorizontally }, { 13, FlipHorizontally },
+		{ 12, FlipHorizontally }, { 11, FlipHorizontally }, { 10, FlipHorizontally }, {  9, FlipHorizontally },
+		{  8, FlipHorizontally }, {  7, FlipHorizontally }, {  6, FlipHorizontally }, {  5, FlipHorizontally },
+		{  4, FlipHorizontally }, {  3, FlipHorizontally }, {  2, FlipHorizontally }, {  1, FlipHorizontally },
+	}};
+
+	constexpr bool FacingFramesMatchOriginal(uint32_t firstFrame)
+	{
+		for(uint32_t facing = 0; facing < FACING_COUNT; facing++)
+		{
+			auto expected = ORIGINAL_FACING_FRAMES[facing];
+
+			expected.frame += firstFrame;
+
+			if (TakeFacingFrame(firstFrame, facing) != expected || TakeFacingFrame(firstFrame, facing + FACING_COUNT) != expected)
+				return false;
+		}
+
+		return true;
+	}
+
+	static_assert(FacingFramesMatchOriginal(0) && FacingFramesMatchOriginal(STORED_FACING_COUNT * 3),
+		"Facings should map to frames like in the original engine");
+
 	void ReadImagesTable(filesystem::Storage& storage, ImagesTable& table)
 	{
 		filesystem::StorageFile file;
@@ -4,6 +4,8 @@
 
 #include <filesystem/Storage.hpp>
 
+#include "Common.hpp"
+
 namespace data
 {
 	const int MAX_IMAGES_AMOUNT = 999;
@@ -17,26 +19,76 @@ namespace data
 			Special,
 	 };
 
+	// Remaps including None
+	const uint32_t PALETTE_REMAP_COUNT = 6;
+
+	// How images of the original engine are drawn
+	enum class DrawFunction : uint8_t {
+			Normal = 0,
+			NoHallucination,
+			NonVisionCloaking,
+			NonVisionCloaked,
+			NonVisionDecloaking,
+			VisionCloaking,
+			VisionCloaked,
+			VisionDecloaking,
+			EmpShockwave,
+			Remapping,
+			Shadow,
+			HpBar,
+			WarpTexture,
+			SelectionCircle,
+			PlayerColor,
+			SizeRect,
+			Hallucination,
+			WarpFlash,
+	 };
+
 	struct ImagesTable
 	{
-		uint32_t grpID[MAX_IMAGES_AMOUNT];
-		uint8_t  turns[MAX_IMAGES_AMOUNT];
-		bool     selectable[MAX_IMAGES_AMOUNT];
-		bool     useFullIScript[MAX_IMAGES_AMOUNT];
-		bool     drawIfCloaked[MAX_IMAGES_AMOUNT];
-		uint8_t  drawFunction[MAX_IMAGES_AMOUNT];
-		uint32_t iScriptID[MAX_IMAGES_AMOUNT];
-		uint32_t shieldOverlay[MAX_IMAGES_AMOUNT];
-		uint32_t attackOverlay[MAX_IMAGES_AMOUNT];
-		uint32_t damageOverlay[MAX_IMAGES_AMOUNT];
-		uint32_t specialOverlay[MAX_IMAGES_AMOUNT];
-		uint32_t landingOverlay[MAX_IMAGES_AMOUNT];
-		uint32_t liftOffOverlay[MAX_IMAGES_AMOUNT];
+		uint32_t     grpID[MAX_IMAGES_AMOUNT];
+		uint8_t      turns[MAX_IMAGES_AMOUNT];
+		bool         selectable[MAX_IMAGES_AMOUNT];
+		bool         useFullIScript[MAX_IMAGES_AMOUNT];
+		bool         drawIfCloaked[MAX_IMAGES_AMOUNT];
+		DrawFunction drawFunction[MAX_IMAGES_AMOUNT];
+		uint32_t     iScriptID[MAX_IMAGES_AMOUNT];
+		uint32_t     shieldOverlay[MAX_IMAGES_AMOUNT];
+		uint32_t     attackOverlay[MAX_IMAGES_AMOUNT];
+		uint32_t     damageOverlay[MAX_IMAGES_AMOUNT];
+		uint32_t     specialOverlay[MAX_IMAGES_AMOUNT];
+		uint32_t     landingOverlay[MAX_IMAGES_AMOUNT];
+		uint32_t     liftOffOverlay[MAX_IMAGES_AMOUNT];
 
 		PaletteRemap remapping[MAX_IMAGES_AMOUNT];
 	};
 
 	static_assert(sizeof(ImagesTable) == 37964, "ImagesTable size should be equal to 37964");
 
+	// Images with turns face one of 32 directions, clockwise from north.
+	//  Frames are stored for north to south only, west side is mirrored
+	const uint32_t FACING_COUNT        = 32;
+	const uint32_t STORED_FACING_COUNT = FACING_COUNT / 2 + 1;
+
+	struct FacingFrame
+	{
+		uint32_t  frame;
+		FlipFlags flip;
+
+		constexpr bool operator==(const FacingFrame&) const = default;
+	};
+
+	// Frame to draw for a facing of an image with turns, first frame is the
+	//  north one of the animation frame set played by iscript
+	constexpr FacingFrame TakeFacingFrame(uint32_t firstFrame, uint32_t facing)
+	{
+		facing %= FACING_COUNT;
+
+		if (facing < STORED_FACING_COUNT)
+			return { firstFrame + facing, FlipNone };
+
+		return { firstFrame + FACING_COUNT - facing, FlipHorizontally };
+	}
+
 	extern void ReadImagesTable(filesystem::Storage& storage, ImagesTable& table);
 };
\ No newline at end of file
@@ -51,16 +51,18 @@ namespace filesystem
 
 	void Storage::Open(const char* path, StorageFile& file)
 	{
-		file.Open(_storage, path);
+		file.Open(_storage, _mutex, path);
 	}
 
 	void Storage::Open(const boost::format& path, StorageFile& file)
 	{
-		file.Open(_storage, path.str().c_str());
+		file.Open(_storage, _mutex, path.str().c_str());
 	}
 
 	void Storage::Close()
 	{
+		std::lock_guard lock(_mutex);
+
 		if (_storage == nullptr)
 			return;
 		
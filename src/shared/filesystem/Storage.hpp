@@ -1,11 +1,15 @@
 #pragma once
 
 #include <boost/format.hpp>
+#include <mutex>
 
 #include "StorageFile.hpp"
 
 namespace filesystem
 {
+	// Can be used from several threads. CascLib calls on the storage and on
+	//  files opened through it are serialized by one lock, so threads reading
+	//  at once take turns. Each StorageFile still belongs to one thread at a time
 	class Storage
 	{
 	public:
@@ -36,6 +40,7 @@ namespace filesystem
 
 	private:
 
-		void* _storage;
+		void*      _storage;
+		std::mutex _mutex;
 	};
 }
\ No newline at end of file
@@ -17,7 +17,7 @@ namespace filesystem
 	StorageFile::StorageFile() {}
 	
 	StorageFile::StorageFile(StorageFile&& file)
-		: _handle(file._handle), _fileSize(file._fileSize)
+		: _handle(file._handle), _storageMutex(file._storageMutex), _fileSize(file._fileSize)
 	{
 		file._handle = nullptr;
 	}
@@ -34,11 +34,21 @@ namespace filesystem
 		Close();
 	}
 
+	std::unique_lock<std::mutex> StorageFile::LockStorage()
+	{
+		if (_storageMutex == nullptr)
+			return {};
+
+		return std::unique_lock(*_storageMutex);
+	}
+
 	void StorageFile::Close()
 	{
 		if (_handle == nullptr)
 			return;
 
+		auto lock = LockStorage();
+
 		if (!CascCloseFile(_handle))
 		{
 			auto message = format("Couldn't close the storage's file %1%") % _filePath;
@@ -53,6 +63,8 @@ namespace filesystem
 		char* dataPtr = reinterpret_cast<char*>(data);
 		DWORD bytesRead;
 
+		auto lock = LockStorage();
+
 		if (!CascReadFile(_handle, data, size, &bytesRead))
 		{
 			auto message = format("Couldn't read file %1%") % _filePath;
@@ -74,6 +86,8 @@ namespace filesystem
 			case FileSeekDir::End: method = FILE_END; break;
 		}
 
+		auto lock = LockStorage();
+
 		if (!CascSetFilePointer64(_handle, offset, &output, method))
 		{
 			auto message = format("Couldn't seek file %1%") % _filePath;
@@ -89,10 +103,14 @@ namespace filesystem
 		return Seek(0, FileSeekDir::Cur);
 	}
 
-	void StorageFile::Open(void* storageHandle, const char* filePath)
+	void StorageFile::Open(void* storageHandle, std::mutex& storageMutex, const char* filePath)
 	{
 		if (_handle == nullptr)
 		{
+			_storageMutex = &storageMutex;
+
+			auto lock = LockStorage();
+
 			if (!CascOpenFile(storageHandle, filePath, 0, 0, &_handle))
 			{
 				_handle = nullptr;
@@ -117,6 +135,8 @@ namespace filesystem
 		}
 		else // if file's size is unknown then get and record it
 		{
+			auto lock = LockStorage();
+
 			return _fileSize = CascGetFileSize(_handle, nullptr);
 		}
 	}
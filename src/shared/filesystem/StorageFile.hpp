@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <mutex>
 #include <string>
 
 namespace filesystem
@@ -19,7 +20,8 @@ namespace filesystem
 
 		~StorageFile();
 
-		void Open(void* storageHandle, const char* filePath);
+		// Every CascLib call of the file holds storageMutex, it's shared by files of the storage
+		void Open(void* storageHandle, std::mutex& storageMutex, const char* filePath);
 
 		int ReadBinary(void* data, int size);
 
@@ -47,9 +49,14 @@ namespace filesystem
 
 		bool IsOpened() const;
 
+	private:
+
+		std::unique_lock<std::mutex> LockStorage();
+
 	private:
 
 		void*       _handle = nullptr;
+		std::mutex* _storageMutex = nullptr;
 		std::string _filePath;
 		int				  _fileSize = -1;
 	};
@@ -0,0 +1,81 @@
+#include "Arena.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <new>
+
+namespace utility
+{
+	Arena::Arena(std::size_t slabSize) : _slabSize(slabSize)
+		{}
+
+	void* Arena::TryAllocate(Slab& slab, std::size_t size, std::size_t alignment)
+	{
+		auto base    = reinterpret_cast<uintptr_t>(slab.data.get());
+		auto address = (base + _offset + alignment - 1) / alignment * alignment;
+
+		if (address + size > base + slab.size)
+			return nullptr;
+
+		_offset = address + size - base;
+
+		return reinterpret_cast<void*>(address);
+	}
+
+	void* Arena::Allocate(std::size_t size, std::size_t alignment)
+	{
+		std::lock_guard lock(_mutex);
+
+		_stats.bytesUsed += size;
+		_stats.allocationCount++;
+		_liveBlocks++;
+
+		// Move through slabs left from the previous cycles first
+		for(; _currentSlab < _slabs.size(); _currentSlab++, _offset = 0)
+		{
+			void* memory = TryAllocate(_slabs[_currentSlab], size, alignment);
+
+			if (memory != nullptr)
+				return memory;
+		}
+
+		// Oversized blocks get a slab of their own
+		std::size_t slabSize = std::max(_slabSize, size + alignment);
+
+		_slabs.push_back({ std::make_unique_for_overwrite<uint8_t[]>(slabSize), slabSize });
+		_currentSlab = _slabs.size() - 1;
+		_offset      = 0;
+
+		_stats.slabAllocations++;
+		_stats.slabCount++;
+		_stats.bytesReserved += slabSize;
+
+		void* memory = TryAllocate(_slabs.back(), size, alignment);
+
+		if (memory == nullptr)
+			throw std::bad_alloc();
+
+		return memory;
+	}
+
+	void Arena::Release()
+	{
+		std::lock_guard lock(_mutex);
+
+		assert(_liveBlocks == 0 && "Arena is released while its objects are still alive");
+
+		_currentSlab = 0;
+		_offset      = 0;
+
+		_stats.bytesUsed       = 0;
+		_stats.allocationCount = 0;
+		_stats.slabAllocations = 0;
+	}
+
+	ArenaStats Arena::GetStats() const
+	{
+		std::lock_guard lock(_mutex);
+
+		return _stats;
+	}
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace utility
+{
+	const std::size_t ARENA_SLAB_SIZE = 4 * 1024 * 1024;
+
+	struct ArenaStats
+	{
+		uint64_t bytesUsed       = 0; // requested by allocations since last release
+		uint64_t bytesReserved   = 0; // total size of slabs
+		uint64_t allocationCount = 0; // allocations since last release
+		uint64_t slabAllocations = 0; // calls to the system allocator since last release
+		uint64_t slabCount       = 0;
+	};
+
+	// Bump allocator that hands out memory from large slabs.
+	//  Nothing is freed individually, Release() rewinds the arena
+	//  and keeps the slabs for the next cycle.
+	class Arena
+	{
+	public:
+
+		Arena(std::size_t slabSize = ARENA_SLAB_SIZE);
+
+		Arena(const Arena&) = delete;
+		Arena& operator=(const Arena&) = delete;
+
+		void* Allocate(std::size_t size, std::size_t alignment);
+
+		// All objects allocated from arena must be destroyed before
+		void Release();
+
+		ArenaStats GetStats() const;
+
+		int GetLiveBlockCount() const { return _liveBlocks.load(); }
+
+		void OnBlockFreed() { _liveBlocks--; }
+
+	private:
+
+		struct Slab
+		{
+			std::unique_ptr<uint8_t[]> data;
+			std::size_t                size;
+		};
+
+		void* TryAllocate(Slab& slab, std::size_t size, std::size_t alignment);
+
+	private:
+
+		const std::size_t _slabSize;
+
+		mutable std::mutex _mutex;
+
+		std::vector<Slab> _slabs;
+		std::size_t       _currentSlab = 0;
+		std::size_t       _offset      = 0;
+
+		ArenaStats       _stats;
+		std::atomic<int> _liveBlocks = 0;
+	};
+
+	// Allows standard containers and smart pointers to live in arena
+	template<typename T>
+	class ArenaAllocator
+	{
+	public:
+
+		typedef T value_type;
+
+		ArenaAllocator(Arena* arena) : _arena(arena) {}
+
+		template<typename U>
+		ArenaAllocator(const ArenaAllocator<U>& other) : _arena(other.GetArena()) {}
+
+		T* allocate(std::size_t count)
+		{
+			return static_cast<T*>(_arena->Allocate(count * sizeof(T), alignof(T)));
+		}
+
+		void deallocate(T*, std::size_t)
+		{
+			_arena->OnBlockFreed();
+		}
+
+		Arena* GetArena() const { return _arena; }
+
+		template<typename U>
+		bool operator==(const ArenaAllocator<U>& other) const { return _arena == other.GetArena(); }
+
+	private:
+
+		Arena* _arena;
+	};
+
+	// Puts both object and its control block into arena,
+	//  falls back to the heap when there's no arena
+	template<typename T, typename... Args>
+	std::shared_ptr<T> MakeShared(Arena* arena, Args&&... args)
+	{
+		if (arena == nullptr)
+		{
+			return std::make_shared<T>(std::forward<Args>(args)...);
+		}
+
+		ArenaAllocator<std::remove_extent_t<T>> allocator(arena);
+
+		return std::allocate_shared<T>(allocator, std::forward<Args>(args)...);
+	}
+}
@@ -0,0 +1,187 @@
+#include "JobGraph.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+namespace utility
+{
+	JobGraph::JobGraph(int threadCount) : _threadCount(std::max(1, threadCount))
+		{}
+
+	JobGraph::~JobGraph()
+	{
+		if (!_started)
+			return;
+
+		{
+			std::unique_lock lock(_mutex);
+			_finishedCondition.wait(lock, [this] { return _finishedCount == static_cast<int>(_jobs.size()); });
+		}
+
+		for(auto& worker : _workers)
+			worker.join();
+	}
+
+	jobID JobGraph::Add(const char* name, std::function<void()> job, std::initializer_list<jobID> dependencies)
+	{
+		if (_started)
+		{
+			throw std::runtime_error("Job can't be added after graph is started");
+		}
+
+		jobID id = _jobs.size();
+
+		Job& added = _jobs.emplace_back();
+		added.name     = name;
+		added.function = std::move(job);
+
+		for(auto dependency : dependencies)
+		{
+			if (dependency < 0 || dependency >= id)
+			{
+				throw std::runtime_error("Job depends on a job that isn't added yet");
+			}
+
+			_jobs[dependency].dependents.push_back(id);
+			added.pendingDependencies++;
+		}
+
+		return id;
+	}
+
+	void JobGraph::Start()
+	{
+		std::lock_guard lock(_mutex);
+
+		_started = true;
+
+		for(jobID id = 0; id < static_cast<int>(_jobs.size()); id++)
+		{
+			if (_jobs[id].pendingDependencies == 0)
+				_readyJobs.push_back(id);
+		}
+
+		int workerCount = std::min<int>(_threadCount, _jobs.size());
+
+		for(int i = 0; i < workerCount; i++)
+		{
+			_workers.emplace_back(&JobGraph::WorkerLoop, this);
+		}
+	}
+
+	bool JobGraph::IsFinished() const
+	{
+		std::lock_guard lock(_mutex);
+
+		return _started && _finishedCount == static_cast<int>(_jobs.size());
+	}
+
+	void JobGraph::Wait()
+	{
+		std::unique_lock lock(_mutex);
+
+		_finishedCondition.wait(lock, [this] { return _finishedCount == static_cast<int>(_jobs.size()); });
+
+		if (_error)
+		{
+			std::rethrow_exception(_error);
+		}
+	}
+
+	int JobGraph::GetJobCount() const
+	{
+		return _jobs.size();
+	}
+
+	int JobGraph::GetFinishedCount() const
+	{
+		std::lock_guard lock(_mutex);
+
+		return _finishedCount;
+	}
+
+	std::vector<JobTiming> JobGraph::GetTimings() const
+	{
+		std::lock_guard lock(_mutex);
+
+		std::vector<JobTiming> timings;
+
+		for(auto& job : _jobs)
+		{
+			timings.push_back({ job.name, job.seconds });
+		}
+
+		return timings;
+	}
+
+	int JobGraph::GetDefaultThreadCount()
+	{
+		// One core is left for the thread that keeps rendering
+		return std::max<int>(1, std::thread::hardware_concurrency() - 1);
+	}
+
+	void JobGraph::WorkerLoop()
+	{
+		std::unique_lock lock(_mutex);
+
+		while(true)
+		{
+			_jobsCondition.wait(lock, [this] {
+				return !_readyJobs.empty() || _finishedCount == static_cast<int>(_jobs.size());
+			});
+
+			if (_readyJobs.empty())
+				return;
+
+			jobID id = _readyJobs.front();
+			_readyJobs.pop_front();
+
+			if (!_error)
+			{
+				lock.unlock();
+
+				auto start = std::chrono::steady_clock::now();
+				std::exception_ptr error;
+
+				try
+				{
+					_jobs[id].function();
+				}
+				catch (...)
+				{
+					error = std::current_exception();
+				}
+
+				auto end = std::chrono::steady_clock::now();
+
+				lock.lock();
+
+				_jobs[id].seconds = std::chrono::duration<double>(end - start).count();
+
+				if (error && !_error)
+					_error = error;
+			}
+
+			FinishJob(id);
+		}
+	}
+
+	void JobGraph::FinishJob(jobID id)
+	{
+		// Dependents still go through the queue after a failure,
+		//  that's how they get skipped and counted
+		for(auto dependent : _jobs[id].dependents)
+		{
+			if (--_jobs[dependent].pendingDependencies == 0)
+				_readyJobs.push_back(dependent);
+		}
+
+		_finishedCount++;
+
+		_jobsCondition.notify_all();
+
+		if (_finishedCount == static_cast<int>(_jobs.size()))
+			_finishedCondition.notify_all();
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace utility
+{
+	typedef int jobID;
+
+	struct JobTiming
+	{
+		std::string name;
+		double      seconds; // 0 if job was skipped
+	};
+
+	// Runs jobs on worker threads as soon as all their dependencies are done.
+	//  When a job throws, jobs that haven't started yet are skipped
+	//  and the exception is rethrown by Wait().
+	class JobGraph
+	{
+	public:
+
+		JobGraph(int threadCount = GetDefaultThreadCount());
+		~JobGraph();
+
+		JobGraph(const JobGraph&) = delete;
+		JobGraph& operator=(const JobGraph&) = delete;
+
+		// Dependencies must be added before the job that uses them
+		jobID Add(const char* name, std::function<void()> job, std::initializer_list<jobID> dependencies = {});
+
+		void Start();
+
+		bool IsFinished() const;
+
+		// Blocks until every job is done or skipped
+		void Wait();
+
+		int GetJobCount() const;
+		int GetFinishedCount() const;
+
+		std::vector<JobTiming> GetTimings() const;
+
+		static int GetDefaultThreadCount();
+
+	private:
+
+		struct Job
+		{
+			std::string           name;
+			std::function<void()> function;
+			std::vector<jobID>    dependents;
+
+			int    pendingDependencies = 0;
+			double seconds = 0.0;
+		};
+
+		void WorkerLoop();
+		void FinishJob(jobID id); // _mutex must be locked
+
+	private:
+
+		const int _threadCount;
+
+		std::vector<Job>         _jobs;
+		std::deque<jobID>        _readyJobs;
+		std::vector<std::thread> _workers;
+
+		mutable std::mutex      _mutex;
+		std::condition_variable _jobsCondition;
+		std::condition_variable _finishedCondition;
+
+		int  _finishedCount = 0;
+		bool _started = false;
+
+		std::exception_ptr _error;
+	};
+}
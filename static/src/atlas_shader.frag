@@ -0,0 +1,80 @@
+#version 450
+
+// Sprite sheet frames in the layers of the sprite atlas
+
+layout(location = 1) in vec2 inTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+layout(binding = 0) uniform sampler2DArray atlasSampler;
+layout(binding = 1) uniform sampler2D paletteSampler;
+
+// Pipeline variant of a draw style, branches of other modes are removed when
+//  it's compiled. Row 0 of the palette image holds colors, rows below it hold
+//  palette indices of remaps
+layout(constant_id = 0) const uint DrawMode = 0u;
+layout(constant_id = 1) const uint RemapRow = 0u;
+
+// Index goes to an 8 bit target resolved through the palette later, only
+//  normal and remap modes, the others blend colors
+layout(constant_id = 2) const bool OutputIndices = false;
+
+const uint DrawNormal        = 0u;
+const uint DrawShadow        = 1u;
+const uint DrawCloaked       = 2u;
+const uint DrawRemap         = 3u;
+const uint DrawHallucination = 4u;
+
+void main()
+{
+	float kEpsilon = 0.0000046039;
+
+	// u is offset by twice the layer, so right edges of a frame stay in its layer
+	float layer = floor(inTexCoord.x * 0.5);
+	vec3  uv    = vec3(inTexCoord.x - layer * 2.0, inTexCoord.y, layer);
+
+	float index = texture(atlasSampler, uv).x;
+
+	if (DrawMode == DrawRemap)
+	{
+		float remapped = texelFetch(paletteSampler, ivec2(round(index * 255.0), RemapRow), 0).x;
+
+		if (OutputIndices)
+		{
+			outColor = vec4(remapped, 0.0, 0.0, index > 0.0 ? 1.0 : 0.0);
+			return;
+		}
+
+		outColor = texelFetch(paletteSampler, ivec2(round(remapped * 255.0), 0), 0);
+		outColor.a = index > 0.0 ? outColor.a : 0.0;
+		return;
+	}
+
+	if (OutputIndices)
+	{
+		outColor = vec4(index, 0.0, 0.0, index > 0.0 ? 1.0 : 0.0);
+		return;
+	}
+
+	vec4 color = texture(paletteSampler, vec2(index - kEpsilon, 0.0f));
+
+	if (DrawMode == DrawShadow)
+	{
+		// Every opaque pixel darkens what is below
+		outColor = vec4(0.0, 0.0, 0.0, color.a * 0.5);
+	}
+	else if (DrawMode == DrawCloaked)
+	{
+		outColor = vec4(color.rgb, color.a * 0.35);
+	}
+	else if (DrawMode == DrawHallucination)
+	{
+		float luminance = dot(color.rgb, vec3(0.299, 0.587, 0.114));
+
+		outColor = vec4(luminance * 0.5, luminance * 0.7, luminance, color.a);
+	}
+	else
+	{
+		outColor = color;
+	}
+}
@@ -0,0 +1,68 @@
+#version 450
+
+// Quad of an instanced draw, corners are built from the frame table
+
+struct FrameRect
+{
+	vec4 uv;   // left, top, right, bottom
+	vec4 rect; // offset and size in pixels
+};
+
+layout(location = 0) in ivec2 inPosition;
+layout(location = 1) in uvec2 inFrame; // frame table row, flip flags
+
+layout(binding = 2) readonly buffer FrameTable
+{
+	FrameRect frames[];
+};
+
+layout(push_constant) uniform Constants
+{
+	vec2 inverseExtent;
+};
+
+layout(location = 0) out vec2 outPosition;
+layout(location = 1) out vec2 outTexCoord;
+
+// Same order as A_VulkanDrawable::GetPolygon emits them
+const vec2 corners[6] = vec2[](
+	vec2(0.0, 1.0), vec2(0.0, 0.0), vec2(1.0, 0.0),
+	vec2(0.0, 1.0), vec2(1.0, 0.0), vec2(1.0, 1.0)
+);
+
+const uint FlipHorizontally = 1u;
+const uint FlipVertically   = 2u;
+
+// Mirrored around the position, offset of the frame is mirrored too
+const uint MirrorHorizontally = 4u;
+const uint MirrorVertically   = 8u;
+
+void main()
+{
+	FrameRect frame  = frames[inFrame.x];
+	vec2      corner = corners[gl_VertexIndex];
+
+	vec2 local = frame.rect.xy + corner * frame.rect.zw;
+
+	if ((inFrame.y & MirrorHorizontally) != 0)
+		local.x = -local.x;
+
+	if ((inFrame.y & MirrorVertically) != 0)
+		local.y = -local.y;
+
+	vec2 pixel    = vec2(inPosition) + local;
+	vec2 position = pixel * inverseExtent * 2.0 - 1.0;
+
+	vec4 uv = frame.uv;
+
+	if ((inFrame.y & FlipHorizontally) != 0)
+		uv.xz = uv.zx;
+
+	if ((inFrame.y & FlipVertically) != 0)
+		uv.yw = uv.wy;
+
+	gl_Position = vec4(position, 0.0, 1.0);
+
+	outPosition = position;
+	outTexCoord = mix(uv.xy, uv.zw, corner);
+}
@@ -7,8 +7,20 @@ layout(location = 0) out vec4 outColor;
 layout(binding = 0) uniform sampler2D textureSampler;
 layout(binding = 1) uniform sampler2D paletteSampler;
 
+// Index goes to an 8 bit target resolved through the palette later
+layout(constant_id = 0) const bool OutputIndices = false;
+
 void main()
 {
+	if (OutputIndices)
+	{
+		float index = texture(textureSampler, inTexCoord.xy).x;
+
+		// Index 0 is transparent, blending keeps what is below
+		outColor = vec4(index, 0.0, 0.0, index > 0.0 ? 1.0 : 0.0);
+		return;
+	}
+
   float kEpsilon = 0.0000046039;
 	float index = texture(textureSampler, inTexCoord.xy).x - kEpsilon;
 
@@ -0,0 +1,41 @@
+#version 450
+
+// Indices drawn by palettized passes turned into colors, cycled ranges of
+//  the palette are rotated here instead of uploading it again
+
+layout(location = 0) out vec4 outColor;
+
+layout(binding = 0) uniform sampler2D indexSampler;
+layout(binding = 1) uniform sampler2D paletteSampler;
+
+const int MaxPaletteCycles = 4;
+
+layout(push_constant) uniform Constants
+{
+	uvec4 cycles[MaxPaletteCycles]; // first, count, period
+	uint  tick;
+};
+
+void main()
+{
+	uint index = uint(texelFetch(indexSampler, ivec2(gl_FragCoord.xy), 0).x * 255.0 + 0.5);
+
+	// Color of the range rotated by one place a period, empty ranges match nothing
+	for(int i = 0; i < MaxPaletteCycles; i++)
+	{
+		uvec4 cycle = cycles[i];
+
+		if (index >= cycle.x && index < cycle.x + cycle.y)
+		{
+			uint shift = (tick / cycle.z) % cycle.y;
+
+			index = cycle.x + (index - cycle.x + cycle.y - shift) % cycle.y;
+			break;
+		}
+	}
+
+	// Nothing was drawn over index 0
+	vec3 color = index == 0u ? vec3(0.0) : texelFetch(paletteSampler, ivec2(index, 0), 0).rgb;
+
+	outColor = vec4(color, 1.0);
+}
@@ -0,0 +1,10 @@
+#version 450
+
+// One triangle covering the screen, corners come from the vertex index
+
+void main()
+{
+	vec2 corner = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+
+	gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
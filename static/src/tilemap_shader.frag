@@ -0,0 +1,63 @@
+#version 450
+
+// Terrain in view in one quad, texture coordinates are in map tiles
+
+layout(location = 1) in vec2 inTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+layout(binding = 0) uniform sampler2D  textureSampler; // tileset cells
+layout(binding = 1) uniform sampler2D  paletteSampler;
+layout(binding = 2) uniform usampler2D tilemapSampler; // cell | flip flags << 14, wraps around the map
+
+layout(push_constant) uniform Constants
+{
+	int cellSize;
+};
+
+// Index goes to an 8 bit target resolved through the palette later
+layout(constant_id = 0) const bool OutputIndices = false;
+
+const uint EmptyTile        = 0xFFFFu;
+const uint FlipHorizontally = 1u;
+const uint FlipVertically   = 2u;
+
+void main()
+{
+	// Tile (x, y) is kept in texel (x mod width, y mod height) of the window
+	ivec2 window = textureSize(tilemapSampler, 0);
+	uint  tile   = texelFetch(tilemapSampler, ivec2(inTexCoord) % window, 0).x;
+
+	// Tiles that aren't uploaded yet stay black
+	if (tile == EmptyTile)
+		discard;
+
+	int  cell  = int(tile & 0x3FFFu);
+	uint flips = tile >> 14;
+
+	vec2 inside = fract(inTexCoord);
+
+	if ((flips & FlipHorizontally) != 0u)
+		inside.x = 1.0 - inside.x;
+
+	if ((flips & FlipVertically) != 0u)
+		inside.y = 1.0 - inside.y;
+
+	int   columns = textureSize(textureSampler, 0).x / cellSize;
+	ivec2 texel   = ivec2(cell % columns, cell / columns) * cellSize;
+
+	texel += min(ivec2(inside * cellSize), ivec2(cellSize - 1));
+
+	if (OutputIndices)
+	{
+		float index = texelFetch(textureSampler, texel, 0).x;
+
+		outColor = vec4(index, 0.0, 0.0, index > 0.0 ? 1.0 : 0.0);
+		return;
+	}
+
+	float kEpsilon = 0.0000046039;
+	float index = texelFetch(textureSampler, texel, 0).x - kEpsilon;
+
+	outColor = texture(paletteSampler, vec2(index, 0.0f));
+}
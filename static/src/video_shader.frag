@@ -0,0 +1,32 @@
+#version 450
+
+// Video frame planes converted to RGB, chroma planes are upsampled by the sampler
+
+layout(location = 1) in vec2 inTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+layout(binding = 0) uniform sampler2D lumaSampler;
+layout(binding = 1) uniform sampler2D chromaSampler;  // U, or U and V for semi planar formats
+layout(binding = 2) uniform sampler2D chromaVSampler;
+
+layout(push_constant) uniform Constants
+{
+	vec4 rows[3];  // rgb = rows * (y, u, v, 1)
+	int  semiPlanar;
+};
+
+void main()
+{
+	float y  = texture(lumaSampler, inTexCoord).x;
+	vec2  uv = texture(chromaSampler, inTexCoord).xy;
+
+	if (semiPlanar == 0)
+		uv.y = texture(chromaVSampler, inTexCoord).x;
+
+	vec4 yuv = vec4(y, uv, 1.0);
+
+	vec3 rgb = vec3(dot(rows[0], yuv), dot(rows[1], yuv), dot(rows[2], yuv));
+
+	outColor = vec4(clamp(rgb, 0.0, 1.0), 1.0);
+}